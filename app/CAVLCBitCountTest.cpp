@@ -0,0 +1,179 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: CAVLCBitCountTest.cpp
+
+DESCRIPTION		: Compare the CAVLC bit count of CAVLCH264BlkScan with the bits written
+								by the CAVLCH264Impl encoders through RleEncode() over random
+								macroblocks for every nC class, the Intra_16x16 DC and AC blocks and
+								the 2x2 chr DC blocks.
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "MacroBlockH264.h"
+#include "BlockH264.h"
+#include "BitStreamWriterMSB.h"
+#include "CAVLCH264Impl.h"
+#include "CAVLCH264BlkScan.h"
+#include "PrefixH264VlcEncoderImpl1.h"
+#include "CoeffTokenH264VlcEncoder.h"
+#include "TotalZeros4x4H264VlcEncoder.h"
+#include "TotalZeros2x2H264VlcEncoder.h"
+#include "RunBeforeH264VlcEncoder.h"
+
+#define CAVLCBITCOUNTTEST_MACROBLOCKS	2000
+#define CAVLCBITCOUNTTEST_STREAM_BYTES	4096
+
+/// One nC value from each coeff_token table class [0..1], [2..3], [4..7] and [8..16].
+static const int NCValue[] = { 0, 1, 2, 3, 4, 7, 8, 16 };
+
+/*
+---------------------------------------------------------------------------
+	Local functions.
+---------------------------------------------------------------------------
+*/
+/** Fill a block with random quantised coeffs.
+The density varies from one coeff to a full block and the levels are mostly
+trailing ones and small values with occasional large values that escape.
+@param pBlk	: Block to fill.
+@return			: none.
+*/
+static void FillBlock(BlockH264* pBlk)
+{
+	short* pCoeff = pBlk->GetBlk();
+	int len = pBlk->GetWidth() * pBlk->GetHeight();
+	int density = 1 + (rand() % 16);
+	for (int i = 0; i < len; i++)
+	{
+		int lev = 0;
+		if ((rand() % 16) < density)
+		{
+			int r = rand() % 100;
+			if (r < 50)
+				lev = 1;
+			else if (r < 85)
+				lev = 2 + (rand() % 6);
+			else if (r < 97)
+				lev = 8 + (rand() % 60);
+			else
+				lev = 68 + (rand() % 2000);
+			if (rand() % 2)
+				lev = -lev;
+		}//end if rand...
+		pCoeff[i] = (short)lev;
+	}//end for i...
+}//end FillBlock.
+
+/*
+---------------------------------------------------------------------------
+	Entry point.
+---------------------------------------------------------------------------
+*/
+int main(void)
+{
+	PrefixH264VlcEncoderImpl1 prefixVlcEnc;
+	CoeffTokenH264VlcEncoder coeffTokenVlcEnc;
+	TotalZeros4x4H264VlcEncoder totalZeros4x4VlcEnc;
+	TotalZeros2x2H264VlcEncoder totalZeros2x2VlcEnc;
+	RunBeforeH264VlcEncoder runBeforeVlcEnc;
+
+	/// The CAVLC encoders are configured as in H264v2Codec::Open().
+	CAVLCH264Impl cavlc4x4;
+	CAVLCH264Impl cavlc2x2;
+	cavlc4x4.SetMode(CAVLCH264Impl::Mode4x4);
+	cavlc4x4.SetTokenCoeffVlcEncoder(&coeffTokenVlcEnc);
+	cavlc4x4.SetPrefixVlcEncoder(&prefixVlcEnc);
+	cavlc4x4.SetRunBeforeVlcEncoder(&runBeforeVlcEnc);
+	cavlc4x4.SetTotalZerosVlcEncoder(&totalZeros4x4VlcEnc);
+	cavlc2x2.SetMode(CAVLCH264Impl::Mode2x2);
+	cavlc2x2.SetTokenCoeffVlcEncoder(&coeffTokenVlcEnc);
+	cavlc2x2.SetPrefixVlcEncoder(&prefixVlcEnc);
+	cavlc2x2.SetRunBeforeVlcEncoder(&runBeforeVlcEnc);
+	cavlc2x2.SetTotalZerosVlcEncoder(&totalZeros2x2VlcEnc);
+
+	static unsigned char stream[CAVLCBITCOUNTTEST_STREAM_BYTES];
+	BitStreamWriterMSB bsw;
+	CAVLCH264BlkScan blkScan;
+	MacroBlockH264 mb;
+	int blocks = 0;
+
+	srand(26);
+	for (int m = 0; m < CAVLCBITCOUNTTEST_MACROBLOCKS; m++)
+	{
+		for (int i = 0; i < MBH264_NUM_BLKS; i++)
+			FillBlock(mb._blkParam[i].pBlk);
+		blkScan.Scan(&mb);
+
+		/// Every block with both dc skip settings. The Intra_16x16 lum AC blocks skip their
+		/// 1st coeff and the DC blocks never do.
+		for (int i = 0; i < MBH264_NUM_BLKS; i++)
+		{
+			BlockH264* pBlk = mb._blkParam[i].pBlk;
+			int is2x2 = (pBlk->GetWidth() == 2);
+			for (int dcSkip = 0; dcSkip < 2; dcSkip++)
+			{
+				if (dcSkip && (is2x2 || (i == MBH264_LUM_DC)))
+					continue;
+				if (!blkScan.GetTotalCoeff(i, dcSkip))
+					continue;
+
+				int numNC = is2x2 ? 1 : (int)(sizeof(NCValue) / sizeof(NCValue[0]));
+				for (int k = 0; k < numNC; k++)
+				{
+					int nC = is2x2 ? -1 : NCValue[k];
+					IContextAwareRunLevelCodec* pCAVLC = is2x2 ? (IContextAwareRunLevelCodec *)&cavlc2x2 : (IContextAwareRunLevelCodec *)&cavlc4x4;
+					pCAVLC->SetParameter(pCAVLC->NUM_TOT_NEIGHBOR_COEFF_ID, nC);
+					pCAVLC->SetParameter(pCAVLC->DC_SKIP_FLAG_ID, dcSkip);
+					bsw.SetStream(stream, 8 * CAVLCBITCOUNTTEST_STREAM_BYTES);
+
+					int count = blkScan.BitCount(i, nC, dcSkip);
+					int written = pBlk->RleEncode(pCAVLC, &bsw);
+					if ((written <= 0) || (count != written) || (bsw.GetStreamBitPos() != written))
+					{
+						printf("Macroblock %d block %d nC %d dc skip %d: counted %d bits, RleEncode() %d bits\n", m, i, nC, dcSkip, count, written);
+						return(1);
+					}//end if count...
+					blocks++;
+				}//end for k...
+			}//end for dcSkip...
+		}//end for i...
+	}//end for m...
+
+	printf("%d block encodings match\n", blocks);
+	return(0);
+}//end main.
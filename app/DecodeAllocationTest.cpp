@@ -0,0 +1,172 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: DecodeAllocationTest.cpp
+
+DESCRIPTION		: Encode a sequence with H264v2Codec and check that decoding it makes
+								no heap allocations after the first access unit. The global operator
+								new of this executable counts the allocations of the process while a
+								Decode() call is active.
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <vector>
+
+#include "H264v2Codec.h"
+
+#define DECODEALLOCATIONTEST_PICTURES	60
+#define DECODEALLOCATIONTEST_IPERIOD	20
+#define DECODEALLOCATIONTEST_WIDTH		176
+#define DECODEALLOCATIONTEST_HEIGHT		144
+
+/*
+---------------------------------------------------------------------------
+	Allocation counting.
+---------------------------------------------------------------------------
+*/
+/// The replacement operators are used by the codec library too as the executable
+/// definitions take precedence in the process.
+static int						allocCounting = 0;
+static unsigned int		allocCount		= 0;
+
+void* operator new(std::size_t size)
+{
+	if (allocCounting)
+		allocCount++;
+	void* p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return(p);
+}//end operator new.
+void* operator new[](std::size_t size) { return(operator new(size)); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	if (allocCounting)
+		allocCount++;
+	return(malloc(size ? size : 1));
+}//end operator new nothrow.
+void* operator new[](std::size_t size, const std::nothrow_t& nt) noexcept { return(operator new(size, nt)); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, std::size_t) noexcept { free(p); }
+void operator delete[](void* p, std::size_t) noexcept { free(p); }
+
+/*
+---------------------------------------------------------------------------
+	Entry point.
+---------------------------------------------------------------------------
+*/
+int main(void)
+{
+	const int lumSize = DECODEALLOCATIONTEST_WIDTH * DECODEALLOCATIONTEST_HEIGHT;
+	char val[16];
+
+	/// ------------------ Encode -----------------------------------------------
+	/// I pictures with the param sets prepended at every period and P pictures between them.
+	H264v2Codec enc;
+	sprintf(val, "%d", DECODEALLOCATIONTEST_WIDTH);
+	enc.SetParameter("width", val);
+	sprintf(val, "%d", DECODEALLOCATIONTEST_HEIGHT);
+	enc.SetParameter("height", val);
+	enc.SetParameter("incolour", "17");	///< Planar 8 bit Y, U then V.
+	enc.SetParameter("quality", "20");
+	if (!enc.Open())
+	{
+		printf("Cannot open the encoder: %s\n", enc.GetErrorStr());
+		return(1);
+	}//end if !Open...
+
+	srand(35);
+	std::vector<unsigned char> pic(lumSize + (lumSize / 2));
+	std::vector<unsigned char> buf(4 * lumSize);
+	std::vector< std::vector<unsigned char> > stream;
+	for (int frm = 0; frm < DECODEALLOCATIONTEST_PICTURES; frm++)
+	{
+		for (int y = 0; y < DECODEALLOCATIONTEST_HEIGHT; y++)
+			for (int x = 0; x < DECODEALLOCATIONTEST_WIDTH; x++)
+				pic[(y * DECODEALLOCATIONTEST_WIDTH) + x] = (unsigned char)(((x + (2 * frm)) ^ (y + frm)) + (rand() & 7));
+		memset((void *)&(pic[lumSize]), 128, lumSize / 2);
+
+		enc.SetParameter("picture coding type", ((frm % DECODEALLOCATIONTEST_IPERIOD) == 0) ? "0" : "1");
+		if (!enc.Code(&(pic[0]), &(buf[0]), 8 * (int)buf.size()))
+		{
+			printf("Picture %d cannot be coded: %s\n", frm, enc.GetErrorStr());
+			return(1);
+		}//end if !Code...
+		stream.push_back(std::vector<unsigned char>(buf.begin(), buf.begin() + enc.GetCompressedByteLength()));
+	}//end for frm...
+	enc.Close();
+
+	/// ------------------ Decode -----------------------------------------------
+	/// The first access unit opens the decoder from its param sets and is not counted.
+	H264v2Codec dec;
+	sprintf(val, "%d", DECODEALLOCATIONTEST_WIDTH);
+	dec.SetParameter("width", val);
+	sprintf(val, "%d", DECODEALLOCATIONTEST_HEIGHT);
+	dec.SetParameter("height", val);
+	dec.SetParameter("outcolour", "17");
+	dec.SetParameter("decode only", "1");
+	if (!dec.Open())
+	{
+		printf("Cannot open the decoder: %s\n", dec.GetErrorStr());
+		return(1);
+	}//end if !Open...
+
+	for (int frm = 0; frm < DECODEALLOCATIONTEST_PICTURES; frm++)
+	{
+		allocCount = 0;
+		allocCounting = (frm > 0);
+		int ok = dec.Decode(&(stream[frm][0]), 8 * (int)stream[frm].size(), &(pic[0]));
+		allocCounting = 0;
+		if (!ok)
+		{
+			printf("Picture %d cannot be decoded: %s\n", frm, dec.GetErrorStr());
+			return(1);
+		}//end if !ok...
+		if (allocCount != 0)
+		{
+			printf("Picture %d decode made %u heap allocations\n", frm, allocCount);
+			return(1);
+		}//end if allocCount...
+	}//end for frm...
+	dec.Close();
+
+	printf("%d pictures decoded without heap allocations\n", DECODEALLOCATIONTEST_PICTURES - 1);
+	return(0);
+}//end main.
@@ -0,0 +1,128 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: MotionCompensatorTest.cpp
+
+DESCRIPTION		: Compare the macroblock prediction of H264v2Codec::CompensatePels()
+								with the Vpp MotionCompensatorH264ImplStd that the codec used before
+								over random pictures and vectors at every fractional position.
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "H264v2Codec.h"
+#include "MotionCompensatorH264ImplStd.h"
+
+#define MOTIONCOMPENSATORTEST_WIDTH		176
+#define MOTIONCOMPENSATORTEST_HEIGHT	144
+#define MOTIONCOMPENSATORTEST_RANGE		16	///< Vector range in full pels.
+#define MOTIONCOMPENSATORTEST_PICTURES	50
+
+/*
+---------------------------------------------------------------------------
+	Entry point.
+---------------------------------------------------------------------------
+*/
+int main(void)
+{
+	const int lumSize = MOTIONCOMPENSATORTEST_WIDTH * MOTIONCOMPENSATORTEST_HEIGHT;
+	const int chrSize = lumSize / 4;
+	const int mbCols = MOTIONCOMPENSATORTEST_WIDTH / 16;
+	const int mbRows = MOTIONCOMPENSATORTEST_HEIGHT / 16;
+
+	/// The Vpp compensator predicts in place from a copy of the contiguous Y, Cb, Cr picture.
+	std::vector<short> ref(lumSize + 2 * chrSize);
+	std::vector<short> vppPic(lumSize + 2 * chrSize);
+	std::vector<short> codecPic(lumSize + 2 * chrSize);
+	short* pRef[3] = { &(ref[0]), &(ref[lumSize]), &(ref[lumSize + chrSize]) };
+	short* pDst[3] = { &(codecPic[0]), &(codecPic[lumSize]), &(codecPic[lumSize + chrSize]) };
+
+	MotionCompensatorH264ImplStd vpp(MOTIONCOMPENSATORTEST_RANGE);
+	if (!vpp.Create((void *)&(vppPic[0]), MOTIONCOMPENSATORTEST_WIDTH, MOTIONCOMPENSATORTEST_HEIGHT, 16, 16))
+	{
+		printf("Cannot create the Vpp compensator\n");
+		return(1);
+	}//end if !Create...
+
+	srand(11);
+	long pels = 0;
+	for (int pic = 0; pic < MOTIONCOMPENSATORTEST_PICTURES; pic++)
+	{
+		/// Smooth gradients with noise so that the 6-tap filter also clips.
+		for (int i = 0; i < (lumSize + 2 * chrSize); i++)
+			ref[i] = (short)((rand() % 4) ? ((i * (pic + 3)) & 255) : (rand() & 255));
+		vppPic = ref;
+		vpp.PrepareForSingleVectorMode();
+
+		for (int mb = 0; mb < (mbCols * mbRows); mb++)
+		{
+			int x = (mb % mbCols) * 16;
+			int y = (mb / mbCols) * 16;
+
+			/// The Vpp compensator does not clamp at the picture edges. The vectors are limited to keep
+			/// the lum apron of 2 pels before and 3 pels after the block inside the picture.
+			int minX = -4 * ((x < (MOTIONCOMPENSATORTEST_RANGE + 2)) ? (x - 2) : MOTIONCOMPENSATORTEST_RANGE);
+			int maxX = 4 * (((MOTIONCOMPENSATORTEST_WIDTH - x - 16) < (MOTIONCOMPENSATORTEST_RANGE + 3)) ? (MOTIONCOMPENSATORTEST_WIDTH - x - 19) : MOTIONCOMPENSATORTEST_RANGE);
+			int minY = -4 * ((y < (MOTIONCOMPENSATORTEST_RANGE + 2)) ? (y - 2) : MOTIONCOMPENSATORTEST_RANGE);
+			int maxY = 4 * (((MOTIONCOMPENSATORTEST_HEIGHT - y - 16) < (MOTIONCOMPENSATORTEST_RANGE + 3)) ? (MOTIONCOMPENSATORTEST_HEIGHT - y - 19) : MOTIONCOMPENSATORTEST_RANGE);
+			int mvx = 0;
+			int mvy = 0;
+			if (maxX > minX)
+				mvx = minX + (rand() % (maxX - minX + 1));
+			if (maxY > minY)
+				mvy = minY + (rand() % (maxY - minY + 1));
+
+			vpp.Compensate(x, y, mvx, mvy);
+			H264v2Codec::CompensatePels(pRef, pDst, MOTIONCOMPENSATORTEST_WIDTH, MOTIONCOMPENSATORTEST_HEIGHT, x, y, mvx, mvy);
+		}//end for mb...
+
+		for (int i = 0; i < (lumSize + 2 * chrSize); i++)
+		{
+			if (vppPic[i] != codecPic[i])
+			{
+				printf("Picture %d pel %d predicted %d, Vpp %d\n", pic, i, codecPic[i], vppPic[i]);
+				return(1);
+			}//end if vppPic...
+		}//end for i...
+		pels += lumSize + 2 * chrSize;
+	}//end for pic...
+
+	printf("%ld compensated pels match\n", pels);
+	return(0);
+}//end main.
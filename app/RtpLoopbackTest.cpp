@@ -0,0 +1,370 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: RtpLoopbackTest.cpp
+
+DESCRIPTION		: Send randomly generated access units and the access units of a
+								H264v2Codec encoded sequence through RtpPacketizerH264 over a
+								UDP loopback socket with sendmmsg() and check that the received
+								RTP packets reassemble into the original NAL units.
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1	///< For sendmmsg().
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "H264v2Codec.h"
+#include "RtpPacketizerH264.h"
+
+#define RTPLOOPBACKTEST_ACCESS_UNITS	300
+#define RTPLOOPBACKTEST_MAX_PACKETS		2048
+#define RTPLOOPBACKTEST_CODED_PICTURES	30
+#define RTPLOOPBACKTEST_WIDTH					176
+#define RTPLOOPBACKTEST_HEIGHT				144
+
+/*
+---------------------------------------------------------------------------
+	Local functions.
+---------------------------------------------------------------------------
+*/
+/** Build a random access unit with optional parameter sets and SEI and 1 to 3 slices.
+Each NAL unit is preceded by a 4 byte start code and the table offsets point at the
+NAL header byte as Code() writes them.
+@param stream	: Filled with the Annex B access unit.
+@param table	: Filled with its NAL unit table.
+@return				: none.
+*/
+static void MakeAccessUnit(std::vector<unsigned char>& stream, std::vector<H264V2_NAL_UNIT>& table)
+{
+	int types[8];
+	int n = 0;
+	if (rand() % 2)
+	{
+		types[n++] = 7;	///< SPS.
+		types[n++] = 8;	///< PPS.
+	}//end if rand...
+	if ((rand() % 3) == 0)
+		types[n++] = 6;	///< SEI.
+	int slices = 1 + (rand() % 3);
+	for (int i = 0; i < slices; i++)
+		types[n++] = (rand() % 2) ? 5 : 1;
+
+	for (int i = 0; i < n; i++)
+	{
+		/// Mix small NAL units for aggregation with large ones for fragmentation.
+		int size = 1 + (rand() % ((rand() % 2) ? 20 : 8000));
+		stream.push_back(0); stream.push_back(0); stream.push_back(0); stream.push_back(1);
+
+		H264V2_NAL_UNIT nal;
+		nal.offset = (int)stream.size();
+		nal.size = size;
+		nal.type = types[i];
+		table.push_back(nal);
+
+		stream.push_back((unsigned char)(0x60 | types[i]));
+		for (int k = 1; k < size; k++)
+			stream.push_back((unsigned char)rand());
+	}//end for i...
+}//end MakeAccessUnit.
+
+/** Receive the packets of one access unit and reassemble its NAL units.
+The RTP header fields are checked against the expected sequence number, timestamp
+and marker on the last packet.
+@param rx				: Bound receiving socket.
+@param pPacket	: Packet descriptors from the packetizer.
+@param numPackets	: Packets to receive.
+@param timestamp	: Expected RTP timestamp.
+@param pSeq			: Expected sequence number of the first packet, updated.
+@param nals			: Filled with the reassembled NAL units.
+@return					: 1 = success, 0 = failure.
+*/
+static int ReceiveAccessUnit(int rx, const RTPPACKETIZERH264_PACKET* pPacket, int numPackets, unsigned int timestamp,
+														 unsigned short* pSeq, std::vector< std::vector<unsigned char> >& nals)
+{
+	static unsigned char buf[70000];
+	std::vector<unsigned char> fu;
+
+	for (int i = 0; i < numPackets; i++)
+	{
+		int len = (int)recv(rx, buf, sizeof(buf), 0);
+		if (len != pPacket[i].bytes)
+		{
+			printf("Packet %d length %d expected %d\n", i, len, pPacket[i].bytes);
+			return(0);
+		}//end if len...
+
+		unsigned short seq = (unsigned short)((buf[2] << 8) | buf[3]);
+		unsigned int ts = ((unsigned int)buf[4] << 24) | ((unsigned int)buf[5] << 16) | ((unsigned int)buf[6] << 8) | buf[7];
+		int marker = buf[1] >> 7;
+		if ((buf[0] != 0x80) || ((buf[1] & 0x7F) != 96) || (seq != *pSeq) || (ts != timestamp) || (marker != (i == (numPackets - 1))))
+		{
+			printf("Packet %d RTP header mismatch\n", i);
+			return(0);
+		}//end if buf...
+		(*pSeq)++;
+
+		unsigned char* pl = &(buf[RTPPACKETIZERH264_HEADER_LEN]);
+		int plLen = len - RTPPACKETIZERH264_HEADER_LEN;
+		int type = pl[0] & 0x1F;
+		if (type == RTPPACKETIZERH264_STAP_A)
+		{
+			int pos = 1;
+			while (pos < plLen)
+			{
+				int size = (pl[pos] << 8) | pl[pos + 1];
+				pos += 2;
+				nals.push_back(std::vector<unsigned char>(&(pl[pos]), &(pl[pos + size])));
+				pos += size;
+			}//end while pos...
+		}//end if STAP_A...
+		else if (type == RTPPACKETIZERH264_FU_A)
+		{
+			if (pl[1] & 0x80)	///< Start bit restores the NAL header.
+			{
+				fu.clear();
+				fu.push_back((unsigned char)((pl[0] & 0xE0) | (pl[1] & 0x1F)));
+			}//end if pl...
+			fu.insert(fu.end(), &(pl[2]), &(pl[plLen]));
+			if (pl[1] & 0x40)	///< End bit.
+				nals.push_back(fu);
+		}//end else if FU_A...
+		else
+			nals.push_back(std::vector<unsigned char>(pl, &(pl[plLen])));
+	}//end for i...
+
+	return(1);
+}//end ReceiveAccessUnit.
+
+/** Packetize one access unit, send it over the loopback and check the reassembly.
+@param packetizer	: Created packetizer.
+@param maxPayload	: Payload limit the packetizer was created with.
+@param tx					: Sending socket.
+@param rx					: Bound receiving socket.
+@param pAddr			: Address of rx.
+@param stream			: Annex B or length prefixed access unit.
+@param pNal				: Its NAL unit table.
+@param numNal			: NAL units in the table.
+@param timestamp	: RTP timestamp.
+@param pSeq				: Expected sequence number of the first packet, updated.
+@return						: 1 = success, 0 = failure.
+*/
+static int LoopAccessUnit(RtpPacketizerH264& packetizer, int maxPayload, int tx, int rx, sockaddr_in* pAddr,
+													const unsigned char* stream, const H264V2_NAL_UNIT* pNal, int numNal, unsigned int timestamp, unsigned short* pSeq)
+{
+	if (!packetizer.Packetize(stream, pNal, numNal, timestamp))
+	{
+		printf("Access unit cannot be packetized\n");
+		return(0);
+	}//end if !Packetize...
+
+	/// The packet elements are passed directly as the message vectors.
+	int numPackets = packetizer.GetNumPackets();
+	const RTPPACKETIZERH264_PACKET* pPacket = packetizer.GetPackets();
+	std::vector<mmsghdr> msg(numPackets);
+	memset((void *)&(msg[0]), 0, numPackets * sizeof(mmsghdr));
+	for (int i = 0; i < numPackets; i++)
+	{
+		if (pPacket[i].bytes > (maxPayload + RTPPACKETIZERH264_HEADER_LEN))
+		{
+			printf("Packet %d exceeds the payload limit\n", i);
+			return(0);
+		}//end if bytes...
+		msg[i].msg_hdr.msg_iov = (iovec *)(&(packetizer.GetIov()[pPacket[i].firstIov]));
+		msg[i].msg_hdr.msg_iovlen = pPacket[i].numIov;
+		msg[i].msg_hdr.msg_name = pAddr;
+		msg[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+	}//end for i...
+
+	int sent = 0;
+	while (sent < numPackets)
+	{
+		int r = sendmmsg(tx, &(msg[sent]), numPackets - sent, 0);
+		if (r < 0)
+		{
+			perror("sendmmsg");
+			return(0);
+		}//end if r...
+		sent += r;
+	}//end while sent...
+
+	std::vector< std::vector<unsigned char> > nals;
+	if (!ReceiveAccessUnit(rx, pPacket, numPackets, timestamp, pSeq, nals))
+		return(0);
+
+	if ((int)nals.size() != numNal)
+	{
+		printf("%d NAL units received, expected %d\n", (int)nals.size(), numNal);
+		return(0);
+	}//end if nals...
+	for (int i = 0; i < numNal; i++)
+	{
+		if (((int)nals[i].size() != pNal[i].size) || memcmp(&(nals[i][0]), &(stream[pNal[i].offset]), pNal[i].size))
+		{
+			printf("NAL unit %d differs\n", i);
+			return(0);
+		}//end if nals...
+	}//end for i...
+
+	return(1);
+}//end LoopAccessUnit.
+
+/*
+---------------------------------------------------------------------------
+	Entry point.
+---------------------------------------------------------------------------
+*/
+int main(void)
+{
+	int rx = socket(AF_INET, SOCK_DGRAM, 0);
+	int tx = socket(AF_INET, SOCK_DGRAM, 0);
+	if ((rx < 0) || (tx < 0))
+	{
+		perror("socket");
+		return(1);
+	}//end if rx...
+
+	/// Bind the receiver to an ephemeral loopback port with room for a whole access unit.
+	sockaddr_in addr;
+	memset((void *)&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	socklen_t addrLen = sizeof(addr);
+	int rcvBuf = 1 << 22;
+	if ((bind(rx, (sockaddr *)&addr, sizeof(addr)) < 0) || (getsockname(rx, (sockaddr *)&addr, &addrLen) < 0))
+	{
+		perror("bind");
+		return(1);
+	}//end if bind...
+	setsockopt(rx, SOL_SOCKET, SO_RCVBUF, &rcvBuf, sizeof(rcvBuf));
+
+	RtpPacketizerH264 packetizer;
+	unsigned short seq = 1000;
+	packetizer.SetPayloadType(96);
+	packetizer.SetSequenceNumber(seq);
+	packetizer.SetSsrc(0x12345678);
+	srand(3);
+
+	/// ------------------ Random access units ----------------------------------
+	for (int au = 0; au < RTPLOOPBACKTEST_ACCESS_UNITS; au++)
+	{
+		int maxPayload = 20 + (rand() % 1400);
+		if (!packetizer.Create(maxPayload, RTPLOOPBACKTEST_MAX_PACKETS))
+		{
+			printf("Cannot create the packetizer\n");
+			return(1);
+		}//end if !Create...
+
+		std::vector<unsigned char> stream;
+		std::vector<H264V2_NAL_UNIT> table;
+		MakeAccessUnit(stream, table);
+
+		if (!LoopAccessUnit(packetizer, maxPayload, tx, rx, &addr, &(stream[0]), &(table[0]), (int)table.size(), au * 3000, &seq))
+		{
+			printf("Random access unit %d failed\n", au);
+			return(1);
+		}//end if !LoopAccessUnit...
+	}//end for au...
+
+	/// ------------------ Coded access units -----------------------------------
+	/// An I picture followed by P pictures of a moving pattern in slices of at most 400 bytes with
+	/// the parameter sets prepended. The NAL units are taken from the "nalunits" member.
+	{
+		const int lumSize = RTPLOOPBACKTEST_WIDTH * RTPLOOPBACKTEST_HEIGHT;
+		const int maxPayload = 1200;
+		H264v2Codec codec;
+		char val[16];
+		sprintf(val, "%d", RTPLOOPBACKTEST_WIDTH);
+		codec.SetParameter("width", val);
+		sprintf(val, "%d", RTPLOOPBACKTEST_HEIGHT);
+		codec.SetParameter("height", val);
+		codec.SetParameter("incolour", "17");	///< Planar 8 bit Y, U then V.
+		codec.SetParameter("quality", "20");
+		codec.SetParameter("max slice bytes", "400");
+		if (!codec.Open() || !packetizer.Create(maxPayload, RTPLOOPBACKTEST_MAX_PACKETS))
+		{
+			printf("Cannot open the codec: %s\n", codec.GetErrorStr());
+			return(1);
+		}//end if !Open...
+
+		std::vector<unsigned char> pic(lumSize + (lumSize / 2));
+		std::vector<unsigned char> stream(4 * lumSize);
+		for (int frm = 0; frm < RTPLOOPBACKTEST_CODED_PICTURES; frm++)
+		{
+			for (int y = 0; y < RTPLOOPBACKTEST_HEIGHT; y++)
+				for (int x = 0; x < RTPLOOPBACKTEST_WIDTH; x++)
+					pic[(y * RTPLOOPBACKTEST_WIDTH) + x] = (unsigned char)(((x + (2 * frm)) ^ (y + frm)) + (rand() & 7));
+			memset((void *)&(pic[lumSize]), 128, lumSize / 2);
+
+			codec.SetParameter("picture coding type", (frm == 0) ? "0" : "1");
+			if (!codec.Code(&(pic[0]), &(stream[0]), 8 * (int)stream.size()))
+			{
+				printf("Picture %d cannot be coded: %s\n", frm, codec.GetErrorStr());
+				return(1);
+			}//end if !Code...
+
+			int numNal = 0;
+			const H264V2_NAL_UNIT* pNal = (const H264V2_NAL_UNIT *)codec.GetMember("nalunits", &numNal);
+			if ((pNal == NULL) || (numNal < 1) || ((pNal[numNal - 1].offset + pNal[numNal - 1].size) != codec.GetCompressedByteLength()))
+			{
+				printf("Picture %d has an invalid NAL unit table\n", frm);
+				return(1);
+			}//end if pNal...
+
+			if (!LoopAccessUnit(packetizer, maxPayload, tx, rx, &addr, &(stream[0]), pNal, numNal, frm * 3000, &seq))
+			{
+				printf("Coded picture %d failed\n", frm);
+				return(1);
+			}//end if !LoopAccessUnit...
+		}//end for frm...
+		codec.Close();
+	}//end coded block...
+
+	close(rx);
+	close(tx);
+	printf("%d random and %d coded access units passed\n", RTPLOOPBACKTEST_ACCESS_UNITS, RTPLOOPBACKTEST_CODED_PICTURES);
+	return(0);
+}//end main.
@@ -61,9 +61,16 @@ OF THE POSSIBILITY OF SUCH DAMAGE.
 #endif
 
 /// This dll has only one purpose to instantiate a H264v2Codec instance. The
-/// obligation of scope management is left to the calling functions.
+/// obligation of scope management is left to the calling functions. In the
+/// pooled mode, released open instances are kept warm and handed out again
+/// to requests with the same width, height, colour formats, mode and session
+/// settings latched by Open().
 #include "H264v2Codec.h"
 
+/// Pool state is private to the dll so that its implementation does not form
+/// part of the exported class layout.
+class H264v2FactoryPool;
+
 // This class is exported from the H264v2.dll
 class H264V2_API H264v2Factory 
 {
@@ -74,4 +81,19 @@ public:
 	/// Interface.
 	H264v2Codec* GetCodecInstance(void);
 	void ReleaseCodecInstance(ICodecv2* pInst);
+
+	/// Pooled mode interface. A pool length of 0 (default) disables pooling.
+	int						SetPoolLimits(int maxInstances, int maxIdleMs);
+	H264v2Codec*	GetCodecInstance(int width, int height, int inColour, int outColour, int modeOfOperation);
+	H264v2Codec*	GetCodecInstance(int width, int height, int inColour, int outColour, int modeOfOperation,
+																 int decodeOnly, int maxSliceBytes, int nalLengthPrefix, int allocationPolicy);
+	void					EvictIdle(void);
+	int						GetPoolSize(void);
+
+private:
+	/// Not copyable as the pool state is owned.
+	H264v2Factory(const H264v2Factory&);
+	H264v2Factory& operator=(const H264v2Factory&);
+
+	H264v2FactoryPool*	_pPool;
 };	///end H264v2Factory.
@@ -0,0 +1,136 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: AnnexBSplitterH264.h
+
+DESCRIPTION		: Assemble H.264 access units from an Annex B byte stream that
+								arrives in arbitrary chunks.
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+#ifndef _ANNEXBSPLITTERH264_H
+#define _ANNEXBSPLITTERH264_H
+
+#pragma once
+
+#include "H264v2Codec.h"
+
+/// SIMD scanning is used where the compiler exposes the instruction set.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define ANNEXBSPLITTERH264_SSE2 1
+#endif
+
+/// Entries in the NAL unit table of an access unit, as many as the encoder writes
+/// per picture. Further units are part of the access unit but are not listed and
+/// are reported by GetNumDroppedNalUnits().
+#define ANNEXBSPLITTERH264_MAX_NAL_UNITS H264V2_MAX_NAL_UNITS
+
+/*
+---------------------------------------------------------------------------
+	Class definition.
+---------------------------------------------------------------------------
+*/
+/** Annex B access unit splitter.
+Bytes from a socket or file are pushed in chunks of any size and complete access
+units are taken off in stream order. Each access unit is returned in place in the
+assembly buffer, starting at its first start code, and is passed directly to
+H264v2Codec::Decode(). Typical usage:
+	splitter.Push(pChunk, len);
+	while (splitter.GetAccessUnit(&pAu, &auLen))
+	{
+		pCodec->Decode((void *)pAu, auLen * 8, pDst);
+		splitter.PopAccessUnit();
+	}//end while GetAccessUnit...
+NAL unit types that the decoder does not support remain in the access unit, are
+listed in its NAL unit table and are skipped by Decode().
+*/
+class AnnexBSplitterH264
+{
+public:
+	AnnexBSplitterH264(void);
+	virtual ~AnnexBSplitterH264(void);
+
+public:
+	int		Create(int bufferBytes);
+	void	Destroy(void);
+	void	Reset(void);
+
+	int		Push(const void* pData, int len);
+	void	Flush(void);
+	int		GetAccessUnit(const unsigned char** ppAu, int* pLen);
+	void	PopAccessUnit(void);
+
+	/// NAL unit table of the access unit returned by GetAccessUnit().
+	int											GetNumNalUnits(void) { return(_numNalUnits); }
+	const H264V2_NAL_UNIT*	GetNalUnits(void) { return(_nalUnit); }
+	/// NAL units of the access unit that did not fit in the table.
+	int											GetNumDroppedNalUnits(void) { return(_numDroppedNalUnits); }
+
+	/// NAL unit types that H264v2Codec::Decode() interprets. All others are skipped.
+	static int IsDecodable(int type) { return((type == 1) || (type == 5) || (type == 7) || (type == 8)); }
+
+	static int FindStartCode(const unsigned char* stream, int from, int last);
+
+protected:
+	void	Scan(void);
+	void	EndNalUnit(int end);
+	int		Reserve(int len);
+
+/// Persistant data.
+protected:
+	unsigned char*	_pBuf;				///< Assembly buffer.
+	int							_size;				///< Bytes allocated to _pBuf.
+	int							_len;					///< Bytes held in _pBuf.
+	int							_scanPos;			///< Next byte to test for a start code.
+	int							_endOfStream;	///< Set by Flush() when no more bytes will be pushed.
+
+	/// Access unit being assembled, or completed and waiting to be popped.
+	int							_auStart;			///< Offset of its first start code, -1 before any is found.
+	int							_auEnd;				///< Offset after its last NAL unit when ready.
+	int							_auReady;
+	int							_auHasVcl;		///< A slice NAL unit has been included.
+	int							_nextAuStart;	///< Offset of the access unit following a ready one.
+
+	/// NAL unit whose end has not been found yet.
+	int							_openNalStart;	///< Offset of its NAL header byte, -1 when none.
+	int							_openNalType;
+
+	H264V2_NAL_UNIT	_nalUnit[ANNEXBSPLITTERH264_MAX_NAL_UNITS];
+	int							_numNalUnits;
+	int							_numDroppedNalUnits;	///< Units beyond ANNEXBSPLITTERH264_MAX_NAL_UNITS.
+
+};// end class AnnexBSplitterH264.
+
+#endif	// _ANNEXBSPLITTERH264_H
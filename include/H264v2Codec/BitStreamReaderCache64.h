@@ -0,0 +1,156 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: BitStreamReaderCache64.h
+
+DESCRIPTION		: A non-virtual bit stream reader that caches the stream in a 64 bit
+								register for peek and skip access. Reads beyond the end of the stream
+								return zeros so that callers need only check for exhaustion at
+								convenient points instead of after every symbol.
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+#ifndef _BITSTREAMREADERCACHE64_H
+#define _BITSTREAMREADERCACHE64_H
+
+#pragma once
+
+#include "ExpGolombH264.h"
+
+/*
+---------------------------------------------------------------------------
+	Class definition.
+---------------------------------------------------------------------------
+*/
+class BitStreamReaderCache64
+{
+public:
+	BitStreamReaderCache64(void);
+	virtual ~BitStreamReaderCache64(void);
+
+public:
+	void	Attach(const void* pStream, int bitSize, int bitPos);
+	void	Seek(int bitPos);
+
+	/** Look at the next bits without consuming them.
+	@param numBits	: Bits to look at [1..32].
+	@return					: Bits in the lsbs.
+	*/
+	unsigned int Peek(int numBits)
+	{
+		if (_cacheBits < numBits)
+			Refill();
+		return((unsigned int)(_cache >> (64 - numBits)));
+	}//end Peek.
+
+	/** Consume bits.
+	@param numBits	: Bits to consume [0..32].
+	@return					: none.
+	*/
+	void Skip(int numBits)
+	{
+		if (_cacheBits < numBits)
+			Refill();
+		_cache <<= numBits;
+		_cacheBits -= numBits;
+		_bitPos += numBits;
+	}//end Skip.
+
+	/** Read bits.
+	@param numBits	: Bits to read [1..32].
+	@return					: Bits in the lsbs.
+	*/
+	unsigned int Read(int numBits)
+	{
+		unsigned int bits = Peek(numBits);
+		Skip(numBits);
+		return(bits);
+	}//end Read.
+
+	/** Read an unsigned Exp-Golomb code ue(v).
+	An invalid code sets the error flag and returns 0.
+	@return	: Decoded code number.
+	*/
+	int ReadUe(void)
+	{
+		unsigned int bits = Peek(32);
+		if (bits == 0)
+		{
+			_error = 1;
+			return(0);
+		}//end if bits...
+		int zeros = ExpGolombH264::LeadingZeros(bits);
+		Skip(zeros + 1);
+		if (!zeros)
+			return(0);
+		return((int)((1U << zeros) - 1 + Read(zeros)));
+	}//end ReadUe.
+
+	/** Read a signed Exp-Golomb code se(v).
+	@return	: Decoded value.
+	*/
+	int ReadSe(void)
+	{
+		unsigned int k = (unsigned int)ReadUe();
+		if (k & 1)
+			return((int)((k + 1) >> 1));
+		return(-(int)(k >> 1));
+	}//end ReadSe.
+
+	/// Member access.
+	int	GetBitPos(void) { return(_bitPos); }
+	int	GetBitSize(void) { return(_bitSize); }
+	/// Exhausted when more bits have been consumed than the stream holds.
+	int	Exhausted(void) { return(_bitPos > _bitSize); }
+	/// Invalid codes are flagged and held until the next Attach().
+	int	GetError(void) { return(_error); }
+
+protected:
+	void	Refill(void);
+
+/// Persistant data.
+protected:
+	const unsigned char*	_pStream;		///< Attached stream.
+	int										_byteSize;	///< Bytes in the stream that may be loaded.
+	int										_bitSize;		///< Bits in the stream.
+	int										_bytePos;		///< Next byte to load into the cache.
+	int										_bitPos;		///< Bit position of the msb of the cache.
+	unsigned long long		_cache;			///< Next bits of the stream from the msb down.
+	int										_cacheBits;	///< Valid bits in the cache.
+	int										_error;			///< Invalid code flag.
+
+};// end class BitStreamReaderCache64.
+
+#endif	// _BITSTREAMREADERCACHE64_H
@@ -0,0 +1,131 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: BitStreamWriterAcc64.h
+
+DESCRIPTION		: A non-virtual bit stream writer front end that accumulates codes in a
+								64 bit register and passes them on to an IBitStreamWriter as whole 32
+								bit words. Aligned byte data is written in bulk. It is not an
+								IBitStreamWriter itself, so coders that take one, such as the CAVLC
+								coders, write to the attached writer after a Flush().
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+#ifndef _BITSTREAMWRITERACC64_H
+#define _BITSTREAMWRITERACC64_H
+
+#pragma once
+
+#include "IBitStreamWriter.h"
+#include "ExpGolombH264.h"
+
+/*
+---------------------------------------------------------------------------
+	Class definition.
+---------------------------------------------------------------------------
+*/
+class BitStreamWriterAcc64
+{
+public:
+	BitStreamWriterAcc64(void);
+	~BitStreamWriterAcc64(void);
+
+public:
+	/** Attach to a stream writer.
+	Any pending bits of a previous attachment must have been flushed.
+	@param bsw	: Writer to pass the accumulated bits to.
+	@return			: none.
+	*/
+	void Attach(IBitStreamWriter* bsw) { _bsw = bsw; _acc = 0; _accBits = 0; }
+
+	/** Append a code to the accumulator.
+	Whenever 32 or more bits are held the oldest 32 are written to the attached
+	writer as a single word.
+	@param numBits	: Code length [1..32].
+	@param code			: Code in the lsbs.
+	@return					: none.
+	*/
+	void Write(int numBits, int code)
+	{
+		_acc = (_acc << numBits) | ((unsigned long long)((unsigned int)code) & Mask(numBits));
+		_accBits += numBits;
+		if (_accBits >= 32)
+		{
+			_accBits -= 32;
+			_bsw->Write(32, (int)((unsigned int)(_acc >> _accBits)));
+		}//end if _accBits...
+	}//end Write.
+
+	/** Append an unsigned Exp-Golomb code ue(v).
+	@param codeNum	: Code number [0..2^31-1].
+	@return					: none.
+	*/
+	void WriteUe(unsigned int codeNum)
+	{
+		int numBits = ExpGolombH264::UnsignedBits(codeNum);
+		if (numBits <= 32)
+			Write(numBits, (int)(codeNum + 1));
+		else	///< Leading zeros are written separately for long codes.
+		{
+			Write(numBits >> 1, 0);
+			Write((numBits >> 1) + 1, (int)(codeNum + 1));
+		}//end else...
+	}//end WriteUe.
+
+	/** Append a signed Exp-Golomb code se(v).
+	@param value	: Signed value.
+	@return				: none.
+	*/
+	void WriteSe(int value) { WriteUe(ExpGolombH264::SignedCodeNum(value)); }
+
+	void	WriteBytes(const unsigned char* pBytes, int len);
+	void	Flush(void);
+
+	/// Member access.
+	IBitStreamWriter* GetWriter(void) { return(_bsw); }
+	int	GetPendingBits(void) { return(_accBits); }
+
+protected:
+	static unsigned long long Mask(int numBits) { return((1ULL << numBits) - 1); }
+
+/// Persistant data.
+protected:
+	IBitStreamWriter*		_bsw;			///< Attached writer.
+	unsigned long long	_acc;			///< Pending bits in the lsbs, oldest first.
+	int									_accBits;	///< Number of pending bits [0..31].
+
+};// end class BitStreamWriterAcc64.
+
+#endif	// _BITSTREAMWRITERACC64_H
@@ -0,0 +1,136 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: CAVLCH264BlkScan.h
+
+DESCRIPTION		: A macroblock pre-pass for CAVLC that zig-zag orders all the
+								coeff blocks at once and holds a significance bit mask per block.
+								TotalCoeff, TrailingOnes, levels and runs are then extracted with
+								bit scans and the CAVLC bit cost is counted from look up tables
+								without running the vlc encoders.
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+#ifndef _CAVLCH264BLKSCAN_H
+#define _CAVLCH264BLKSCAN_H
+
+#pragma once
+
+#include "MacroBlockH264.h"
+
+/// SIMD scanning is used where the compiler exposes the instruction set.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define CAVLCH264BLKSCAN_SSE2 1
+#endif
+#if defined(CAVLCH264BLKSCAN_SSE2) && (defined(__SSSE3__) || defined(__AVX__))
+#define CAVLCH264BLKSCAN_SSSE3 1
+#endif
+
+
+/*
+---------------------------------------------------------------------------
+	Class definition.
+---------------------------------------------------------------------------
+*/
+class CAVLCH264BlkScan
+{
+public:
+	CAVLCH264BlkScan(void);
+	virtual ~CAVLCH264BlkScan(void);
+
+public:
+	/** Zig-zag scan all the coeff blocks of a macroblock.
+	Each block of the macroblock in _blkParam[] order is zig-zag ordered into a
+	local store and a significance bit mask with bit k set for a non-zero coeff
+	at scan pos k is built. Must be called before any of the per block methods.
+	@param pMb	: Macroblock with quantised coeffs.
+	@return			: none.
+	*/
+	void Scan(MacroBlockH264* pMb);
+
+	/** Count the CAVLC bits for a scanned block.
+	The bit count includes the coeff_token, trailing one signs, levels, total_zeros
+	and run_before codes as defined in the H.264 standard tables.
+	@param blk				: Block index in _blkParam[] order.
+	@param nC					: Neighbourhood coeff context (-1 for 2x2 chr DC).
+	@param dcSkipFlag	: Exclude the 1st coeff (Intra_16x16 AC blocks).
+	@return						: Bit count.
+	*/
+	int BitCount(int blk, int nC, int dcSkipFlag);
+
+	/** Extract the levels and runs of a scanned block.
+	Levels and run_before values are returned in reverse scan order (highest 
+	freq first) as required by the CAVLC syntax.
+	@param blk				: Block index in _blkParam[] order.
+	@param dcSkipFlag	: Exclude the 1st coeff.
+	@param level			: Returned levels (min. 16 elements).
+	@param run				: Returned runs before each level (min. 16 elements).
+	@param totalZeros	: Returned total zeros before the last coeff.
+	@return						: TotalCoeff.
+	*/
+	int RunLevel(int blk, int dcSkipFlag, int* level, int* run, int* totalZeros);
+
+	/// Member access.
+	int GetSigMask(int blk, int dcSkipFlag) { return(_sigMask[blk] >> dcSkipFlag); }
+	int GetTotalCoeff(int blk, int dcSkipFlag) { return(BitCountOnes(_sigMask[blk] >> dcSkipFlag)); }
+	int GetTrailingOnes(int blk, int dcSkipFlag);
+	short* GetScan(int blk) { return(_scan[blk]); }
+
+	/// Bit scan utilities.
+	static int BitCountOnes(unsigned int x);
+	static int BitScanHigh(unsigned int x);	///< Pos of the most significant set bit. x must be non-zero.
+
+protected:
+	/// Scan a single 4x4 block.
+	void Scan4x4(short* pCoeff, short* pScan, unsigned short* pMask);
+
+/// Constants.
+protected:
+	static const int ZigZag4x4[16];
+	static const int CoeffTokenLen[4][17][4];
+	static const int CoeffTokenLenChrDc[5][4];
+	static const int TotalZerosLen4x4[15][16];
+	static const int TotalZerosLen2x2[3][4];
+	static const int RunBeforeLen[7][15];
+
+/// Persistant data valid after a Scan() call.
+protected:
+	short						_scan[MBH264_NUM_BLKS][16];	///< Coeffs in zig-zag order.
+	unsigned short	_sigMask[MBH264_NUM_BLKS];	///< Bit k set for non-zero coeff at scan pos k.
+	int							_maxCoeffs[MBH264_NUM_BLKS];///< 16 for 4x4 blocks and 4 for 2x2 blocks.
+
+};// end class CAVLCH264BlkScan.
+
+#endif	// _CAVLCH264BLKSCAN_H
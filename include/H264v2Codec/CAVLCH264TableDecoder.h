@@ -0,0 +1,142 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: CAVLCH264TableDecoder.h
+
+DESCRIPTION		: A non-virtual table driven CAVLC decoder for 4x4 and 2x2 chr DC blocks.
+								Each coeff_token, total_zeros and run_before symbol is resolved with one
+								or two lookups indexed by the peeked stream bits.
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+#ifndef _CAVLCH264TABLEDECODER_H
+#define _CAVLCH264TABLEDECODER_H
+
+#pragma once
+
+#include "BlockH264.h"
+#include "BitStreamReaderCache64.h"
+
+/// Entries in the lookup table pool for all the vlc tables.
+#define CAVLCH264TABLEDECODER_POOL_LEN	3072
+
+/*
+---------------------------------------------------------------------------
+	Class definition.
+---------------------------------------------------------------------------
+*/
+class CAVLCH264TableDecoder
+{
+public:
+	CAVLCH264TableDecoder(void);
+	virtual ~CAVLCH264TableDecoder(void);
+
+public:
+	/** Decode a block from the stream.
+	The block is zeroed and loaded with the decoded coeffs in raster order and the 
+	number of coeffs is set for use as a neighbourhood context.
+	@param bsr				: Stream to read from.
+	@param pBlk				: Block to decode into (4x4 or 2x2 chr DC).
+	@param nC					: Neighbourhood coeff context (-1 for 2x2 chr DC).
+	@param dcSkipFlag	: Exclude the 1st coeff (Intra_16x16 and chr AC blocks).
+	@return						: Bits consumed, -1 for an invalid vlc.
+	*/
+	int Decode(BitStreamReaderCache64* bsr, BlockH264* pBlk, int nC, int dcSkipFlag);
+
+	/// Member access.
+	int IsValid(void) { return(_valid); }
+
+protected:
+	typedef struct _CAVLCH264TABLEDECODER_ENTRY
+	{
+		short					value;		///< Symbol, sub table offset or -1 for no valid code.
+		unsigned char	length;		///< Total code length, 0 for a sub table or no valid code.
+		unsigned char	subBits;	///< Index bits of the sub table.
+	} CAVLCH264TABLEDECODER_ENTRY;
+
+	/// Vlc table index.
+	enum
+	{
+		CoeffToken			= 0,	///< nC ranges 0, 1, 2, 3 and chr DC.
+		TotalZeros4x4		= 5,	///< TotalCoeff 1..15.
+		TotalZeros2x2		= 20,	///< TotalCoeff 1..3.
+		RunBefore				= 23,	///< zerosLeft 1..6 and > 6.
+		NumTables				= 30
+	};
+
+	int	Build(int table, const int* code, const int* len, int numCodes, int rootBits);
+
+	/** Decode a symbol with the peeked bits.
+	@param bsr		: Stream to read from.
+	@param table	: Vlc table index.
+	@return				: Symbol, -1 for no valid code.
+	*/
+	int Lookup(BitStreamReaderCache64* bsr, int table)
+	{
+		unsigned int bits = bsr->Peek(16);	///< Longest code is 16 bits.
+		int rootBits = _rootBits[table];
+		const CAVLCH264TABLEDECODER_ENTRY* e = &(_pool[_root[table] + (bits >> (16 - rootBits))]);
+		if (e->subBits)
+			e = &(_pool[e->value + ((bits >> (16 - rootBits - e->subBits)) & ((1 << e->subBits) - 1))]);
+		bsr->Skip(e->length);
+		return(e->value);
+	}//end Lookup.
+
+/// Constants.
+protected:
+	static const int ZigZag4x4[16];
+	static const int Raster2x2[4];
+	static const int CoeffTokenCode[4][17][4];
+	static const int CoeffTokenLen[4][17][4];
+	static const int CoeffTokenCodeChrDc[5][4];
+	static const int CoeffTokenLenChrDc[5][4];
+	static const int TotalZerosCode4x4[15][16];
+	static const int TotalZerosLen4x4[15][16];
+	static const int TotalZerosCode2x2[3][4];
+	static const int TotalZerosLen2x2[3][4];
+	static const int RunBeforeCode[7][15];
+	static const int RunBeforeLen[7][15];
+
+/// Persistant data.
+protected:
+	CAVLCH264TABLEDECODER_ENTRY	_pool[CAVLCH264TABLEDECODER_POOL_LEN];	///< All root and sub tables.
+	int													_poolLen;								///< Entries in use.
+	int													_root[NumTables];				///< Pool offset of each root table.
+	int													_rootBits[NumTables];		///< Index bits of each root table.
+	int													_valid;									///< All tables were built.
+
+};// end class CAVLCH264TableDecoder.
+
+#endif	// _CAVLCH264TABLEDECODER_H
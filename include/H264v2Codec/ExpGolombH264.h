@@ -0,0 +1,110 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: ExpGolombH264.h
+
+DESCRIPTION		: Inline Exp-Golomb ue(v) and se(v) code length and code number utilities
+								built on a count leading zeros instruction for use in the macroblock
+								layer readers, writers and bit counters.
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+#ifndef _EXPGOLOMBH264_H
+#define _EXPGOLOMBH264_H
+
+#pragma once
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/*
+---------------------------------------------------------------------------
+	Class definition.
+---------------------------------------------------------------------------
+*/
+class ExpGolombH264
+{
+public:
+	/** Count the leading zero bits of a word.
+	@param x	: Word that must be non-zero.
+	@return		: Leading zeros [0..31].
+	*/
+	static int LeadingZeros(unsigned int x)
+	{
+#if defined(__GNUC__)
+		return(__builtin_clz(x));
+#elif defined(_MSC_VER)
+		unsigned long pos;
+		_BitScanReverse(&pos, (unsigned long)x);
+		return(31 - (int)pos);
+#else
+		int zeros = 0;
+		while (!(x & 0x80000000))
+		{
+			x <<= 1;
+			zeros++;
+		}//end while x...
+		return(zeros);
+#endif
+	}//end LeadingZeros.
+
+	/** Code length of ue(v).
+	The code is codeNum + 1 preceded by one less zeros than its significant bits.
+	@param codeNum	: Code number [0..2^31-1].
+	@return					: Code length.
+	*/
+	static int UnsignedBits(unsigned int codeNum) { return(((31 - LeadingZeros(codeNum + 1)) << 1) + 1); }
+
+	/** Map a se(v) value to its code number.
+	Positive values map to odd and the rest to even code numbers.
+	@param value	: Signed value.
+	@return				: Code number.
+	*/
+	static unsigned int SignedCodeNum(int value)
+	{
+		int s = value >> 31;
+		return((((unsigned int)((value ^ s) - s)) << 1) - (((unsigned int)(-value)) >> 31));
+	}//end SignedCodeNum.
+
+	/** Code length of se(v).
+	@param value	: Signed value.
+	@return				: Code length.
+	*/
+	static int SignedBits(int value) { return(UnsignedBits(SignedCodeNum(value))); }
+
+};// end class ExpGolombH264.
+
+#endif	// _EXPGOLOMBH264_H
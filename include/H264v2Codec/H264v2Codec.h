@@ -54,6 +54,8 @@ RESTRICTIONS	: Redistribution and use in source and binary forms, with or withou
 #include "SliceHeaderH264.h"
 #include "SeqParamSetH264.h"
 #include "PicParamSetH264.h"
+#include "BitStreamWriterAcc64.h"
+#include "BitStreamReaderCache64.h"
 
 #ifdef _WIN32
 #include "Windows.h"
@@ -90,13 +92,14 @@ class IForwardTransform;
 class IInverseTransform;
 class VectorStructList;
 class IMotionEstimator;
-class IMotionCompensator;
 class IMotionVectorPredictor;
 class IVlcEncoder;
 class IVlcDecoder;
 class MacroBlockH264;
 class H264MbImgCache;
 class IRateControl;
+class CAVLCH264BlkScan;
+class CAVLCH264TableDecoder;
 
 /*
 ===========================================================================
@@ -129,9 +132,25 @@ class IRateControl;
 #define H264V2_MOTION_RES_HALF          1
 #define H264V2_MOTION_RES_FULL          2
 
+/// Reference picture rows of edge extension above and below the lum component (half for chr).
+#define H264V2_REF_BORDER               32
+#define H264V2_REF_PICS                 2   ///< Reference picture ring length.
+
+/// Session arena buffer alignment.
+#define H264V2_ARENA_ALIGN              64  ///< Byte alignment of every buffer carved from the arena.
+
+/// Session memory allocation policy flags - "allocation policy".
+#define H264V2_ALLOC_DEFAULT            0   ///< (Default) Heap allocation.
+#define H264V2_ALLOC_HUGE_PAGES         1   ///< Back the arena with 2MB transparent huge pages where supported (Linux madvise).
+#define H264V2_ALLOC_FIRST_TOUCH        2   ///< Reallocate and touch the arena in every Open() to place its pages on the NUMA node of the opening thread.
+#define H264V2_HUGE_PAGE_SIZE           (2 * 1024 * 1024)
+
 /// Seq and Pic param max encoded length.
 #define	H264V2_ENC_PARAM_LEN            32
 
+/// Entries in the NAL unit table of a coded access unit - "nalunits".
+#define H264V2_MAX_NAL_UNITS            1024
+
 /// Use non-reversible CCIR-601 colour conversions.
 //#define _CCIR601
 
@@ -147,6 +166,55 @@ typedef struct _H264V2_COORD
   int y;
 } H264V2_COORD;
 
+/// Picture colour component plane descriptor for the H264V2_YUV420P16_PLANES and
+/// H264V2_YUV420P8_PLANES in/out colour formats. Strides are row lengths in pels.
+typedef struct _H264V2_PLANES
+{
+  void* pY;
+  void* pU;
+  void* pV;
+  int   strideY;
+  int   strideU;
+  int   strideV;
+} H264V2_PLANES;
+
+/// Read-only view of the decoded picture for the H264V2_YUV420P16_VIEW out colour format. The
+/// view is valid while its token matches the "viewtoken" member, i.e. until the next call
+/// to Decode(), Restart() or Close().
+typedef struct _H264V2_PICTURE_VIEW
+{
+  H264V2_PLANES planes;
+  int           width;
+  int           height;
+  unsigned int  token;
+} H264V2_PICTURE_VIEW;
+
+/// Estimated per subsystem byte usage of a codec instance returned by the "memoryusage" member.
+/// The figures are computed from class and buffer sizes and are not measured. Objects from the
+/// Vpp library are counted at their class size and exclude their own internal buffers.
+typedef struct _H264V2_MEMORY_USAGE
+{
+  size_t instance;    ///< The codec object including its inline param set tables.
+  size_t paramSets;   ///< Inline seq and pic param set tables (included in instance).
+  size_t arena;       ///< Session arena reservation.
+  size_t pictures;    ///< Input, reference ring and crop picture planes (within arena).
+  size_t rdTables;    ///< Rate and distortion tables of the QP searches (within arena).
+  size_t macroblocks; ///< Macroblock objects (within arena).
+  size_t coding;      ///< Transform, vlc, CAVLC, bit stream and colour conversion objects.
+  size_t motion;      ///< Motion estimation and compensation objects.
+  size_t planeCoders; ///< Image plane encoders, decoders and rate controllers.
+  size_t total;       ///< Sum of instance, arena, coding, motion and planeCoders.
+} H264V2_MEMORY_USAGE;
+
+/// NAL unit boundary within an access unit. The offset is to the NAL header byte from the
+/// start of the access unit and the size excludes the start code or length prefix.
+typedef struct _H264V2_NAL_UNIT
+{
+  int offset;
+  int size;
+  int type;
+} H264V2_NAL_UNIT;
+
 
 /*
 ===========================================================================
@@ -182,6 +250,12 @@ public:
   int		Code(void* pSrc, void* pCmp, int codeParameter);
   int		Decode(void* pCmp, int bitLength, void* pDst);
 
+  /// Reuse of an open instance for a new stream.
+  void	ResetStream(void);
+
+  /// Macroblock motion compensation of CompensateMb() on explicit planes.
+  static void CompensatePels(short* const pRef[3], short* const pDst[3], int lumWidth, int lumHeight, int offLumX, int offLumY, int mvx, int mvy);
+
   /// ICodecInnerAccess Interface Implementation
 public:
   void* GetMember(const char* type, int* length);
@@ -214,6 +288,9 @@ private:
   int   _rateControlModelType;                          ///< "rate control model type"  (Only valid for mode of operation = 2, 4)
   int   _motionEstimationType;                          ///< "motion estimation type"
   int   _motionResolution;                              ///< "motion resolution"
+  int   _allocationPolicy;                              ///< "allocation policy"
+  int   _decodeOnly;                                    ///< "decode only"
+  int   _openDecodeOnly;                                ///< _decodeOnly latched by Open() for the session.
 
   /// Parameter set handling.
   int		_currSeqParam;																	///< "seq param set"
@@ -222,6 +299,8 @@ private:
   int   _prependParamSetsToIPic;                        ///< "prepend param sets to i-pictures"
 
   int		_startCodeEmulationPrevention;									///< "start code emulation prevention"
+  int		_nalLengthPrefix;																///< "nal length prefix"
+  int		_maxSliceBytes;																	///< "max slice bytes"
 
   /// -------------- Dynamic Parameters ------------------------------------------------------ 
   /// Set before Code()/Decode(). Remain in effect until modified.
@@ -251,10 +330,23 @@ private:
 
 /// Attributes
 private:
-  /// Intermediate input/output YCbCr image mem members.
+  /// Intermediate input/output YCbCr image mem members. The picture is coded at the
+  /// mod 16 dimensions and the visible _width x _height picture at (_cropX, _cropY) is
+  /// signalled with the seq param set frame cropping.
   int							_lumWidth;		/// pix width.
   int							_lumHeight;		/// pix height.
+  int							_cropX;				/// Visible picture origin within the coded picture.
+  int							_cropY;
+  unsigned char*	_pArena;			/// Single allocation holding the plain per-session buffers. Retained over Close().
+  size_t					_arenaSize;		/// Byte size of _pArena.
+  size_t					_arenaPos;		/// Next free byte offset into _pArena.
+  int							_arenaAligned;	/// _pArena is from the aligned allocator and not new[].
+  H264V2_MEMORY_USAGE	_memUsage;	/// Refreshed on reading the "memoryusage" member.
+  short*					_pCropMem;		/// Visible size YCbCr image for colour conversion of padded pictures.
   short*					_pLum;				/// Space to compress from and decompress to.
+  H264V2_PLANES		_inPlanes;		/// Descriptor of the input planes for callers to write into directly.
+  H264V2_PLANES		_outPlanes;		/// Caller registered output planes for decoding into.
+  unsigned int		_viewToken;		/// Current decoded picture view validity token.
   int							_chrWidth;
   int							_chrHeight;
   short*					_pChrU;
@@ -265,16 +357,22 @@ private:
   OverlayMem2Dv2*	_Cb;
   OverlayMem2Dv2*	_Cr;
 
-  /// Reference image mem members.
+  /// Reference image mem members. These select the current picture of the ring.
   short*					_pRLum;
   short*					_pRChrU;
   short*					_pRChrV;
 
-  /// 2-D overlays for YCbCr picture reference mem.
+  /// 2-D overlays for YCbCr picture reference mem of the current picture.
   OverlayMem2Dv2*	_RefLum;
   OverlayMem2Dv2*	_RefCb;
   OverlayMem2Dv2*	_RefCr;
 
+  /// Ring of reference pictures. The decoder predicts from the previous picture
+  /// and reconstructs into the next one. The encoder objects are bound to picture 0.
+  short*					_pRefPlane[H264V2_REF_PICS][3];
+  OverlayMem2Dv2*	_RefOverlay[H264V2_REF_PICS][3];
+  int							_refIndex;		///< Current picture in the ring.
+
   /// Temp 16x16 and 8x8 mem blocks for use during macroblock prediction.
   short*					_p16x16;
   OverlayMem2Dv2*	_16x16;
@@ -304,6 +402,12 @@ private:
   int					WritePicParamSet(IBitStreamWriter* bsw, int allowedBits, int* bitsUsed, int index);
   int					ReadPicParamSet(IBitStreamReader* bsr, int remainingBits, int* bitsUsed, int* idx, int* changedFlag);
   int					GetCodecParams(int picParamSet);
+  int					ReconfigureInPlace(void);
+  int					CreateParseObjects(void);
+  int					CreateRateControllers(void);
+  int					CreateMotionObjects(void);
+  IMotionEstimator*	CreateMotionEstimator(const void* pRef, int motionVectorRange);
+  void				UpdateMemoryUsage(void);
 
   int					WriteNALHeader(IBitStreamWriter* bsw, int allowedBits, int* bitsUsed);
   int					ReadNALHeader(IBitStreamReader* bsr, int remainingBits, int* bitsUsed);
@@ -313,10 +417,26 @@ private:
   int					WriteTrailingBits(IBitStreamWriter* bsw, int allowedBits, int* bitsUsed);
   int					ReadTrailingBits(IBitStreamReader* bsr, int remainingBits, int* bitsUsed);
 
-  int         InsertEmulationPrevention(IBitStreamWriter* bsw, int startOffset);
-  int         RemoveEmulationPrevention(IBitStreamReader* bsr);
-
+  int         InsertEmulationPrevention(IBitStreamWriter* bsw, int startOffset, int allowedBits);
+  int         EmulationPreventionBits(IBitStreamWriter* bsw, int startOffset);
+  int         EmulationReserveBits(int bits);
+  static int  EmulationPreventionBytes(const unsigned char* stream, int first, int endPos);
+  unsigned char* StreamScratch(int bytes);
+  short*      RefPackedCopy(int len);
+  int         RemoveEmulationPrevention(IBitStreamReader* bsr, int bitLength);
+  static int  UnescapeStream(const unsigned char* src, int len, unsigned char* dst);
+  static int  FindZeroBytePair(const unsigned char* stream, int from, int last);
+  static int  FindStartCodePrefix(const unsigned char* stream, int from, int endByte);
+  static int  RbspStopBitPos(const unsigned char* stream, int endByte);
+  int         AddNalUnit(int startByte, int type);
+  void        EndNalUnits(unsigned char* stream, int endByte);
+  static void PelsFrom8Bit(const unsigned char* pSrc, short* pDst, int len);
+  static void PelsTo8Bit(const short* pSrc, unsigned char* pDst, int len);
+
+  int					WritePictureHeaders(int bitLimit, int* pSliceStartByte);
   int					WriteSliceDataLayer(IBitStreamWriter* bsw, int allowedBits, int* bitsUsed);
+  int					WriteSlicedDataLayer(IBitStreamWriter* bsw, int allowedBits, int sliceBits, int* bitsUsed);
+  void				ResliceMacroBlock(MacroBlockH264* pMb);
   int					ReadSliceDataLayer(IBitStreamReader* bsr, int remainingBits, int* bitsUsed);
 
   int					WriteMacroBlockLayer(IBitStreamWriter* bsw, MacroBlockH264* pMb, int allowedBits, int* bitsUsed);
@@ -325,6 +445,17 @@ private:
   int					ReadMacroBlockLayer(IBitStreamReader* bsr, int remainingBits, int* bitsUsed);
 
   void				ApplyLoopFilter(void);
+  void				ExtendReferenceBorder(void);
+  void				LoadInputPlanes(H264V2_PLANES* pIn, int is8Bit);
+  void				StoreOutputPlanes(H264V2_PLANES* pOut, short* pY, short* pU, short* pV, int is8Bit);
+  int					CreateArena(size_t bytes);
+  void				DestroyArena(void);
+  void*				ArenaAlloc(size_t bytes);
+  void				SelectReference(int index);
+  void				CompensateMb(MacroBlockH264* pMb, int prevIndex, int mvx, int mvy);
+  static size_t ArenaBytes(size_t bytes) { return((bytes + (H264V2_ARENA_ALIGN - 1)) & ~((size_t)(H264V2_ARENA_ALIGN - 1))); }
+  static void CopyPlane(const short* pSrc, int srcStride, short* pDst, int dstStride, int width, int height);
+  static void PadPlane(short* pPlane, int visWidth, int visHeight, int width, int height);
   void				VerticalFilter(MacroBlockH264* pMb, short** img, int lumFlag, int rowOff, int colOff, int iter, int boundaryStrength);
   void				HorizontalFilter(MacroBlockH264* pMb, short** img, int lumFlag, int rowOff, int colOff, int iter, int boundaryStrength);
 
@@ -521,6 +652,14 @@ private:
 
   /// In-line methods. 
 
+  /// Macroblock distortion, rate and skip stores that write through to the frame wide tables.
+  inline void SetMbDistortion(MacroBlockH264* pMb, int qp, int d);
+  inline void SetMbRate(MacroBlockH264* pMb, int qp, int r);
+  inline void SetMbSkip(MacroBlockH264* pMb, int skip);
+  inline int MbDistortion(int mb, int qp) { return(_pMbDistortion[(qp * _mbLength) + mb]); }
+  inline int MbRate(int mb, int qp) { return(_pMbRate[(qp * _mbLength) + mb]); }
+  inline int MbSkip(int mb) { return((int)_pMbSkip[mb]); }
+
   /** Get the previous macroblock QP value.
   Picture and slice boundaries are considered in returning the
   neighbouring mb QP value.
@@ -650,6 +789,9 @@ private:
 	static const int dc4x4Scale[];
 	static const int dc2x2Scale[];
 
+	/// Coded block pattern me(v) mapping from code number for [Intra, Inter] macroblocks.
+	static const int codedBlkPatternMap[48][2];
+
 	/// Test sampling point coordinates for Intra_16x16 and Intra_8x8 prediction mode selection.
 	static const int test16X[];
 	static const int test16Y[];
@@ -688,6 +830,23 @@ private:
 	/// Compressed data stream access members.
 	IBitStreamWriter*			_pBitStreamWriter;
 	IBitStreamReader*			_pBitStreamReader;
+	BitStreamWriterAcc64	_bitAcc;	///< Accumulating front end to the stream writer for the skip runs, mb headers and prepended param sets.
+	BitStreamReaderCache64	_bitCache;	///< Cached front end to the stream reader for the slice data.
+	/// Persistent param set parsing objects for Decode() while the codec is not open and a
+	/// reader to preserve the stream over a re-Open(). Created once and held until destruction.
+	IBitStreamReader*			_pParseBitStreamReader;
+	IBitStreamReader*			_pSaveBitStreamReader;
+	IVlcDecoder*					_pParseUnsignedVlcDec;
+	IVlcDecoder*					_pParseSignedVlcDec;
+	/// Grow only scratch stream for emulation prevention processing. Held until destruction.
+	unsigned char*				_pStreamScratch;
+	int										_streamScratchLen;
+	/// Emulation prevention bits inserted into the last coded picture and the stream bits they escaped.
+	int										_emulationBits;
+	int										_emulationStreamBits;
+	/// Grow only contiguous copy of the reference for the "reference" member. Held until destruction.
+	short*								_pRefPacked;
+	int										_refPackedLen;
 
 	/// An input colour converter.
 	RGBtoYUV420Converter*	_pInColourConverter;
@@ -713,10 +872,13 @@ private:
 	///	Auto I-frame flags to indicate which macroblocks must be excluded
 	/// from the decision during the motion estimation process.
 	bool*									_autoIFrameIncluded;
+	/// Intra macroblocks re-encoded for a new slice neighbourhood in "max slice bytes" mode.
+	bool*									_mbRecoded;
 
-	IMotionEstimator*			  _pMotionEstimator;				///< Selected estimator dependent on mode.
+	IMotionEstimator*			  _pMotionEstimator;				///< Estimator of the current ring picture.
+	IMotionEstimator*			  _pRefMotionEstimator[H264V2_REF_PICS];	///< Estimator bound to each ring picture, selected with the ref.
+	size_t									_motionEstimatorBytes;		///< Class size of the ring estimators recorded at creation.
 	VectorStructList*			  _pMotionEstimationResult;	///< Motion vector list generated by estimator.
-	IMotionCompensator*		  _pMotionCompensator;			///< Selected compensator dependent on mode.
 	VectorStructList*			  _pMotionVectors;					///< Motion vector list input to compensators.
   IMotionVectorPredictor* _pMotionPredictor;        ///< Predictor for motion vector from neighbouring mbs.
 
@@ -745,6 +907,10 @@ private:
 	/// Context-Aware vlc codecs for each block size.
 	IContextAwareRunLevelCodec* _pCAVLC4x4;
 	IContextAwareRunLevelCodec* _pCAVLC2x2;
+	/// Macroblock zig-zag and significance mask pre-pass for CAVLC bit counting.
+	CAVLCH264BlkScan*	_pBlkScan;
+	/// Table driven CAVLC decoder for the slice data.
+	CAVLCH264TableDecoder*	_pCAVLCDec;
 	/// General header vlc encoders and decoders.
 	IVlcEncoder*	_pHeaderUnsignedVlcEnc;
 	IVlcDecoder*	_pHeaderUnsignedVlcDec;
@@ -755,6 +921,11 @@ private:
 	int								_mbLength;	///< No. of 16 x 16 macroblocks for this image size.
 	MacroBlockH264*		_pMb;				///< Base macroblock linear reference.
 	MacroBlockH264**	_Mb;				///< Macroblock 2-D reference.
+	/// Structure-of-arrays copies of the macroblock distortion and rate per QP in [qp][mb] order
+	/// and the skip flags. The frame wide QP searches stream through these.
+	int*							_pMbDistortion;
+	int*							_pMbRate;
+	unsigned char*		_pMbSkip;
 
 	/// Internal picture properties. (For now)
 
@@ -767,6 +938,9 @@ private:
   unsigned char   _pEncSeqParam[H264V2_ENC_PARAM_LEN];    ///< Cached current encoded seq param set. (32 bytes)
   int             _encPicParamByteLen;
   unsigned char   _pEncPicParam[H264V2_ENC_PARAM_LEN];    ///< Cached current encoded pic param set. (32 bytes)
+  /// NAL units of the last coded access unit with the "nalunits" member.
+  H264V2_NAL_UNIT _nalUnit[H264V2_MAX_NAL_UNITS];
+  int             _numNalUnits;
 
 	/// H.264 has inter prediction mechanisms that permit multiple refrence pictures/frames and
 	/// control parameters to maintain a list of these references. However, in this implementation
@@ -785,6 +959,7 @@ private:
 	/// Image plane encoders/decoders. 
 	IImagePlaneEncoder*		_pIntraImgPlaneEncoder;
 	IImagePlaneEncoder*		_pInterImgPlaneEncoder;
+	size_t								_planeEncoderBytes;	///< Plane encoder and rate controller bytes recorded at creation.
 	IImagePlaneDecoder*		_pIntraImgPlaneDecoder;
 	IImagePlaneDecoder*		_pInterImgPlaneDecoder;
 
@@ -0,0 +1,135 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: RtpPacketizerH264.h
+
+DESCRIPTION		: Packetize coded H.264 access units into RFC 6184 RTP packets
+								described by scatter/gather vectors into the coded stream.
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+#ifndef _RTPPACKETIZERH264_H
+#define _RTPPACKETIZERH264_H
+
+#pragma once
+
+#include <stddef.h>
+
+#include "H264v2Codec.h"
+
+#define RTPPACKETIZERH264_HEADER_LEN	12	///< Fixed RTP header without CSRCs.
+#define RTPPACKETIZERH264_STAP_A			24	///< Single-time aggregation packet type.
+#define RTPPACKETIZERH264_FU_A				28	///< Fragmentation unit type.
+
+/// Scatter/gather element. It has the member layout of the POSIX struct iovec and an
+/// array of them is passed directly as msghdr::msg_iov to sendmsg() and sendmmsg().
+typedef struct _RTPPACKETIZERH264_IOVEC
+{
+	void*		base;
+	size_t	len;
+} RTPPACKETIZERH264_IOVEC;
+
+/// One RTP packet as a run of consecutive scatter/gather elements.
+typedef struct _RTPPACKETIZERH264_PACKET
+{
+	int	firstIov;	///< Index of the first element in the GetIov() array.
+	int	numIov;		///< Elements in the packet.
+	int	bytes;		///< Packet byte length including the RTP header.
+} RTPPACKETIZERH264_PACKET;
+
+/*
+---------------------------------------------------------------------------
+	Class definition.
+---------------------------------------------------------------------------
+*/
+/** RFC 6184 non-interleaved mode packetizer.
+An access unit from Code() is split into RTP packets using its "nalunits" table so
+the stream is never scanned. Parameter sets and other non-slice NAL units that fit
+together are aggregated into a STAP-A packet, a NAL unit that fits the payload is
+sent as a single NAL unit packet and larger ones are fragmented into FU-A packets.
+The payload elements point into the coded stream and only the RTP, aggregation and
+fragmentation headers are held by the packetizer. The descriptors are valid until
+the next call to Packetize() and while the coded stream is unchanged.
+*/
+class RtpPacketizerH264
+{
+public:
+	RtpPacketizerH264(void);
+	virtual ~RtpPacketizerH264(void);
+
+public:
+	int		Create(int maxPayloadBytes, int maxPackets);
+	void	Destroy(void);
+
+	int		Packetize(const void* pStream, const H264V2_NAL_UNIT* pNal, int numNal, unsigned int timestamp);
+
+	/// Member access.
+	void		SetPayloadType(int payloadType) { _payloadType = payloadType & 0x7F; }
+	void		SetSsrc(unsigned int ssrc) { _ssrc = ssrc; }
+	void		SetSequenceNumber(unsigned short seq) { _seq = seq; }
+	unsigned short GetSequenceNumber(void) { return(_seq); }
+	int			GetMaxPayloadBytes(void) { return(_maxPayload); }
+
+	/// Results of the last Packetize() call.
+	int															GetNumPackets(void) { return(_numPackets); }
+	const RTPPACKETIZERH264_PACKET*	GetPackets(void) { return(_pPacket); }
+	int															GetNumIov(void) { return(_numIov); }
+	RTPPACKETIZERH264_IOVEC*				GetIov(void) { return(_pIov); }
+
+protected:
+	unsigned char*	StartPacket(int headerLen, int marker);
+	int							AddIov(const void* base, int len);
+
+/// Persistant data.
+protected:
+	int												_maxPayload;		///< RTP payload bytes per packet (MTU less the IP, UDP and RTP headers).
+	int												_maxPackets;
+	int												_maxIov;
+	int												_payloadType;
+	unsigned int							_ssrc;
+	unsigned short						_seq;						///< Sequence number of the next packet.
+	unsigned int							_timestamp;			///< Of the access unit being packetized.
+
+	RTPPACKETIZERH264_PACKET*	_pPacket;
+	int												_numPackets;
+	RTPPACKETIZERH264_IOVEC*	_pIov;
+	int												_numIov;
+	unsigned char*						_pHeader;				///< RTP header and payload header of each packet.
+	unsigned char*						_pSizes;				///< STAP-A NAL unit sizes.
+	int												_sizesPos;
+
+};// end class RtpPacketizerH264.
+
+#endif	// _RTPPACKETIZERH264_H
@@ -0,0 +1,385 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: AnnexBSplitterH264.cpp
+
+DESCRIPTION		: Assemble H.264 access units from an Annex B byte stream that
+								arrives in arbitrary chunks.
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "AnnexBSplitterH264.h"
+
+#ifdef ANNEXBSPLITTERH264_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/*
+---------------------------------------------------------------------------
+	Construction and destruction.
+---------------------------------------------------------------------------
+*/
+AnnexBSplitterH264::AnnexBSplitterH264(void)
+{
+	_pBuf = NULL;
+	_size = 0;
+	Reset();
+}//end constructor.
+
+AnnexBSplitterH264::~AnnexBSplitterH264(void)
+{
+	Destroy();
+}//end destructor.
+
+/*
+---------------------------------------------------------------------------
+	Public methods.
+---------------------------------------------------------------------------
+*/
+/** Allocate the assembly buffer.
+The buffer grows when an access unit does not fit but is best created large enough
+for the largest expected access unit plus a pushed chunk.
+@param bufferBytes	: Initial buffer size.
+@return							: 1 = success, 0 = failure.
+*/
+int AnnexBSplitterH264::Create(int bufferBytes)
+{
+	Destroy();
+
+	if (bufferBytes < 16)
+		bufferBytes = 16;
+	_pBuf = new unsigned char[bufferBytes];
+	if (_pBuf == NULL)
+		return(0);
+	_size = bufferBytes;
+
+	Reset();
+	return(1);
+}//end Create.
+
+void AnnexBSplitterH264::Destroy(void)
+{
+	if (_pBuf != NULL)
+		delete[] _pBuf;
+	_pBuf = NULL;
+	_size = 0;
+	Reset();
+}//end Destroy.
+
+/** Discard all held bytes to start a new stream.
+@return	: none.
+*/
+void AnnexBSplitterH264::Reset(void)
+{
+	_len = 0;
+	_scanPos = 0;
+	_endOfStream = 0;
+	_auStart = -1;
+	_auEnd = 0;
+	_auReady = 0;
+	_auHasVcl = 0;
+	_nextAuStart = 0;
+	_openNalStart = -1;
+	_openNalType = 0;
+	_numNalUnits = 0;
+	_numDroppedNalUnits = 0;
+}//end Reset.
+
+/** Append a chunk of the stream.
+The chunk is copied once into the assembly buffer. Pointers from a previous
+GetAccessUnit() call are not valid after this call.
+@param pData	: Stream bytes.
+@param len		: Bytes in pData.
+@return				: 1 = success, 0 = out of memory or the stream has been flushed.
+*/
+int AnnexBSplitterH264::Push(const void* pData, int len)
+{
+	if (_endOfStream || (len < 0) || ((pData == NULL) && len))
+		return(0);
+	if (!Reserve(len))
+		return(0);
+
+	memcpy((void *)(&(_pBuf[_len])), pData, len);
+	_len += len;
+	return(1);
+}//end Push.
+
+/** Mark the end of the stream.
+The last NAL unit is closed on the end of the held bytes and the final
+access unit is available from GetAccessUnit().
+@return	: none.
+*/
+void AnnexBSplitterH264::Flush(void)
+{
+	_endOfStream = 1;
+}//end Flush.
+
+/** Get the next complete access unit.
+The access unit is returned in place and remains valid until the next call to
+Push(), PopAccessUnit() or Reset(). Repeated calls return the same access unit.
+@param ppAu	: Set to the first start code of the access unit.
+@param pLen	: Set to its byte length.
+@return			: 1 = access unit available, 0 = more bytes are required.
+*/
+int AnnexBSplitterH264::GetAccessUnit(const unsigned char** ppAu, int* pLen)
+{
+	if (!_auReady)
+		Scan();
+	if (!_auReady)
+		return(0);
+
+	*ppAu = &(_pBuf[_auStart]);
+	*pLen = _auEnd - _auStart;
+	return(1);
+}//end GetAccessUnit.
+
+/** Release the access unit returned by GetAccessUnit().
+@return	: none.
+*/
+void AnnexBSplitterH264::PopAccessUnit(void)
+{
+	if (!_auReady)
+		return;
+
+	_auReady = 0;
+	_numNalUnits = 0;
+	_numDroppedNalUnits = 0;
+	if (_openNalStart >= 0)
+	{
+		/// The NAL unit that ended the access unit starts the next one.
+		_auStart = _nextAuStart;
+		_auHasVcl = (_openNalType >= 1) && (_openNalType <= 5);
+	}//end if _openNalStart...
+	else
+	{
+		_auStart = -1;
+		_auHasVcl = 0;
+	}//end else...
+}//end PopAccessUnit.
+
+/** Find the next 0x000001 start code prefix.
+The SIMD path compares 16 candidate positions at a time.
+@param stream	: Bytes to search.
+@param from		: First candidate position.
+@param last		: Last candidate position. The two bytes after it must be readable.
+@return				: Position of the first zero byte of the prefix, -1 if not found.
+*/
+int AnnexBSplitterH264::FindStartCode(const unsigned char* stream, int from, int last)
+{
+	int pos = from;
+
+#ifdef ANNEXBSPLITTERH264_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	for (; (pos + 15) <= last; pos += 16)
+	{
+		__m128i b0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(stream + pos)), zero);
+		__m128i b1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(stream + pos + 1)), zero);
+		__m128i b2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(stream + pos + 2)), one);
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(b0, b1), b2));
+		if (mask)
+		{
+#if defined(_MSC_VER)
+			unsigned long bit;
+			_BitScanForward(&bit, (unsigned long)mask);
+			return(pos + (int)bit);
+#else
+			return(pos + __builtin_ctz(mask));
+#endif
+		}//end if mask...
+	}//end for pos...
+#else
+	/// Every prefix has a zero byte at an odd offset in the word so words without one are skipped.
+	while (((pos + 3) <= last) && stream[pos + 1] && stream[pos + 3])
+		pos += 4;
+#endif
+
+	for (; pos <= last; pos++)
+	{
+		if ((stream[pos + 2] == 1) && (stream[pos] == 0) && (stream[pos + 1] == 0))
+			return(pos);
+	}//end for pos...
+
+	return(-1);
+}//end FindStartCode.
+
+/*
+---------------------------------------------------------------------------
+	Protected methods.
+---------------------------------------------------------------------------
+*/
+/** Advance through the held bytes until an access unit is complete.
+A new access unit starts at the first slice of a picture (first_mb_in_slice = 0,
+i.e. the first slice header bit is set) or at an SEI, SPS, PPS, AUD or reserved
+14..18 NAL unit that follows a slice NAL unit of the current access unit. The
+NAL header byte and the first slice header byte must be held before a start
+code is processed, otherwise the scan waits for more bytes.
+@return	: none.
+*/
+void AnnexBSplitterH264::Scan(void)
+{
+	while (!_auReady)
+	{
+		int sc = -1;
+		if (_len >= 3)
+			sc = FindStartCode(_pBuf, _scanPos, _len - 3);
+
+		if ((sc < 0) || (_endOfStream && ((sc + 3) >= _len)))
+		{
+			if (!_endOfStream)
+			{
+				/// A start code may straddle the end of the held bytes.
+				if ((_len - 2) > _scanPos)
+					_scanPos = _len - 2;
+				return;
+			}//end if !_endOfStream...
+
+			/// The last NAL unit ends with the stream. A trailing prefix without a NAL header is dropped.
+			_scanPos = _len;
+			if (_openNalStart < 0)
+				return;
+			int end = (sc < 0) ? _len : sc;
+			EndNalUnit(end);
+			_openNalStart = -1;
+			if (_numNalUnits)
+				_auReady = 1;
+			return;
+		}//end if sc...
+
+		if (!_endOfStream && ((sc + 4) >= _len))
+		{
+			_scanPos = sc;
+			return;
+		}//end if !_endOfStream...
+
+		int type = _pBuf[sc + 3] & 0x1F;
+		int vcl = (type >= 1) && (type <= 5);
+		int firstSlice = vcl && ((sc + 4) < _len) && (_pBuf[sc + 4] & 0x80);
+		int boundary = _auHasVcl && (firstSlice || ((type >= 6) && (type <= 9)) || ((type >= 14) && (type <= 18)));
+
+		if (_openNalStart >= 0)
+			EndNalUnit(sc);
+		else if (_auStart < 0)
+			_auStart = sc;
+
+		if (boundary)
+		{
+			_nextAuStart = _auEnd;
+			_auReady = 1;
+		}//end if boundary...
+		else if (vcl)
+			_auHasVcl = 1;
+
+		_openNalStart = sc + 3;
+		_openNalType = type;
+		_scanPos = sc + 3;
+	}//end while !_auReady...
+}//end Scan.
+
+/** Close the open NAL unit and add it to the table.
+Trailing zero bytes, including the leading zero of a 4 byte start code, are
+excluded from the NAL unit. _auEnd is moved to the end of the NAL unit.
+@param end	: Offset of the start code that ends the NAL unit.
+@return			: none.
+*/
+void AnnexBSplitterH264::EndNalUnit(int end)
+{
+	while ((end > _openNalStart) && (_pBuf[end - 1] == 0))
+		end--;
+
+	if (_numNalUnits < ANNEXBSPLITTERH264_MAX_NAL_UNITS)
+	{
+		_nalUnit[_numNalUnits].offset = _openNalStart - _auStart;
+		_nalUnit[_numNalUnits].size = end - _openNalStart;
+		_nalUnit[_numNalUnits].type = _openNalType;
+		_numNalUnits++;
+	}//end if _numNalUnits...
+	else
+		_numDroppedNalUnits++;
+	_auEnd = end;
+}//end EndNalUnit.
+
+/** Make space for more bytes.
+Bytes before the access unit being assembled are discarded first and the buffer
+is only enlarged if that is not enough. The table offsets are relative to the
+access unit start and are not affected.
+@param len	: Bytes required after the held bytes.
+@return			: 1 = success, 0 = out of memory.
+*/
+int AnnexBSplitterH264::Reserve(int len)
+{
+	if ((_len + len) <= _size)
+		return(1);
+
+	int keep = (_auStart >= 0) ? _auStart : _scanPos;
+	if (keep > 0)
+	{
+		memmove((void *)_pBuf, (const void *)(&(_pBuf[keep])), _len - keep);
+		_len -= keep;
+		_scanPos -= keep;
+		_auEnd -= keep;
+		_nextAuStart -= keep;
+		if (_auStart >= 0)
+			_auStart -= keep;
+		if (_openNalStart >= 0)
+			_openNalStart -= keep;
+	}//end if keep...
+
+	if ((_len + len) <= _size)
+		return(1);
+
+	int size = (_size > 0) ? _size : 16;
+	while (size < (_len + len))
+		size *= 2;
+	unsigned char* pBuf = new unsigned char[size];
+	if (pBuf == NULL)
+		return(0);
+	if (_len)
+		memcpy((void *)pBuf, (const void *)_pBuf, _len);
+	if (_pBuf != NULL)
+		delete[] _pBuf;
+	_pBuf = pBuf;
+	_size = size;
+
+	return(1);
+}//end Reserve.
+
@@ -0,0 +1,143 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: BitStreamReaderCache64.cpp
+
+DESCRIPTION		: A non-virtual bit stream reader that caches the stream in a 64 bit
+								register for peek and skip access. Reads beyond the end of the stream
+								return zeros so that callers need only check for exhaustion at
+								convenient points instead of after every symbol.
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+
+#include <stdlib.h>
+
+#include "BitStreamReaderCache64.h"
+
+/*
+---------------------------------------------------------------------------
+	Construction and destruction.
+---------------------------------------------------------------------------
+*/
+BitStreamReaderCache64::BitStreamReaderCache64(void)
+{
+	_pStream = NULL;
+	_byteSize = 0;
+	_bitSize = 0;
+	_bytePos = 0;
+	_bitPos = 0;
+	_cache = 0;
+	_cacheBits = 0;
+	_error = 0;
+}//end constructor.
+
+BitStreamReaderCache64::~BitStreamReaderCache64(void)
+{
+}//end destructor.
+
+/*
+---------------------------------------------------------------------------
+	Public methods.
+---------------------------------------------------------------------------
+*/
+/** Attach to a stream.
+The stream is only read and is not required to be padded.
+@param pStream	: Stream bytes.
+@param bitSize	: Bit length of the stream.
+@param bitPos		: Bit position to start reading from.
+@return					: none.
+*/
+void BitStreamReaderCache64::Attach(const void* pStream, int bitSize, int bitPos)
+{
+	_pStream = (const unsigned char*)pStream;
+	_bitSize = bitSize;
+	_byteSize = (bitSize + 7) / 8;
+	_error = 0;
+	Seek(bitPos);
+}//end Attach.
+
+/** Move the read position.
+The cache is discarded and loaded from the new position.
+@param bitPos	: Absolute bit position in the stream.
+@return				: none.
+*/
+void BitStreamReaderCache64::Seek(int bitPos)
+{
+	_bytePos = bitPos / 8;
+	_bitPos = _bytePos * 8;
+	_cache = 0;
+	_cacheBits = 0;
+	Refill();
+	Skip(bitPos % 8);
+}//end Seek.
+
+/*
+---------------------------------------------------------------------------
+	Protected methods.
+---------------------------------------------------------------------------
+*/
+/** Load the cache with at least 57 bits.
+Whole 64 bit words are loaded while there are 8 or more stream bytes left.
+The partial byte bits below the valid count are the true stream bits and
+are loaded again unchanged on the next refill. Beyond the end of the stream
+zeros are loaded.
+@return	: none.
+*/
+void BitStreamReaderCache64::Refill(void)
+{
+	if ((_bytePos + 8) <= _byteSize)
+	{
+		const unsigned char* p = &(_pStream[_bytePos]);
+		unsigned long long word = ((unsigned long long)p[0] << 56) | ((unsigned long long)p[1] << 48) |
+															((unsigned long long)p[2] << 40) | ((unsigned long long)p[3] << 32) |
+															((unsigned long long)p[4] << 24) | ((unsigned long long)p[5] << 16) |
+															((unsigned long long)p[6] << 8) | (unsigned long long)p[7];
+		_cache |= word >> _cacheBits;
+		int bytes = (63 - _cacheBits) >> 3;
+		_bytePos += bytes;
+		_cacheBits += bytes * 8;
+		return;
+	}//end if _bytePos...
+
+	/// Zero padded tail.
+	while (_cacheBits <= 56)
+	{
+		if (_bytePos < _byteSize)
+			_cache |= (unsigned long long)_pStream[_bytePos] << (56 - _cacheBits);
+		_bytePos++;
+		_cacheBits += 8;
+	}//end while _cacheBits...
+}//end Refill.
@@ -0,0 +1,99 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: BitStreamWriterAcc64.cpp
+
+DESCRIPTION		: A non-virtual bit stream writer front end that accumulates codes in a
+								64 bit register and passes them on to an IBitStreamWriter as whole 32
+								bit words. Aligned byte data is written in bulk. It is not an
+								IBitStreamWriter itself, so coders that take one, such as the CAVLC
+								coders, write to the attached writer after a Flush().
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+
+#include <stdlib.h>
+
+#include "BitStreamWriterAcc64.h"
+
+/*
+---------------------------------------------------------------------------
+	Construction and destruction.
+---------------------------------------------------------------------------
+*/
+BitStreamWriterAcc64::BitStreamWriterAcc64(void)
+{
+	_bsw = NULL;
+	_acc = 0;
+	_accBits = 0;
+}//end constructor.
+
+BitStreamWriterAcc64::~BitStreamWriterAcc64(void)
+{
+}//end destructor.
+
+/*
+---------------------------------------------------------------------------
+	Public methods.
+---------------------------------------------------------------------------
+*/
+/** Write a block of bytes.
+The bytes are packed 4 at a time into big endian words so that an aligned
+stream receives them as whole words.
+@param pBytes	: Bytes to write in stream order.
+@param len		: Number of bytes.
+@return				: none.
+*/
+void BitStreamWriterAcc64::WriteBytes(const unsigned char* pBytes, int len)
+{
+	int i = 0;
+	for (; (i + 4) <= len; i += 4)
+		Write(32, (int)(((unsigned int)pBytes[i] << 24) | ((unsigned int)pBytes[i + 1] << 16) | ((unsigned int)pBytes[i + 2] << 8) | (unsigned int)pBytes[i + 3]));
+	for (; i < len; i++)
+		Write(8, (int)pBytes[i]);
+}//end WriteBytes.
+
+/** Write all pending bits to the attached writer.
+Must be called before the attached writer is used directly.
+@return	: none.
+*/
+void BitStreamWriterAcc64::Flush(void)
+{
+	if (_accBits)
+		_bsw->Write(_accBits, (int)((unsigned int)(_acc & Mask(_accBits))));
+	_acc = 0;
+	_accBits = 0;
+}//end Flush.
+
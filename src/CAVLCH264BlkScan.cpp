@@ -0,0 +1,380 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: CAVLCH264BlkScan.cpp
+
+DESCRIPTION		: A macroblock pre-pass for CAVLC that zig-zag orders all the
+								coeff blocks at once and holds a significance bit mask per block.
+								TotalCoeff, TrailingOnes, levels and runs are then extracted with
+								bit scans and the CAVLC bit cost is counted from look up tables
+								without running the vlc encoders.
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "CAVLCH264BlkScan.h"
+
+#ifdef CAVLCH264BLKSCAN_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef CAVLCH264BLKSCAN_SSSE3
+#include <tmmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/*
+---------------------------------------------------------------------------
+	Constants.
+---------------------------------------------------------------------------
+*/
+/// Raster pos of each zig-zag scan pos for 4x4 frame blocks.
+const int CAVLCH264BlkScan::ZigZag4x4[16] = 
+{ 0, 1, 4, 8, 5, 2, 3, 6, 9, 12, 13, 10, 7, 11, 14, 15 };
+
+/// coeff_token code lengths [nC table][TotalCoeff][TrailingOnes] for the nC ranges
+/// 0 <= nC < 2, 2 <= nC < 4, 4 <= nC < 8 and 8 <= nC (6 bit FLC). Table 9-5.
+const int CAVLCH264BlkScan::CoeffTokenLen[4][17][4] =
+{
+	{ { 1, 0, 0, 0}, { 6, 2, 0, 0}, { 8, 6, 3, 0}, { 9, 8, 7, 5}, {10, 9, 8, 6}, 
+		{11,10, 9, 7}, {13,11,10, 8}, {13,13,11, 9}, {13,13,13,10}, {14,14,13,11}, 
+		{14,14,14,13}, {15,15,14,14}, {15,15,15,14}, {16,15,15,15}, {16,16,16,15}, 
+		{16,16,16,16}, {16,16,16,16} },
+	{ { 2, 0, 0, 0}, { 6, 2, 0, 0}, { 6, 5, 3, 0}, { 7, 6, 6, 4}, { 8, 6, 6, 4}, 
+		{ 8, 7, 7, 5}, { 9, 8, 8, 6}, {11, 9, 9, 6}, {11,11,11, 7}, {12,11,11, 9}, 
+		{12,12,12,11}, {12,12,12,11}, {13,13,13,12}, {13,13,13,13}, {13,14,13,13}, 
+		{14,14,14,13}, {14,14,14,14} },
+	{ { 4, 0, 0, 0}, { 6, 4, 0, 0}, { 6, 5, 4, 0}, { 6, 5, 5, 4}, { 7, 5, 5, 4}, 
+		{ 7, 5, 5, 4}, { 7, 6, 6, 4}, { 7, 6, 6, 4}, { 8, 7, 7, 5}, { 8, 8, 7, 6}, 
+		{ 9, 8, 8, 7}, { 9, 9, 8, 8}, { 9, 9, 9, 8}, {10, 9, 9, 9}, {10,10,10,10}, 
+		{10,10,10,10}, {10,10,10,10} },
+	{ { 6, 0, 0, 0}, { 6, 6, 0, 0}, { 6, 6, 6, 0}, { 6, 6, 6, 6}, { 6, 6, 6, 6}, 
+		{ 6, 6, 6, 6}, { 6, 6, 6, 6}, { 6, 6, 6, 6}, { 6, 6, 6, 6}, { 6, 6, 6, 6}, 
+		{ 6, 6, 6, 6}, { 6, 6, 6, 6}, { 6, 6, 6, 6}, { 6, 6, 6, 6}, { 6, 6, 6, 6}, 
+		{ 6, 6, 6, 6}, { 6, 6, 6, 6} }
+};
+
+/// coeff_token code lengths [TotalCoeff][TrailingOnes] for chr DC with nC = -1.
+const int CAVLCH264BlkScan::CoeffTokenLenChrDc[5][4] =
+{ { 2, 0, 0, 0}, { 6, 1, 0, 0}, { 6, 6, 3, 0}, { 6, 7, 7, 6}, { 6, 8, 8, 7} };
+
+/// total_zeros code lengths [TotalCoeff-1][total_zeros] for 4x4 blocks. Tables 9-7 and 9-8.
+const int CAVLCH264BlkScan::TotalZerosLen4x4[15][16] =
+{
+	{ 1, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 9},
+	{ 3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 6, 6, 6, 6, 0},
+	{ 4, 3, 3, 3, 4, 4, 3, 3, 4, 5, 5, 6, 5, 6, 0, 0},
+	{ 5, 3, 4, 4, 3, 3, 3, 4, 3, 4, 5, 5, 5, 0, 0, 0},
+	{ 4, 4, 4, 3, 3, 3, 3, 3, 4, 5, 4, 5, 0, 0, 0, 0},
+	{ 6, 5, 3, 3, 3, 3, 3, 3, 4, 3, 6, 0, 0, 0, 0, 0},
+	{ 6, 5, 3, 3, 3, 2, 3, 4, 3, 6, 0, 0, 0, 0, 0, 0},
+	{ 6, 4, 5, 3, 2, 2, 3, 3, 6, 0, 0, 0, 0, 0, 0, 0},
+	{ 6, 6, 4, 2, 2, 3, 2, 5, 0, 0, 0, 0, 0, 0, 0, 0},
+	{ 5, 5, 3, 2, 2, 2, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{ 4, 4, 3, 3, 1, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{ 4, 4, 2, 1, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{ 3, 3, 1, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{ 2, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{ 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
+};
+
+/// total_zeros code lengths [TotalCoeff-1][total_zeros] for 2x2 chr DC blocks. Table 9-9a.
+const int CAVLCH264BlkScan::TotalZerosLen2x2[3][4] =
+{ { 1, 2, 3, 3}, { 1, 2, 2, 0}, { 1, 1, 0, 0} };
+
+/// run_before code lengths [min(zerosLeft,7)-1][run_before]. Table 9-10.
+const int CAVLCH264BlkScan::RunBeforeLen[7][15] =
+{
+	{ 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{ 1, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{ 2, 2, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{ 2, 2, 2, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{ 2, 2, 3, 3, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{ 2, 3, 3, 3, 3, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0},
+	{ 3, 3, 3, 3, 3, 3, 3, 4, 5, 6, 7, 8, 9,10,11}
+};
+
+/*
+---------------------------------------------------------------------------
+	Construction and destruction.
+---------------------------------------------------------------------------
+*/
+CAVLCH264BlkScan::CAVLCH264BlkScan(void)
+{
+	memset((void *)_scan, 0, sizeof(_scan));
+	memset((void *)_sigMask, 0, sizeof(_sigMask));
+	for (int i = 0; i < MBH264_NUM_BLKS; i++)
+		_maxCoeffs[i] = 16;
+}//end constructor.
+
+CAVLCH264BlkScan::~CAVLCH264BlkScan(void)
+{
+}//end destructor.
+
+/*
+---------------------------------------------------------------------------
+	Public methods.
+---------------------------------------------------------------------------
+*/
+void CAVLCH264BlkScan::Scan(MacroBlockH264* pMb)
+{
+	for (int i = 0; i < MBH264_NUM_BLKS; i++)
+	{
+		BlockH264* pBlk = pMb->_blkParam[i].pBlk;
+		short* pCoeff = pBlk->GetBlk();
+
+		if ((pBlk->GetWidth() == 4) && (pBlk->GetHeight() == 4))
+		{
+			_maxCoeffs[i] = 16;
+			Scan4x4(pCoeff, _scan[i], &(_sigMask[i]));
+		}//end if 4x4...
+		else	///< 2x2 chr DC blocks have the same raster and scan order.
+		{
+			_maxCoeffs[i] = 4;
+			_scan[i][0] = pCoeff[0];
+			_scan[i][1] = pCoeff[1];
+			_scan[i][2] = pCoeff[2];
+			_scan[i][3] = pCoeff[3];
+			_sigMask[i] = (unsigned short)((pCoeff[0] != 0) | ((pCoeff[1] != 0) << 1) | ((pCoeff[2] != 0) << 2) | ((pCoeff[3] != 0) << 3));
+		}//end else...
+	}//end for i...
+}//end Scan.
+
+int CAVLCH264BlkScan::BitCount(int blk, int nC, int dcSkipFlag)
+{
+	int i;
+	int level[16];
+	int run[16];
+	int totalZeros;
+
+	int totalCoeff = RunLevel(blk, dcSkipFlag, level, run, &totalZeros);
+
+	/// Up to 3 trailing +/-1 levels at the high freq end are coded with their sign only.
+	int trailingOnes = 0;
+	while ((trailingOnes < totalCoeff) && (trailingOnes < 3) && ((level[trailingOnes] == 1) || (level[trailingOnes] == -1)))
+		trailingOnes++;
+
+	/// coeff_token.
+	int bits;
+	if (nC == -1)
+		bits = CoeffTokenLenChrDc[totalCoeff][trailingOnes];
+	else if (nC < 2)
+		bits = CoeffTokenLen[0][totalCoeff][trailingOnes];
+	else if (nC < 4)
+		bits = CoeffTokenLen[1][totalCoeff][trailingOnes];
+	else if (nC < 8)
+		bits = CoeffTokenLen[2][totalCoeff][trailingOnes];
+	else
+		bits = CoeffTokenLen[3][totalCoeff][trailingOnes];
+
+	if (!totalCoeff)
+		return(bits);
+
+	/// Trailing one signs.
+	bits += trailingOnes;
+
+	/// Levels with the adaptive suffix length.
+	int suffixLength = 0;
+	if ((totalCoeff > 10) && (trailingOnes < 3))
+		suffixLength = 1;
+	for (i = trailingOnes; i < totalCoeff; i++)
+	{
+		int lev = level[i];
+		int levelCode = (lev > 0) ? ((lev << 1) - 2) : (-(lev << 1) - 1);
+		if ((i == trailingOnes) && (trailingOnes < 3))
+			levelCode -= 2;
+
+		if (suffixLength == 0)
+		{
+			if (levelCode < 14)
+				bits += levelCode + 1;
+			else if (levelCode < 30)
+				bits += 19;	///< level_prefix = 14 with 4 bit suffix.
+			else
+				bits += 28;	///< level_prefix = 15 with 12 bit escape suffix.
+		}//end if suffixLength...
+		else
+		{
+			if (levelCode < (15 << suffixLength))
+				bits += (levelCode >> suffixLength) + 1 + suffixLength;
+			else
+				bits += 28;
+		}//end else...
+
+		if (suffixLength == 0)
+			suffixLength = 1;
+		if ((abs(lev) > (3 << (suffixLength - 1))) && (suffixLength < 6))
+			suffixLength++;
+	}//end for i...
+
+	/// total_zeros is implied when the block is full.
+	if (totalCoeff < (_maxCoeffs[blk] - dcSkipFlag))
+	{
+		if (_maxCoeffs[blk] == 4)
+			bits += TotalZerosLen2x2[totalCoeff - 1][totalZeros];
+		else
+			bits += TotalZerosLen4x4[totalCoeff - 1][totalZeros];
+	}//end if totalCoeff...
+
+	/// run_before for all but the lowest freq coeff while zeros remain.
+	int zerosLeft = totalZeros;
+	for (i = 0; (i < (totalCoeff - 1)) && (zerosLeft > 0); i++)
+	{
+		bits += RunBeforeLen[(zerosLeft > 7) ? 6 : (zerosLeft - 1)][run[i]];
+		zerosLeft -= run[i];
+	}//end for i...
+
+	return(bits);
+}//end BitCount.
+
+int CAVLCH264BlkScan::RunLevel(int blk, int dcSkipFlag, int* level, int* run, int* totalZeros)
+{
+	unsigned int mask = (unsigned int)(_sigMask[blk] >> dcSkipFlag);
+	short* pScan = &(_scan[blk][dcSkipFlag]);
+
+	*totalZeros = 0;
+	if (!mask)
+		return(0);
+
+	/// Walk the set bits from the highest scan pos down. The gap between
+	/// consecutive set bits is the run of zeros before the level.
+	int pos = BitScanHigh(mask);
+	*totalZeros = pos + 1 - BitCountOnes(mask);
+	int n = 0;
+	while (mask)
+	{
+		mask &= ~(1u << pos);
+		int next = mask ? BitScanHigh(mask) : -1;
+		level[n] = pScan[pos];
+		run[n] = pos - next - 1;
+		n++;
+		pos = next;
+	}//end while mask...
+
+	return(n);
+}//end RunLevel.
+
+int CAVLCH264BlkScan::GetTrailingOnes(int blk, int dcSkipFlag)
+{
+	unsigned int mask = (unsigned int)(_sigMask[blk] >> dcSkipFlag);
+	short* pScan = &(_scan[blk][dcSkipFlag]);
+
+	int trailingOnes = 0;
+	while (mask && (trailingOnes < 3))
+	{
+		int pos = BitScanHigh(mask);
+		if ((pScan[pos] != 1) && (pScan[pos] != -1))
+			break;
+		trailingOnes++;
+		mask &= ~(1u << pos);
+	}//end while mask...
+
+	return(trailingOnes);
+}//end GetTrailingOnes.
+
+int CAVLCH264BlkScan::BitCountOnes(unsigned int x)
+{
+#if defined(__GNUC__)
+	return(__builtin_popcount(x));
+#else
+	x = x - ((x >> 1) & 0x55555555);
+	x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+	x = (x + (x >> 4)) & 0x0F0F0F0F;
+	return((int)((x * 0x01010101) >> 24));
+#endif
+}//end BitCountOnes.
+
+int CAVLCH264BlkScan::BitScanHigh(unsigned int x)
+{
+#if defined(__GNUC__)
+	return(31 - __builtin_clz(x));
+#elif defined(_MSC_VER)
+	unsigned long pos;
+	_BitScanReverse(&pos, (unsigned long)x);
+	return((int)pos);
+#else
+	int pos = 0;
+	while (x >>= 1)
+		pos++;
+	return(pos);
+#endif
+}//end BitScanHigh.
+
+/*
+---------------------------------------------------------------------------
+	Protected methods.
+---------------------------------------------------------------------------
+*/
+/** Zig-zag order a 4x4 block and build its significance mask.
+@param pCoeff	: Raster ordered coeffs.
+@param pScan	: Returned zig-zag ordered coeffs.
+@param pMask	: Returned significance mask.
+@return				: none.
+*/
+void CAVLCH264BlkScan::Scan4x4(short* pCoeff, short* pScan, unsigned short* pMask)
+{
+#ifdef CAVLCH264BLKSCAN_SSSE3
+	/// Zig-zag with byte shuffles across the two halves of the block.
+	__m128i lo = _mm_loadu_si128((const __m128i *)pCoeff);
+	__m128i hi = _mm_loadu_si128((const __m128i *)(pCoeff + 8));
+	__m128i zzLo = _mm_or_si128(_mm_shuffle_epi8(lo, _mm_setr_epi8(0, 1, 2, 3, 8, 9, -1, -1, 10, 11, 4, 5, 6, 7, 12, 13)),
+															_mm_shuffle_epi8(hi, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 0, 1, -1, -1, -1, -1, -1, -1, -1, -1)));
+	__m128i zzHi = _mm_or_si128(_mm_shuffle_epi8(hi, _mm_setr_epi8(2, 3, 8, 9, 10, 11, 4, 5, -1, -1, 6, 7, 12, 13, 14, 15)),
+															_mm_shuffle_epi8(lo, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 14, 15, -1, -1, -1, -1, -1, -1)));
+	_mm_storeu_si128((__m128i *)pScan, zzLo);
+	_mm_storeu_si128((__m128i *)(pScan + 8), zzHi);
+#else
+	/// Branch free gather.
+	for (int k = 0; k < 16; k++)
+		pScan[k] = pCoeff[ZigZag4x4[k]];
+#endif
+
+#ifdef CAVLCH264BLKSCAN_SSE2
+	/// Compare all 16 scan coeffs to zero and collect the sign bits.
+	__m128i zero = _mm_setzero_si128();
+	__m128i z = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)pScan), zero),
+															_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)(pScan + 8)), zero));
+	*pMask = (unsigned short)(~_mm_movemask_epi8(z) & 0xFFFF);
+#else
+	unsigned int mask = 0;
+	for (int k = 0; k < 16; k++)
+		mask |= (unsigned int)(pScan[k] != 0) << k;
+	*pMask = (unsigned short)mask;
+#endif
+}//end Scan4x4.
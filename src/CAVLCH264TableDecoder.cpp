@@ -0,0 +1,433 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: CAVLCH264TableDecoder.cpp
+
+DESCRIPTION		: A non-virtual table driven CAVLC decoder for 4x4 and 2x2 chr DC blocks.
+								Each coeff_token, total_zeros and run_before symbol is resolved with one
+								or two lookups indexed by the peeked stream bits.
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "CAVLCH264TableDecoder.h"
+#include "ExpGolombH264.h"
+
+/*
+---------------------------------------------------------------------------
+	Constants.
+---------------------------------------------------------------------------
+*/
+/// Raster pos of each zig-zag scan pos for 4x4 frame blocks.
+const int CAVLCH264TableDecoder::ZigZag4x4[16] = 
+{ 0, 1, 4, 8, 5, 2, 3, 6, 9, 12, 13, 10, 7, 11, 14, 15 };
+
+/// 2x2 chr DC blocks have the same raster and scan order.
+const int CAVLCH264TableDecoder::Raster2x2[4] = 
+{ 0, 1, 2, 3 };
+
+/// coeff_token codes [nC table][TotalCoeff][TrailingOnes] for the nC ranges 0 <= nC < 2,
+/// 2 <= nC < 4, 4 <= nC < 8 and 8 <= nC. Table 9-5.
+const int CAVLCH264TableDecoder::CoeffTokenCode[4][17][4] =
+{
+	{ { 1, 0, 0, 0},
+		{ 5, 1, 0, 0}, { 7, 4, 1, 0}, { 7, 6, 5, 3}, { 7, 6, 5, 3},
+		{ 7, 6, 5, 4}, {15, 6, 5, 4}, {11,14, 5, 4}, { 8,10,13, 4},
+		{15,14, 9, 4}, {11,10,13,12}, {15,14, 9,12}, {11,10,13, 8},
+		{15, 1, 9,12}, {11,14,13, 8}, { 7,10, 9,12}, { 4, 6, 5, 8} },
+	{ { 3, 0, 0, 0},
+		{11, 2, 0, 0}, { 7, 7, 3, 0}, { 7,10, 9, 5}, { 7, 6, 5, 4},
+		{ 4, 6, 5, 6}, { 7, 6, 5, 8}, {15, 6, 5, 4}, {11,14,13, 4},
+		{15,10, 9, 4}, {11,14,13,12}, { 8,10, 9, 8}, {15,14,13,12},
+		{11,10, 9,12}, { 7,11, 6, 8}, { 9, 8,10, 1}, { 7, 6, 5, 4} },
+	{ {15, 0, 0, 0},
+		{15,14, 0, 0}, {11,15,13, 0}, { 8,12,14,12}, {15,10,11,11},
+		{11, 8, 9,10}, { 9,14,13, 9}, { 8,10, 9, 8}, {15,14,13,13},
+		{11,14,10,12}, {15,10,13,12}, {11,14, 9,12}, { 8,10,13, 8},
+		{13, 7, 9,12}, { 9,12,11,10}, { 5, 8, 7, 6}, { 1, 4, 3, 2} },
+	{ { 3, 0, 0, 0},
+		{ 0, 1, 0, 0}, { 4, 5, 6, 0}, { 8, 9,10,11}, {12,13,14,15},
+		{16,17,18,19}, {20,21,22,23}, {24,25,26,27}, {28,29,30,31},
+		{32,33,34,35}, {36,37,38,39}, {40,41,42,43}, {44,45,46,47},
+		{48,49,50,51}, {52,53,54,55}, {56,57,58,59}, {60,61,62,63} }
+};
+
+/// coeff_token codes and lengths [TotalCoeff][TrailingOnes] for chr DC with nC = -1.
+const int CAVLCH264TableDecoder::CoeffTokenCodeChrDc[5][4] =
+{ { 1, 0, 0, 0}, { 7, 1, 0, 0}, { 4, 6, 1, 0}, { 3, 3, 2, 5}, { 2, 3, 2, 0} };
+const int CAVLCH264TableDecoder::CoeffTokenLenChrDc[5][4] =
+{ { 2, 0, 0, 0}, { 6, 1, 0, 0}, { 6, 6, 3, 0}, { 6, 7, 7, 6}, { 6, 8, 8, 7} };
+
+/// coeff_token code lengths in the same order as the codes.
+const int CAVLCH264TableDecoder::CoeffTokenLen[4][17][4] =
+{
+	{ { 1, 0, 0, 0},
+		{ 6, 2, 0, 0}, { 8, 6, 3, 0}, { 9, 8, 7, 5}, {10, 9, 8, 6},
+		{11,10, 9, 7}, {13,11,10, 8}, {13,13,11, 9}, {13,13,13,10},
+		{14,14,13,11}, {14,14,14,13}, {15,15,14,14}, {15,15,15,14},
+		{16,15,15,15}, {16,16,16,15}, {16,16,16,16}, {16,16,16,16} },
+	{ { 2, 0, 0, 0},
+		{ 6, 2, 0, 0}, { 6, 5, 3, 0}, { 7, 6, 6, 4}, { 8, 6, 6, 4},
+		{ 8, 7, 7, 5}, { 9, 8, 8, 6}, {11, 9, 9, 6}, {11,11,11, 7},
+		{12,11,11, 9}, {12,12,12,11}, {12,12,12,11}, {13,13,13,12},
+		{13,13,13,13}, {13,14,13,13}, {14,14,14,13}, {14,14,14,14} },
+	{ { 4, 0, 0, 0},
+		{ 6, 4, 0, 0}, { 6, 5, 4, 0}, { 6, 5, 5, 4}, { 7, 5, 5, 4},
+		{ 7, 5, 5, 4}, { 7, 6, 6, 4}, { 7, 6, 6, 4}, { 8, 7, 7, 5},
+		{ 8, 8, 7, 6}, { 9, 8, 8, 7}, { 9, 9, 8, 8}, { 9, 9, 9, 8},
+		{10, 9, 9, 9}, {10,10,10,10}, {10,10,10,10}, {10,10,10,10} },
+	{ { 6, 0, 0, 0},
+		{ 6, 6, 0, 0}, { 6, 6, 6, 0}, { 6, 6, 6, 6}, { 6, 6, 6, 6},
+		{ 6, 6, 6, 6}, { 6, 6, 6, 6}, { 6, 6, 6, 6}, { 6, 6, 6, 6},
+		{ 6, 6, 6, 6}, { 6, 6, 6, 6}, { 6, 6, 6, 6}, { 6, 6, 6, 6},
+		{ 6, 6, 6, 6}, { 6, 6, 6, 6}, { 6, 6, 6, 6}, { 6, 6, 6, 6} }
+};
+
+/// total_zeros codes and lengths [TotalCoeff-1][total_zeros] for 4x4 blocks. Tables 9-7 and 9-8.
+const int CAVLCH264TableDecoder::TotalZerosCode4x4[15][16] =
+{
+	{1, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 1},
+	{7, 6, 5, 4, 3, 5, 4, 3, 2, 3, 2, 3, 2, 1, 0, 0},
+	{5, 7, 6, 5, 4, 3, 4, 3, 2, 3, 2, 1, 1, 0, 0, 0},
+	{3, 7, 5, 4, 6, 5, 4, 3, 3, 2, 2, 1, 0, 0, 0, 0},
+	{5, 4, 3, 7, 6, 5, 4, 3, 2, 1, 1, 0, 0, 0, 0, 0},
+	{1, 1, 7, 6, 5, 4, 3, 2, 1, 1, 0, 0, 0, 0, 0, 0},
+	{1, 1, 5, 4, 3, 3, 2, 1, 1, 0, 0, 0, 0, 0, 0, 0},
+	{1, 1, 1, 3, 3, 2, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0},
+	{1, 0, 1, 3, 2, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0},
+	{1, 0, 1, 3, 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 1, 1, 2, 1, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
+};
+const int CAVLCH264TableDecoder::TotalZerosLen4x4[15][16] =
+{
+	{1, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 9},
+	{3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 6, 6, 6, 6, 0},
+	{4, 3, 3, 3, 4, 4, 3, 3, 4, 5, 5, 6, 5, 6, 0, 0},
+	{5, 3, 4, 4, 3, 3, 3, 4, 3, 4, 5, 5, 5, 0, 0, 0},
+	{4, 4, 4, 3, 3, 3, 3, 3, 4, 5, 4, 5, 0, 0, 0, 0},
+	{6, 5, 3, 3, 3, 3, 3, 3, 4, 3, 6, 0, 0, 0, 0, 0},
+	{6, 5, 3, 3, 3, 2, 3, 4, 3, 6, 0, 0, 0, 0, 0, 0},
+	{6, 4, 5, 3, 2, 2, 3, 3, 6, 0, 0, 0, 0, 0, 0, 0},
+	{6, 6, 4, 2, 2, 3, 2, 5, 0, 0, 0, 0, 0, 0, 0, 0},
+	{5, 5, 3, 2, 2, 2, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{4, 4, 3, 3, 1, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{4, 4, 2, 1, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{3, 3, 1, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{2, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
+};
+
+/// total_zeros codes and lengths [TotalCoeff-1][total_zeros] for 2x2 chr DC blocks. Table 9-9a.
+const int CAVLCH264TableDecoder::TotalZerosCode2x2[3][4] =
+{ {1, 1, 1, 0}, {1, 1, 0, 0}, {1, 0, 0, 0} };
+const int CAVLCH264TableDecoder::TotalZerosLen2x2[3][4] =
+{ {1, 2, 3, 3}, {1, 2, 2, 0}, {1, 1, 0, 0} };
+
+/// run_before codes and lengths [min(zerosLeft,7)-1][run_before]. Table 9-10.
+const int CAVLCH264TableDecoder::RunBeforeCode[7][15] =
+{
+	{1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{3, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{3, 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{3, 2, 3, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{3, 0, 1, 3, 2, 5, 4, 0, 0, 0, 0, 0, 0, 0, 0},
+	{7, 6, 5, 4, 3, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1}
+};
+const int CAVLCH264TableDecoder::RunBeforeLen[7][15] =
+{
+	{ 1,  1,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0},
+	{ 1,  2,  2,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0},
+	{ 2,  2,  2,  2,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0},
+	{ 2,  2,  2,  3,  3,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0},
+	{ 2,  2,  3,  3,  3,  3,  0,  0,  0,  0,  0,  0,  0,  0,  0},
+	{ 2,  3,  3,  3,  3,  3,  3,  0,  0,  0,  0,  0,  0,  0,  0},
+	{ 3,  3,  3,  3,  3,  3,  3,  4,  5,  6,  7,  8,  9, 10, 11}
+};
+
+/*
+---------------------------------------------------------------------------
+	Construction and destruction.
+---------------------------------------------------------------------------
+*/
+CAVLCH264TableDecoder::CAVLCH264TableDecoder(void)
+{
+	int i;
+
+	_poolLen = 0;
+	_valid = 1;
+
+	/// coeff_token tables for each nC range followed by chr DC.
+	for (i = 0; i < 4; i++)
+		_valid &= Build(CoeffToken + i, &(CoeffTokenCode[i][0][0]), &(CoeffTokenLen[i][0][0]), 17 * 4, 8);
+	_valid &= Build(CoeffToken + 4, &(CoeffTokenCodeChrDc[0][0]), &(CoeffTokenLenChrDc[0][0]), 5 * 4, 8);
+
+	/// total_zeros tables selected by TotalCoeff.
+	for (i = 0; i < 15; i++)
+		_valid &= Build(TotalZeros4x4 + i, TotalZerosCode4x4[i], TotalZerosLen4x4[i], 16, 6);
+	for (i = 0; i < 3; i++)
+		_valid &= Build(TotalZeros2x2 + i, TotalZerosCode2x2[i], TotalZerosLen2x2[i], 4, 3);
+
+	/// run_before tables selected by zerosLeft.
+	for (i = 0; i < 7; i++)
+		_valid &= Build(RunBefore + i, RunBeforeCode[i], RunBeforeLen[i], 15, 3);
+
+}//end constructor.
+
+CAVLCH264TableDecoder::~CAVLCH264TableDecoder(void)
+{
+}//end destructor.
+
+/*
+---------------------------------------------------------------------------
+	Public methods.
+---------------------------------------------------------------------------
+*/
+int CAVLCH264TableDecoder::Decode(BitStreamReaderCache64* bsr, BlockH264* pBlk, int nC, int dcSkipFlag)
+{
+	int i;
+	int level[16];
+	int startPos = bsr->GetBitPos();
+
+	/// 2x2 chr DC blocks hold 4 coeffs and 4x4 blocks hold 16 less the skipped DC coeff.
+	int maxCoeffs = 16 - dcSkipFlag;
+	const int* pScan = &(ZigZag4x4[dcSkipFlag]);
+	if ((pBlk->GetWidth() != 4) || (pBlk->GetHeight() != 4))
+	{
+		maxCoeffs = 4;
+		pScan = Raster2x2;
+	}//end if 2x2...
+
+	/// coeff_token.
+	int table = CoeffToken + 3;
+	if (nC == -1)
+		table = CoeffToken + 4;
+	else if (nC < 2)
+		table = CoeffToken;
+	else if (nC < 4)
+		table = CoeffToken + 1;
+	else if (nC < 8)
+		table = CoeffToken + 2;
+	int token = Lookup(bsr, table);
+	if (token < 0)
+		return(-1);
+	int totalCoeff = token >> 2;
+	int trailingOnes = token & 3;
+	if (totalCoeff > maxCoeffs)
+		return(-1);
+
+	pBlk->Zero();
+	pBlk->SetNumCoeffs(totalCoeff);
+	if (!totalCoeff)
+		return(bsr->GetBitPos() - startPos);
+
+	/// Trailing one signs in reverse scan order.
+	for (i = 0; i < trailingOnes; i++)
+		level[i] = 1 - (int)(bsr->Read(1) << 1);
+
+	/// Levels with the adaptive suffix length.
+	int suffixLength = 0;
+	if ((totalCoeff > 10) && (trailingOnes < 3))
+		suffixLength = 1;
+	for (; i < totalCoeff; i++)
+	{
+		unsigned int bits = bsr->Peek(32);
+		if (!bits)
+			return(-1);
+		int levelPrefix = ExpGolombH264::LeadingZeros(bits);
+		bsr->Skip(levelPrefix + 1);
+
+		int levelSuffixSize = suffixLength;
+		if ((levelPrefix == 14) && (suffixLength == 0))
+			levelSuffixSize = 4;
+		else if (levelPrefix >= 15)
+			levelSuffixSize = levelPrefix - 3;
+
+		int levelCode = ((levelPrefix < 15) ? levelPrefix : 15) << suffixLength;
+		if (levelSuffixSize)
+			levelCode += (int)bsr->Read(levelSuffixSize);
+		if ((levelPrefix >= 15) && (suffixLength == 0))
+			levelCode += 15;
+		if (levelPrefix >= 16)
+			levelCode += (1 << (levelPrefix - 3)) - 4096;
+		if ((i == trailingOnes) && (trailingOnes < 3))
+			levelCode += 2;
+
+		if (levelCode & 1)
+			level[i] = (-levelCode - 1) >> 1;
+		else
+			level[i] = (levelCode + 2) >> 1;
+
+		if (suffixLength == 0)
+			suffixLength = 1;
+		if ((abs(level[i]) > (3 << (suffixLength - 1))) && (suffixLength < 6))
+			suffixLength++;
+	}//end for i...
+
+	/// total_zeros is implied when the block is full.
+	int totalZeros = 0;
+	if (totalCoeff < maxCoeffs)
+	{
+		if (maxCoeffs == 4)
+			totalZeros = Lookup(bsr, TotalZeros2x2 + totalCoeff - 1);
+		else
+			totalZeros = Lookup(bsr, TotalZeros4x4 + totalCoeff - 1);
+		if ((totalZeros < 0) || ((totalZeros + totalCoeff) > maxCoeffs))
+			return(-1);
+	}//end if totalCoeff...
+
+	/// Place the levels from the highest scan pos down with the run_before
+	/// zeros between them. The lowest freq coeff takes the zeros left.
+	short* pCoeff = pBlk->GetBlk();
+	int zerosLeft = totalZeros;
+	int pos = totalCoeff + totalZeros - 1;
+	for (i = 0; i < (totalCoeff - 1); i++)
+	{
+		pCoeff[pScan[pos]] = (short)level[i];
+		int run = 0;
+		if (zerosLeft > 0)
+		{
+			run = Lookup(bsr, RunBefore + ((zerosLeft > 7) ? 6 : (zerosLeft - 1)));
+			if ((run < 0) || (run > zerosLeft))
+				return(-1);
+			zerosLeft -= run;
+		}//end if zerosLeft...
+		pos -= run + 1;
+	}//end for i...
+	pCoeff[pScan[pos]] = (short)level[totalCoeff - 1];
+
+	return(bsr->GetBitPos() - startPos);
+}//end Decode.
+
+/*
+---------------------------------------------------------------------------
+	Protected methods.
+---------------------------------------------------------------------------
+*/
+/** Build the lookup tables for a vlc table.
+Codes no longer than the root index bits are replicated across the root
+table. Longer codes are placed in sub tables indexed by the remaining bits
+that hang off the root entry of their leading bits. The symbol of each code
+is its position in the code list.
+@param table			: Vlc table index.
+@param code				: Code list.
+@param len				: Code lengths, 0 for an unused symbol.
+@param numCodes		: Length of the code list.
+@param rootBits		: Root table index bits.
+@return						: 1 = success, 0 = pool too small.
+*/
+int CAVLCH264TableDecoder::Build(int table, const int* code, const int* len, int numCodes, int rootBits)
+{
+	int i, j;
+	int rootLen = 1 << rootBits;
+
+	if ((_poolLen + rootLen) > CAVLCH264TABLEDECODER_POOL_LEN)
+		return(0);
+	_root[table] = _poolLen;
+	_rootBits[table] = rootBits;
+	CAVLCH264TABLEDECODER_ENTRY* pRoot = &(_pool[_poolLen]);
+	_poolLen += rootLen;
+
+	for (j = 0; j < rootLen; j++)
+	{
+		pRoot[j].value = -1;
+		pRoot[j].length = 0;
+		pRoot[j].subBits = 0;
+	}//end for j...
+
+	/// Short codes fill the root and long codes size the sub tables of their leading bits.
+	for (i = 0; i < numCodes; i++)
+	{
+		if (!len[i])
+			continue;
+		if (len[i] <= rootBits)
+		{
+			int first = code[i] << (rootBits - len[i]);
+			for (j = 0; j < (1 << (rootBits - len[i])); j++)
+			{
+				pRoot[first + j].value = (short)i;
+				pRoot[first + j].length = (unsigned char)len[i];
+			}//end for j...
+		}//end if len...
+		else
+		{
+			CAVLCH264TABLEDECODER_ENTRY* e = &(pRoot[code[i] >> (len[i] - rootBits)]);
+			if ((len[i] - rootBits) > e->subBits)
+				e->subBits = (unsigned char)(len[i] - rootBits);
+		}//end else...
+	}//end for i...
+
+	/// Allocate the sub tables.
+	for (j = 0; j < rootLen; j++)
+	{
+		if (!pRoot[j].subBits)
+			continue;
+		int subLen = 1 << pRoot[j].subBits;
+		if ((_poolLen + subLen) > CAVLCH264TABLEDECODER_POOL_LEN)
+			return(0);
+		pRoot[j].value = (short)_poolLen;
+		for (i = 0; i < subLen; i++)
+		{
+			_pool[_poolLen + i].value = -1;
+			_pool[_poolLen + i].length = 0;
+			_pool[_poolLen + i].subBits = 0;
+		}//end for i...
+		_poolLen += subLen;
+	}//end for j...
+
+	/// Fill the sub tables with the remaining bits of the long codes.
+	for (i = 0; i < numCodes; i++)
+	{
+		if (len[i] <= rootBits)
+			continue;
+		CAVLCH264TABLEDECODER_ENTRY* e = &(pRoot[code[i] >> (len[i] - rootBits)]);
+		int remBits = len[i] - rootBits;
+		int first = (code[i] & ((1 << remBits) - 1)) << (e->subBits - remBits);
+		for (j = 0; j < (1 << (e->subBits - remBits)); j++)
+		{
+			_pool[e->value + first + j].value = (short)i;
+			_pool[e->value + first + j].length = (unsigned char)len[i];
+		}//end for j...
+	}//end for i...
+
+	return(1);
+}//end Build.
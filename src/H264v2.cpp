@@ -47,6 +47,10 @@ OF THE POSSIBILITY OF SUCH DAMAGE.
 //
 
 #include "stdafx.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <mutex>
 #include "H264v2.h"
 
 #ifdef _WIN32
@@ -67,12 +71,93 @@ BOOL APIENTRY DllMain( HANDLE hModule,
 }
 #endif
 
+/// A warm pooled codec instance and its key.
+typedef struct _H264V2_POOL_ENTRY
+{
+	H264v2Codec*	pCodec;
+	int						width;
+	int						height;
+	int						inColour;
+	int						outColour;
+	int						modeOfOperation;
+	int						decodeOnly;
+	int						maxSliceBytes;
+	int						nalLengthPrefix;
+	int						allocationPolicy;
+	long long			releaseMs;	///< Time of release for idle eviction.
+} H264V2_POOL_ENTRY;
+
+/// The factory pool state held behind the exported H264v2Factory.
+class H264v2FactoryPool
+{
+public:
+	H264v2FactoryPool(void) { _pEntry = NULL; _len = 0; _maxLen = 0; _maxIdleMs = 0; }
+	~H264v2FactoryPool(void);
+
+	void							EvictEntries(long long nowMs, int keepLen);
+	static long long	NowMs(void);
+
+	H264V2_POOL_ENTRY*	_pEntry;
+	int									_len;				///< Warm instances in the pool.
+	int									_maxLen;		///< Max warm instances held.
+	int									_maxIdleMs;	///< Idle instances older than this are evicted. 0 = no idle eviction.
+	std::mutex					_mutex;
+};//end H264v2FactoryPool.
+
+H264v2FactoryPool::~H264v2FactoryPool(void)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	EvictEntries(NowMs(), 0);
+	if (_pEntry != NULL)
+		delete[] _pEntry;
+	_pEntry = NULL;
+	_maxLen = 0;
+}//end destructor.
+
+/** Evict idle instances and then the least recently released down to a length.
+The pool mutex must be held by the caller. The pool is ordered by release time.
+@param nowMs		: Current time.
+@param keepLen	: Max entries remaining after eviction.
+@return					: none.
+*/
+void H264v2FactoryPool::EvictEntries(long long nowMs, int keepLen)
+{
+	int i;
+	int evict = 0;
+	for (i = 0; i < _len; i++)
+	{
+		if (((_maxIdleMs > 0) && ((nowMs - _pEntry[i].releaseMs) > _maxIdleMs)) || ((_len - i) > keepLen))
+		{
+			delete _pEntry[i].pCodec;
+			evict++;
+		}//end if _maxIdleMs...
+		else
+			break;
+	}//end for i...
+
+	if (evict)
+	{
+		for (i = evict; i < _len; i++)
+			_pEntry[i - evict] = _pEntry[i];
+		_len -= evict;
+	}//end if evict...
+}//end EvictEntries.
+
+long long H264v2FactoryPool::NowMs(void)
+{
+	return((long long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}//end NowMs.
+
 H264v2Factory::H264v2Factory(void)
 {
+	_pPool = new H264v2FactoryPool();
 }//end constructor.
 
 H264v2Factory::~H264v2Factory(void)
 {
+	if (_pPool != NULL)
+		delete _pPool;
+	_pPool = NULL;
 }//end destructor.
 
 H264v2Codec* H264v2Factory::GetCodecInstance(void)
@@ -80,11 +165,182 @@ H264v2Codec* H264v2Factory::GetCodecInstance(void)
 	return(new H264v2Codec());
 }//end GetCodecInstance.
 
+/** Get an open codec instance for the stream type with the default session settings.
+@param width						: Picture width.
+@param height						: Picture height.
+@param inColour					: "incolour" parameter.
+@param outColour				: "outcolour" parameter.
+@param modeOfOperation	: "mode of operation" parameter.
+@return									: Codec instance, NULL if it cannot be instantiated.
+*/
+H264v2Codec* H264v2Factory::GetCodecInstance(int width, int height, int inColour, int outColour, int modeOfOperation)
+{
+	return(GetCodecInstance(width, height, inColour, outColour, modeOfOperation, 0, 0, 0, H264V2_ALLOC_DEFAULT));
+}//end GetCodecInstance.
+
+/** Get an open codec instance for the stream type and session settings.
+A warm pooled instance with a matching key is returned after ResetStream() was
+applied on its release. ResetStream() only clears the frame and rate control
+state, so the instance keeps the parameters it was released with. Otherwise a
+new instance is created with the key parameters and opened. Any other parameter
+that Open() applies, e.g. the motion estimation type, requires a further Open()
+after it is set on the returned instance. Check Ready() on the returned instance
+for the success of the Open().
+@param width						: Picture width.
+@param height						: Picture height.
+@param inColour					: "incolour" parameter.
+@param outColour				: "outcolour" parameter.
+@param modeOfOperation	: "mode of operation" parameter.
+@param decodeOnly				: "decode only" parameter.
+@param maxSliceBytes		: "max slice bytes" parameter.
+@param nalLengthPrefix	: "nal length prefix" parameter.
+@param allocationPolicy	: "allocation policy" parameter.
+@return									: Codec instance, NULL if it cannot be instantiated.
+*/
+H264v2Codec* H264v2Factory::GetCodecInstance(int width, int height, int inColour, int outColour, int modeOfOperation,
+																						 int decodeOnly, int maxSliceBytes, int nalLengthPrefix, int allocationPolicy)
+{
+	{
+		std::lock_guard<std::mutex> lock(_pPool->_mutex);
+		_pPool->EvictEntries(H264v2FactoryPool::NowMs(), _pPool->_len);
+
+		/// Most recently released first.
+		for (int i = _pPool->_len - 1; i >= 0; i--)
+		{
+			H264V2_POOL_ENTRY* pE = &(_pPool->_pEntry[i]);
+			if ((pE->width == width) && (pE->height == height) && (pE->inColour == inColour) &&
+				(pE->outColour == outColour) && (pE->modeOfOperation == modeOfOperation) &&
+				(pE->decodeOnly == decodeOnly) && (pE->maxSliceBytes == maxSliceBytes) &&
+				(pE->nalLengthPrefix == nalLengthPrefix) && (pE->allocationPolicy == allocationPolicy))
+			{
+				H264v2Codec* pCodec = pE->pCodec;
+				for (int j = i; j < (_pPool->_len - 1); j++)
+					_pPool->_pEntry[j] = _pPool->_pEntry[j + 1];
+				_pPool->_len--;
+				return(pCodec);
+			}//end if width...
+		}//end for i...
+	}
+
+	H264v2Codec* pCodec = new H264v2Codec();
+	if (pCodec == NULL)
+		return(NULL);
+
+	char val[16];
+	sprintf(val, "%d", width);
+	pCodec->SetParameter("width", val);
+	sprintf(val, "%d", height);
+	pCodec->SetParameter("height", val);
+	sprintf(val, "%d", inColour);
+	pCodec->SetParameter("incolour", val);
+	sprintf(val, "%d", outColour);
+	pCodec->SetParameter("outcolour", val);
+	sprintf(val, "%d", modeOfOperation);
+	pCodec->SetParameter("mode of operation", val);
+	sprintf(val, "%d", decodeOnly);
+	pCodec->SetParameter("decode only", val);
+	sprintf(val, "%d", maxSliceBytes);
+	pCodec->SetParameter("max slice bytes", val);
+	sprintf(val, "%d", nalLengthPrefix);
+	pCodec->SetParameter("nal length prefix", val);
+	sprintf(val, "%d", allocationPolicy);
+	pCodec->SetParameter("allocation policy", val);
+	pCodec->Open();
+
+	return(pCodec);
+}//end GetCodecInstance.
+
 void H264v2Factory::ReleaseCodecInstance(ICodecv2* pInst)
 {
 	if(pInst != NULL)
 	{
+		/// Only open instances of this codec are pooled.
+		H264v2Codec* pCodec = dynamic_cast<H264v2Codec *>(pInst);
+		if ((pCodec != NULL) && pCodec->Ready())
+		{
+			H264V2_POOL_ENTRY e;
+			char	val[32];
+			int		len;
+			e.pCodec = pCodec;
+			pCodec->GetParameter("width", &len, (void *)val);
+			e.width = atoi(val);
+			pCodec->GetParameter("height", &len, (void *)val);
+			e.height = atoi(val);
+			pCodec->GetParameter("incolour", &len, (void *)val);
+			e.inColour = atoi(val);
+			pCodec->GetParameter("outcolour", &len, (void *)val);
+			e.outColour = atoi(val);
+			pCodec->GetParameter("mode of operation", &len, (void *)val);
+			e.modeOfOperation = atoi(val);
+			pCodec->GetParameter("decode only", &len, (void *)val);
+			e.decodeOnly = atoi(val);
+			pCodec->GetParameter("max slice bytes", &len, (void *)val);
+			e.maxSliceBytes = atoi(val);
+			pCodec->GetParameter("nal length prefix", &len, (void *)val);
+			e.nalLengthPrefix = atoi(val);
+			pCodec->GetParameter("allocation policy", &len, (void *)val);
+			e.allocationPolicy = atoi(val);
+
+			std::lock_guard<std::mutex> lock(_pPool->_mutex);
+			if (_pPool->_maxLen > 0)
+			{
+				pCodec->ResetStream();
+				e.releaseMs = H264v2FactoryPool::NowMs();
+				/// Make space by evicting the idle and then the least recently released.
+				_pPool->EvictEntries(e.releaseMs, _pPool->_maxLen - 1);
+				_pPool->_pEntry[_pPool->_len++] = e;
+				return;
+			}//end if _maxLen...
+		}//end if pCodec...
+
 		delete pInst;
 		pInst = NULL;
 	}//end if pInst...
 }//end ReleaseCodecInstance.
+
+/** Set the pool limits.
+Reducing the limits evicts the excess instances.
+@param maxInstances	: Max warm instances held. 0 disables pooling.
+@param maxIdleMs		: Idle time after which an instance is evicted. 0 = never.
+@return							: 1 = success, 0 = failure.
+*/
+int H264v2Factory::SetPoolLimits(int maxInstances, int maxIdleMs)
+{
+	if ((maxInstances < 0) || (maxIdleMs < 0))
+		return(0);
+
+	std::lock_guard<std::mutex> lock(_pPool->_mutex);
+	_pPool->_maxIdleMs = maxIdleMs;
+	_pPool->EvictEntries(H264v2FactoryPool::NowMs(), maxInstances);
+
+	H264V2_POOL_ENTRY* pEntry = NULL;
+	if (maxInstances > 0)
+	{
+		pEntry = new H264V2_POOL_ENTRY[maxInstances];
+		if (pEntry == NULL)
+			return(0);
+		for (int i = 0; i < _pPool->_len; i++)
+			pEntry[i] = _pPool->_pEntry[i];
+	}//end if maxInstances...
+	if (_pPool->_pEntry != NULL)
+		delete[] _pPool->_pEntry;
+	_pPool->_pEntry = pEntry;
+	_pPool->_maxLen = maxInstances;
+
+	return(1);
+}//end SetPoolLimits.
+
+/** Evict the instances that have been idle for longer than the limit.
+@return	: none.
+*/
+void H264v2Factory::EvictIdle(void)
+{
+	std::lock_guard<std::mutex> lock(_pPool->_mutex);
+	_pPool->EvictEntries(H264v2FactoryPool::NowMs(), _pPool->_len);
+}//end EvictIdle.
+
+int H264v2Factory::GetPoolSize(void)
+{
+	std::lock_guard<std::mutex> lock(_pPool->_mutex);
+	return(_pPool->_len);
+}//end GetPoolSize.
@@ -54,6 +54,10 @@ RESTRICTIONS  : Redistribution and use in source and binary forms, with or witho
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
+#include <new>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
 
 #include "H264v2Codec.h"
 
@@ -70,7 +74,6 @@ RESTRICTIONS  : Redistribution and use in source and binary forms, with or witho
 #include "IRunLengthCodec.h"
 #include "VectorStructList.h"
 #include "IMotionEstimator.h"
-#include "IMotionCompensator.h"
 #include "IMotionVectorPredictor.h"
 #include "IVlcEncoder.h"
 #include "IVlcDecoder.h"
@@ -98,6 +101,9 @@ RESTRICTIONS  : Redistribution and use in source and binary forms, with or witho
 #include "FastInverse4x4On16x16ITImpl1.h"
 #include "CAVLCH264Impl.h"
 #include "CAVLCH264Impl2.h"
+#include "CAVLCH264BlkScan.h"
+#include "CAVLCH264TableDecoder.h"
+#include "ExpGolombH264.h"
 
 #include "MotionEstimatorH264ImplMultires.h"
 #include "MotionEstimatorH264ImplMultiresCross.h"
@@ -107,7 +113,6 @@ RESTRICTIONS  : Redistribution and use in source and binary forms, with or witho
 #include "MotionEstimatorH264ImplUMHS.h"
 #include "MotionEstimatorH264ImplFHS.h"
 #include "MotionEstimatorH264ImplTest.h"
-#include "MotionCompensatorH264ImplStd.h"
 #include "H264MotionVectorPredictorImpl1.h"
 
 
@@ -137,6 +142,15 @@ RESTRICTIONS  : Redistribution and use in source and binary forms, with or witho
 #include "RateControlImplLog.h"
 //#include "RateControlImplMultiModel.h"  An incomplete work in progress.
 
+/// SIMD stream scanning where the compiler exposes the instruction set.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define H264V2_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 /*
 ---------------------------------------------------------------------------
   Codec parameter constants.
@@ -158,9 +172,11 @@ RESTRICTIONS  : Redistribution and use in source and binary forms, with or witho
 #define H264V2_MAX_QP							  51	///< Maximum QP value
 #define H264V2_MAX_EXT_QP	          71	///< Maximum extended QP value for Inter
 #define H264V2_I_MAX_EXT_QP	        85	///< Maximum extended QP value for Intra
+#define H264V2_RD_QP_LEN						(H264V2_I_MAX_EXT_QP + 1)	///< QP rows of the macroblock rate and distortion tables.
 
 #define H264V2_MAX_INTRA_ITERATIONS	5 	///< Default settings for a limit on optimisation iterations for slow convergence.
 #define H264V2_MAX_INTER_ITERATIONS	10 
+#define H264V2_RESLICE_RESERVE_SHIFT	5		///< 1/32 of the picture bits reserved for re-encoded intra macroblocks in "max slice bytes" mode.
 
 /*
 ---------------------------------------------------------------------------
@@ -173,6 +189,9 @@ RESTRICTIONS  : Redistribution and use in source and binary forms, with or witho
 
 #define H264V2_YUV420P16					16	///< Planar Y, U then V (16 bits/component).
 #define H264V2_YUV420P8						17	///< Planar Y, U then V (8 bits/component).
+#define H264V2_YUV420P16_PLANES		18	///< H264V2_PLANES descriptor of Y, U and V planes with strides (16 bits/component).
+#define H264V2_YUV420P8_PLANES		19	///< H264V2_PLANES descriptor of Y, U and V planes with strides (8 bits/component).
+#define H264V2_YUV420P16_VIEW			20	///< Decoder output only. H264V2_PICTURE_VIEW of the decoded picture (16 bits/component).
 
 /*
 --------------------------------------------------------------------------
@@ -182,6 +201,7 @@ RESTRICTIONS  : Redistribution and use in source and binary forms, with or witho
 #define H264V2_CLIP31(x)	( (((x) <= 31)&&((x) >= 1))? (x) : ( ((x) < 1)? 1:31 ) )
 #define H264V2_CLIP51(x)	( (((x) <= 31)&&((x) >= 0))? (x) : ( ((x) < 0)? 0:51 ) )
 #define H264V2_CLIP255(x)	( (((x) <= 255)&&((x) >= 0))? (x) : ( ((x) < 0)? 0:255 ) )
+#define H264V2_TAP6(a,b,c,d,e,f)	( (a) - 5*(b) + 20*(c) + 20*(d) - 5*(e) + (f) )	///< Lum half pel interpolation filter.
 
 #undef	H264V2_EXACT_DMAX
 
@@ -193,7 +213,7 @@ RESTRICTIONS  : Redistribution and use in source and binary forms, with or witho
   Local constants.
 --------------------------------------------------------------------------
 */
-const int		H264v2Codec::PARAMETER_LEN = 37;
+const int		H264v2Codec::PARAMETER_LEN = 41;
 const char*	H264v2Codec::PARAMETER_LIST[] =
 {
 	"parameters",								            // 0
@@ -232,10 +252,14 @@ const char*	H264v2Codec::PARAMETER_LIST[] =
   "rate overshoot percent",               // 33
   "enable roi encoding",                  // 34
   "motion estimation type",               // 35
-  "motion resolution"                     // 36
+  "motion resolution",                    // 36
+  "allocation policy",                    // 37
+  "decode only",                          // 38
+  "nal length prefix",                    // 39
+  "max slice bytes"                       // 40
 };
 
-const int		H264v2Codec::MEMBER_LEN = 7;
+const int		H264v2Codec::MEMBER_LEN = 14;
 const char*	H264v2Codec::MEMBER_LIST[] =
 {
 	"members",									// 0
@@ -244,7 +268,14 @@ const char*	H264v2Codec::MEMBER_LIST[] =
 	"autoiframedetectflag",			// 3
   "roi multiplier",			      // 4
   "currseqparamset",          // 5
-  "currpicparamset"           // 6
+  "currpicparamset",          // 6
+  "referencecb",              // 7
+  "referencecr",              // 8
+  "inputplanes",              // 9
+  "viewtoken",                // 10
+  "memoryusage",              // 11
+  "nalunits",                 // 12
+  "referencey"                // 13
 };
 
 /// Scaling is required for the DC coeffs to match the 4x4 
@@ -261,6 +292,18 @@ const int H264v2Codec::dc2x2Scale[4] =
 	16, 16
 };
 
+/// Mapping of the decoded code number to the coded block pattern for
+/// 4:2:0 sampling as defined in Table 9-4 of the standard.
+const int H264v2Codec::codedBlkPatternMap[48][2] =
+{
+	{ 47, 0 }, { 31, 16 }, { 15, 1 }, { 0, 2 }, { 23, 4 }, { 27, 8 }, { 29, 32 }, { 30, 3 },
+	{ 7, 5 }, { 11, 10 }, { 13, 12 }, { 14, 15 }, { 39, 47 }, { 43, 7 }, { 45, 11 }, { 46, 13 },
+	{ 16, 14 }, { 3, 6 }, { 5, 9 }, { 10, 31 }, { 12, 35 }, { 19, 37 }, { 21, 42 }, { 26, 44 },
+	{ 28, 33 }, { 35, 34 }, { 37, 36 }, { 42, 40 }, { 44, 39 }, { 1, 43 }, { 2, 45 }, { 4, 46 },
+	{ 8, 17 }, { 17, 18 }, { 18, 20 }, { 20, 24 }, { 24, 19 }, { 6, 21 }, { 9, 26 }, { 22, 28 },
+	{ 25, 23 }, { 32, 27 }, { 33, 29 }, { 34, 30 }, { 36, 22 }, { 40, 25 }, { 38, 38 }, { 41, 41 }
+};
+
 /// Test sampling point coordinates for Intra_16x16 prediction mode selection on a grid defined by the method used in 
 /// the Packet Video Conference Proceedings 2015 in a paper by K.T. Luhandjula and K.L. Ferguson entitled "Sampling 
 /// Point Path Selection for Fast Intra Mode Prediction".
@@ -526,6 +569,9 @@ void H264v2Codec::ResetMembers(void)
 
   _motionEstimationType = H264V2_MOTION_CROSS_PARTIAL;
   _motionResolution     = H264V2_MOTION_RES_QUARTER;
+  _allocationPolicy     = H264V2_ALLOC_DEFAULT;
+  _decodeOnly           = 0;
+  _openDecodeOnly       = 0;
 
 	_currSeqParam = 0;	///< Index reference into _seqParam[32] array.
 	_currPicParam = 0;	///< Index reference into _picParam[2] array.
@@ -533,11 +579,25 @@ void H264v2Codec::ResetMembers(void)
 	_prependParamSetsToIPic = 1;  ///< Prepend a SPS and PPS NAL unit to the front of every I-Picture.
 
 	_startCodeEmulationPrevention = 1;  ///< Enable/disable start code emulation prevention in bit stream.
+	_nalLengthPrefix = 0;               ///< Annex B start codes rather than 4 byte NAL unit length prefixes.
+	_maxSliceBytes = 0;                 ///< One slice per picture with no slice NAL unit byte budget.
+	_numNalUnits = 0;
 
 	/// Work input image.
 	_lumWidth = 0;
 	_lumHeight = 0;
+	_cropX = 0;
+	_cropY = 0;
+	_pArena = NULL;
+	_arenaSize = 0;
+	_arenaPos = 0;
+	_arenaAligned = 0;
+	memset((void *)(&_memUsage), 0, sizeof(H264V2_MEMORY_USAGE));
+	_pCropMem = NULL;
 	_pLum = NULL;
+	memset((void *)(&_inPlanes), 0, sizeof(H264V2_PLANES));
+	memset((void *)(&_outPlanes), 0, sizeof(H264V2_PLANES));
+	_viewToken = 0;
 	_chrWidth = 0;
 	_chrHeight = 0;
 	_pChrU = NULL;
@@ -552,6 +612,11 @@ void H264v2Codec::ResetMembers(void)
 	_RefLum = NULL;
 	_RefCb = NULL;
 	_RefCr = NULL;
+	memset((void *)_pRefPlane, 0, sizeof(_pRefPlane));
+	memset((void *)_RefOverlay, 0, sizeof(_RefOverlay));
+	memset((void *)_pRefMotionEstimator, 0, sizeof(_pRefMotionEstimator));
+	_motionEstimatorBytes = 0;
+	_refIndex = 0;
 
 	/// Temp work mem.
 	_p16x16 = NULL;
@@ -570,6 +635,16 @@ void H264v2Codec::ResetMembers(void)
 	/// Stream access.
 	_pBitStreamWriter = NULL;
 	_pBitStreamReader = NULL;
+	_pParseBitStreamReader = NULL;
+	_pSaveBitStreamReader = NULL;
+	_pParseUnsignedVlcDec = NULL;
+	_pParseSignedVlcDec = NULL;
+	_pStreamScratch = NULL;
+	_streamScratchLen = 0;
+	_emulationBits = 0;
+	_emulationStreamBits = 0;
+	_pRefPacked = NULL;
+	_refPackedLen = 0;
 	/// IT transform filters.
 	_pF4x4TLum = NULL;
 	_pF4x4TChr = NULL;
@@ -584,9 +659,12 @@ void H264v2Codec::ResetMembers(void)
 	_motionFactor             = 2; ///< Default for abs diff algorithms.
 	_prevMotionDistortion     = -1;
 	_autoIFrameIncluded       = NULL;
+	_mbRecoded                = NULL;
+	_pMbDistortion            = NULL;
+	_pMbRate                  = NULL;
+	_pMbSkip                  = NULL;
 	_pMotionEstimator         = NULL;
 	_pMotionEstimationResult  = NULL;
-	_pMotionCompensator       = NULL;
 	_pMotionVectors           = NULL;
 	_pMotionPredictor         = NULL;
 
@@ -615,6 +693,8 @@ void H264v2Codec::ResetMembers(void)
 	/// The CAVLC codecs.
 	_pCAVLC4x4 = NULL;
 	_pCAVLC2x2 = NULL;
+	_pBlkScan = NULL;
+	_pCAVLCDec = NULL;
 	/// General header vlc encoders and decoders.
 	_pHeaderUnsignedVlcEnc = NULL;
 	_pHeaderUnsignedVlcDec = NULL;
@@ -647,6 +727,7 @@ void H264v2Codec::ResetMembers(void)
 	/// Image plane encoders/decoders.
 	_pIntraImgPlaneEncoder = NULL;
 	_pInterImgPlaneEncoder = NULL;
+	_planeEncoderBytes = 0;
 	_pIntraImgPlaneDecoder = NULL;
 	_pInterImgPlaneDecoder = NULL;
 
@@ -672,6 +753,31 @@ H264v2Codec::~H264v2Codec()
 	// If open then close first before exiting.
 	if (_codecIsOpen)
 		Close();
+
+	/// The arena outlives Close() to be reused by the next Open().
+	DestroyArena();
+
+	/// Persistent param set parsing objects.
+	if (_pParseBitStreamReader != NULL)
+		delete _pParseBitStreamReader;
+	_pParseBitStreamReader = NULL;
+	if (_pSaveBitStreamReader != NULL)
+		delete _pSaveBitStreamReader;
+	_pSaveBitStreamReader = NULL;
+	if (_pParseUnsignedVlcDec != NULL)
+		delete _pParseUnsignedVlcDec;
+	_pParseUnsignedVlcDec = NULL;
+	if (_pParseSignedVlcDec != NULL)
+		delete _pParseSignedVlcDec;
+	_pParseSignedVlcDec = NULL;
+	if (_pStreamScratch != NULL)
+		delete[] _pStreamScratch;
+	_pStreamScratch = NULL;
+	_streamScratchLen = 0;
+	if (_pRefPacked != NULL)
+		delete[] _pRefPacked;
+	_pRefPacked = NULL;
+	_refPackedLen = 0;
 }//end destructor.
 
 /*
@@ -793,6 +899,14 @@ int	H264v2Codec::GetParameter(const char* type, int*	length, void*	value)
     sprintf((char *)value, "%d", _motionEstimationType);
   else if (strncmp(p, "motion resolution", len) == 0)
     sprintf((char *)value, "%d", _motionResolution);
+  else if (strncmp(p, "allocation policy", len) == 0)
+    sprintf((char *)value, "%d", _allocationPolicy);
+  else if (strncmp(p, "decode only", len) == 0)
+    sprintf((char *)value, "%d", _decodeOnly);
+  else if (strncmp(p, "nal length prefix", len) == 0)
+    sprintf((char *)value, "%d", _nalLengthPrefix);
+  else if (strncmp(p, "max slice bytes", len) == 0)
+    sprintf((char *)value, "%d", _maxSliceBytes);
   else if (strncmp(p, "parameters", len) == 0)
 		//_itoa(PARAMETER_LEN,(char *)value,10);
 		sprintf((char *)value, "%d", PARAMETER_LEN);
@@ -897,6 +1011,14 @@ int H264v2Codec::SetParameter(const char* type, const char* value)
     _motionEstimationType = (int)(atoi(v));
   else if (strncmp(p, "motion resolution", len) == 0)
     _motionResolution = (int)(atoi(v));
+  else if (strncmp(p, "allocation policy", len) == 0)
+    _allocationPolicy = (int)(atoi(v));
+  else if (strncmp(p, "decode only", len) == 0)
+    _decodeOnly = (int)(atoi(v));
+  else if (strncmp(p, "nal length prefix", len) == 0)
+    _nalLengthPrefix = (int)(atoi(v));
+  else if (strncmp(p, "max slice bytes", len) == 0)
+    _maxSliceBytes = (int)(atoi(v));
   else
 	{
 		_errorStr = "[H264v2Codec::SetParameter] Write parameter not supported";
@@ -935,9 +1057,59 @@ void* H264v2Codec::GetMember(const char* type, int* length)
   }
   else if (strncmp(p, "reference", len) == 0)
 	{
-		*length = (_lumWidth * _lumHeight) + 2 * (_chrWidth * _chrHeight);
+		/// The ref colour components are seperated by their edge extension borders and are
+		/// packed into a contiguous YUV420 copy that is valid until the next Code()/Decode().
+		int lumSize = _lumWidth * _lumHeight;
+		int chrSize = _chrWidth * _chrHeight;
+		short* pRef = RefPackedCopy(lumSize + (2 * chrSize));
+		if (pRef != NULL)
+		{
+			memcpy((void *)pRef, (const void *)_pRLum, lumSize * sizeof(short));
+			memcpy((void *)(&(pRef[lumSize])), (const void *)_pRChrU, chrSize * sizeof(short));
+			memcpy((void *)(&(pRef[lumSize + chrSize])), (const void *)_pRChrV, chrSize * sizeof(short));
+			*length = lumSize + (2 * chrSize);
+		}//end if pRef...
+		pRet = (void *)pRef;
+	}
+  else if (strncmp(p, "referencey", len) == 0)
+	{
+		*length = _lumWidth * _lumHeight;
 		pRet = (void *)_pRLum;
 	}
+  else if (strncmp(p, "referencecb", len) == 0)
+	{
+		*length = _chrWidth * _chrHeight;
+		pRet = (void *)_pRChrU;
+	}
+  else if (strncmp(p, "referencecr", len) == 0)
+	{
+		*length = _chrWidth * _chrHeight;
+		pRet = (void *)_pRChrV;
+	}
+  else if (strncmp(p, "memoryusage", len) == 0)
+	{
+		UpdateMemoryUsage();
+		*length = 1;
+		pRet = (void *)(&_memUsage);
+	}
+  else if (strncmp(p, "nalunits", len) == 0)
+	{
+		/// H264V2_NAL_UNIT table of the last Code() call.
+		*length = _numNalUnits;
+		pRet = (void *)_nalUnit;
+	}
+  else if (strncmp(p, "viewtoken", len) == 0)
+	{
+		*length = 1;
+		pRet = (void *)(&_viewToken);
+	}
+  else if (strncmp(p, "inputplanes", len) == 0)
+	{
+		/// The 16 bit input planes of the coded picture size. A H264V2_YUV420P16_PLANES Code()
+		/// call with this descriptor as pSrc does not copy the picture.
+		*length = 1;
+		pRet = (void *)(&_inPlanes);
+	}
 	else if (strncmp(p, "currseqparamset", len) == 0)
 	{
 		*length = 1;
@@ -996,6 +1168,15 @@ int H264v2Codec::SetMember(const char* type, void* pValue)
     for (i = 0; i < _mbLength; i++)
       _roiMultiplier[i] = pV[i];
   }
+  else if (strncmp(p, "outputplanes", len) == 0)
+  {
+    /// Register caller owned planes that Decode() writes into when pDst is NULL. A NULL value
+    /// removes the registration.
+    if (pValue == NULL)
+      memset((void *)(&_outPlanes), 0, sizeof(H264V2_PLANES));
+    else
+      _outPlanes = *((H264V2_PLANES *)pValue);
+  }
   else
 	{
 		_errorStr = "[H264v2Codec::SetMember] Write member not supported";
@@ -1023,6 +1204,8 @@ int H264v2Codec::Open(void)
 	/// If already open then close first before continuing.
 	if (_codecIsOpen)
 		Close();
+	/// The "decode only" parameter is latched for the life of this session.
+	_openDecodeOnly = _decodeOnly;
 
 	/// --------------- Configure Sequence & Picture parameter sets -----------------
 	/// The _genParamSetOnOpen parameter determines whether or not the seq/pic params 
@@ -1033,6 +1216,16 @@ int H264v2Codec::Open(void)
 	/// from the seq/pic param sets.
 	if (_genParamSetOnOpen)
 	{
+		/// Any even picture dimensions are coded at the next mod 16 size and cropped.
+		if ((_width % 2) || (_height % 2))
+		{
+			_errorStr = "[H264Codec::Open] Picture width and height must be even";
+			Close();
+			return(0);
+		}//end if _width...
+		_cropX = 0;
+		_cropY = 0;
+
 		/// Sequence parameter set for Baseline profile.
 		if (!SetSeqParamSet(_currSeqParam))
 		{
@@ -1090,59 +1283,134 @@ int H264v2Codec::Open(void)
 	}//end if _prependParamSetsToIPic...
 
 	  /// --------------- Alloc image memory ----------------------------------------------
-	/// Create an image memory space.
-	_lumWidth = _width;
-	_lumHeight = _height;
-	_chrWidth = _width / 2;
-	_chrHeight = _height / 2;
+	/// Create an image memory space at the mod 16 coded picture size. 
+	_lumWidth = ((_cropX + _width + 15) / 16) * 16;
+	_lumHeight = ((_cropY + _height + 15) / 16) * 16;
+	_chrWidth = _lumWidth / 2;
+	_chrHeight = _lumHeight / 2;
 
 	/// Alloc a large contiguous block with Lum first followed by ChrU then ChrV
-	/// for both image blocks of input and reference.
+	/// for both image blocks of input and reference. Each ref colour component
+	/// has H264V2_REF_BORDER lum rows (half for chr) above and below it that are
+	/// filled by edge extension.
 	int lumSize = _lumWidth * _lumHeight;
 	int chrSize = _chrWidth * _chrHeight;
 	int imgSize = lumSize + 2 * chrSize;
-	/// In/Out and ref images with primary lum at the head.
-	_pLum = new short[2 * imgSize];
-	if (!_pLum)
-	{
-		_errorStr = "[H264Codec::Open] Image memory unavailable";
-		Close();
-		return(0);
-	}//end if !_pLum...
+	int refLumSize = lumSize + (2 * H264V2_REF_BORDER * _lumWidth);
+	int refChrSize = chrSize + (H264V2_REF_BORDER * _chrWidth);
+	int refPicSize = refLumSize + 2 * refChrSize;
+	int mbWidth = _lumWidth / 16;		///< Mod 16 coded picture dimensions.
+	int mbHeight = _lumHeight / 16;
+	_mbLength = mbWidth * mbHeight;
+	int cropSize = 0;
+	if ((_lumWidth != _width) || (_lumHeight != _height) || _cropX || _cropY)
+		cropSize = (_width * _height) + 2 * ((_width / 2) * (_height / 2));
+
+	/// --------------- Size the session arena ----------------------------------------
+	/// All plain buffers of the session are carved from a single cache line aligned 
+	/// arena sized here from the parameters. The arena is kept over Close() and only
+	/// reallocated when a larger one is required or when the first touch policy must
+	/// place its pages for the thread calling this Open().
+	int inSize = _openDecodeOnly ? 0 : imgSize;	///< There is no input picture for decoding only.
+	size_t arenaSize = H264V2_ARENA_ALIGN;	///< Slack for aligning the base.
+	arenaSize += ArenaBytes((inSize + H264V2_REF_PICS * refPicSize) * sizeof(short));
+	arenaSize += ArenaBytes(cropSize * sizeof(short));
+	arenaSize += ArenaBytes((256 + 64 + 64) * sizeof(short));	///< Prediction blocks.
+	arenaSize += ArenaBytes(_mbLength * sizeof(MacroBlockH264));
+	arenaSize += ArenaBytes(mbHeight * sizeof(MacroBlockH264*));
+	if (!_openDecodeOnly)	///< Encoder only buffers.
+	{
+		arenaSize += 2 * ArenaBytes(_mbLength * sizeof(bool));	///< Auto I-frame inclusion and re-encoded flags.
+		if (_enableROIEncoding)
+			arenaSize += ArenaBytes(_mbLength * sizeof(double));
+		arenaSize += 2 * ArenaBytes(H264V2_RD_QP_LEN * _mbLength * sizeof(int));	///< Rate and distortion tables.
+		arenaSize += ArenaBytes(_mbLength * sizeof(unsigned char));
+	}//end if !_openDecodeOnly...
+
+	if ((arenaSize > _arenaSize) || (_allocationPolicy & H264V2_ALLOC_FIRST_TOUCH))
+	{
+		if (!CreateArena(arenaSize))
+		{
+			_errorStr = "[H264Codec::Open] Session memory unavailable";
+			Close();
+			return(0);
+		}//end if !CreateArena...
+	}//end if arenaSize...
+	_arenaPos = 0;
+
+	/// In/Out and ref images with primary lum at the head. All components are mod 16 
+	/// in size and so every plane head remains 64 byte aligned to pImgMem. Lum rows are
+	/// 32 byte aligned but chr rows of _lumWidth/2 pels only guarantee 16 bytes and so
+	/// the row kernels must use unaligned loads.
+	short* pImgMem = (short *)ArenaAlloc((inSize + H264V2_REF_PICS * refPicSize) * sizeof(short));
+
+	/// Colour conversion operates on the visible picture size only.
+	if (cropSize)
+		_pCropMem = (short *)ArenaAlloc(cropSize * sizeof(short));
 	  /// Place each image and colour component head pointer.
-	_pChrU = &(_pLum[lumSize]);												///< End of _pLum.
-	_pChrV = &(_pLum[lumSize + chrSize]);							///< End of _pChrU.
-	_pRLum = &(_pLum[imgSize]);												///< End of input image.
-	_pRChrU = &(_pLum[imgSize + lumSize]);						///< End of image and _pRLum.
-	_pRChrV = &(_pLum[imgSize + lumSize + chrSize]);	///< End of _pRChrU.
+	if (inSize)
+	{
+		_pLum = pImgMem;
+		_pChrU = &(_pLum[lumSize]);												///< End of _pLum.
+		_pChrV = &(_pLum[lumSize + chrSize]);							///< End of _pChrU.
+	}//end if inSize...
+	for (i = 0; i < H264V2_REF_PICS; i++)
+	{
+		int refBase = inSize + (i * refPicSize);	///< Ref pictures follow the input image.
+		_pRefPlane[i][0] = &(pImgMem[refBase + (H264V2_REF_BORDER * _lumWidth)]);																///< Below the top border.
+		_pRefPlane[i][1] = &(pImgMem[refBase + refLumSize + ((H264V2_REF_BORDER/2) * _chrWidth)]);						///< Below the top border after lum.
+		_pRefPlane[i][2] = &(pImgMem[refBase + refLumSize + refChrSize + ((H264V2_REF_BORDER/2) * _chrWidth)]);	///< Below the top border after chr U.
+	}//end for i...
+
+	/// Callers may write the visible input picture directly into these planes. They are
+	/// NULL for decoding only.
+	_inPlanes.pY = (void *)_pLum;
+	_inPlanes.pU = (void *)_pChrU;
+	_inPlanes.pV = (void *)_pChrV;
+	_inPlanes.strideY = _lumWidth;
+	_inPlanes.strideU = _chrWidth;
+	_inPlanes.strideV = _chrWidth;
 
   /// Zero the reference and the previous input image spaces. Note that the mem
 	/// is contiguous.
-	memset((void *)_pLum, 0, 2 * imgSize * sizeof(short));
+	memset((void *)pImgMem, 0, (inSize + H264V2_REF_PICS * refPicSize) * sizeof(short));
 
 	/// --------------- Configure the overlays to the img mem -------------------------
 	/// The encoding/decoding of the residual image is performed on 4x4 blocks within
 	/// each macroblock of the in/out and ref images.
-	_Lum = new OverlayMem2Dv2(_pLum, _lumWidth, _lumHeight, 16, 16);
-	_RefLum = new OverlayMem2Dv2(_pRLum, _lumWidth, _lumHeight, 16, 16);
-	_Cb = new OverlayMem2Dv2(_pChrU, _chrWidth, _chrHeight, 8, 8);
-	_RefCb = new OverlayMem2Dv2(_pRChrU, _chrWidth, _chrHeight, 8, 8);
-	_Cr = new OverlayMem2Dv2(_pChrV, _chrWidth, _chrHeight, 8, 8);
-	_RefCr = new OverlayMem2Dv2(_pRChrV, _chrWidth, _chrHeight, 8, 8);
-	if ((_Lum == NULL) || (_RefLum == NULL) || (_Cb == NULL) ||
-		(_RefCb == NULL) || (_Cr == NULL) || (_RefCr == NULL))
-	{
-		_errorStr = "[H264Codec::Open] Cannot instantiate image and reference overlay objects";
-		Close();
-		return(0);
-	}//end if !_Lum...
+	if (!_openDecodeOnly)
+	{
+		_Lum = new OverlayMem2Dv2(_pLum, _lumWidth, _lumHeight, 16, 16);
+		_Cb = new OverlayMem2Dv2(_pChrU, _chrWidth, _chrHeight, 8, 8);
+		_Cr = new OverlayMem2Dv2(_pChrV, _chrWidth, _chrHeight, 8, 8);
+		if ((_Lum == NULL) || (_Cb == NULL) || (_Cr == NULL))
+		{
+			_errorStr = "[H264Codec::Open] Cannot instantiate image overlay objects";
+			Close();
+			return(0);
+		}//end if !_Lum...
+	}//end if !_openDecodeOnly...
+	for (i = 0; i < H264V2_REF_PICS; i++)
+	{
+		_RefOverlay[i][0] = new OverlayMem2Dv2(_pRefPlane[i][0], _lumWidth, _lumHeight, 16, 16);
+		_RefOverlay[i][1] = new OverlayMem2Dv2(_pRefPlane[i][1], _chrWidth, _chrHeight, 8, 8);
+		_RefOverlay[i][2] = new OverlayMem2Dv2(_pRefPlane[i][2], _chrWidth, _chrHeight, 8, 8);
+		if ((_RefOverlay[i][0] == NULL) || (_RefOverlay[i][1] == NULL) || (_RefOverlay[i][2] == NULL))
+		{
+			_errorStr = "[H264Codec::Open] Cannot instantiate reference overlay objects";
+			Close();
+			return(0);
+		}//end if !_RefOverlay...
+	}//end for i...
+	/// Start at ring picture 0 that the encoder objects are bound to.
+	SelectReference(0);
 
 	  /// --------------- Alloc and configure prediction mem data objects ---------------------
-	_p16x16 = new short[256];	///< 16x16 block for predicition operations.
+	_p16x16 = (short *)ArenaAlloc(256 * sizeof(short));	///< 16x16 block for predicition operations.
 	_16x16 = new OverlayMem2Dv2(_p16x16, 16, 16, 16, 16);
-	_p8x8_0 = new short[64];	///< 8x8 blocks for predicition operations.
+	_p8x8_0 = (short *)ArenaAlloc(64 * sizeof(short));	///< 8x8 blocks for predicition operations.
 	_8x8_0 = new OverlayMem2Dv2(_p8x8_0, 8, 8, 8, 8);
-	_p8x8_1 = new short[64];
+	_p8x8_1 = (short *)ArenaAlloc(64 * sizeof(short));
 	_8x8_1 = new OverlayMem2Dv2(_p8x8_1, 8, 8, 8, 8);
 
 	if ((_p16x16 == NULL) || (_16x16 == NULL) ||
@@ -1165,18 +1433,26 @@ int H264v2Codec::Open(void)
 	_mbImg->Create();
 
 	/// --------------- Configure Macroblock data objects -----------------------------
-	int mbWidth = _lumWidth / 16;		///< Note: Assuming mod 16 image dimensions (potential problem).
-	int mbHeight = _lumHeight / 16;
-	_mbLength = mbWidth * mbHeight;
-
-	_pMb = new MacroBlockH264[_mbLength];
-	_Mb = new MacroBlockH264*[mbHeight];	///< Address array.
+	/// The macroblock array is constructed in place in the arena and destroyed in Close().
+	/// The Vpp codec objects remain on the heap as they allocate their own internal memory.
+	_pMb = (MacroBlockH264 *)ArenaAlloc(_mbLength * sizeof(MacroBlockH264));
+	if (_pMb != NULL)
+	{
+		for (i = 0; i < _mbLength; i++)
+			new (&(_pMb[i])) MacroBlockH264();
+	}//end if _pMb...
+	_Mb = (MacroBlockH264 **)ArenaAlloc(mbHeight * sizeof(MacroBlockH264*));	///< Address array.
 
 	/// Only specified macroblocks are included in the detection of an I-frame. This
 	/// flag list is used to indicate that inclusion.
-	_autoIFrameIncluded = new bool[_mbLength];
+	if (!_openDecodeOnly)
+	{
+		_autoIFrameIncluded = (bool *)ArenaAlloc(_mbLength * sizeof(bool));
+		/// Intra macroblocks re-encoded at slice starts in "max slice bytes" mode are flagged for their neighbours.
+		_mbRecoded = (bool *)ArenaAlloc(_mbLength * sizeof(bool));
+	}//end if !_openDecodeOnly...
 
-	if ((_pMb == NULL) || (_Mb == NULL) || (_autoIFrameIncluded == NULL))
+	if ((_pMb == NULL) || (_Mb == NULL) || (((_autoIFrameIncluded == NULL) || (_mbRecoded == NULL)) && !_openDecodeOnly))
 	{
 		_errorStr = "[H264Codec::Open] Cannot instantiate macroblock data objects";
 		Close();
@@ -1190,13 +1466,25 @@ int H264v2Codec::Open(void)
 	/// is only one slice (slice num = 0) and therefore extends from macroblock index 0..._mbLength-1.
 	MacroBlockH264::Initialise(mbHeight, mbWidth, 0, _mbLength - 1, 0, _Mb);
 
-	/// Load the flag for each macroblock that includes/excludes it from the 
-	/// auto I-frame test during motion estimation. Default to include all.
-	for (i = 0; i < _mbLength; i++)
-		_autoIFrameIncluded[i] = 1;
+	if (!_openDecodeOnly)
+	{
+		/// Load the flag for each macroblock that includes/excludes it from the 
+		/// auto I-frame test during motion estimation. Default to include all.
+		for (i = 0; i < _mbLength; i++)
+			_autoIFrameIncluded[i] = 1;
+
+		/// Frame wide rate and distortion tables for the QP searches. They mirror the 
+		/// macroblock _distortion[] and _rate[] members in [qp][mb] order.
+		_pMbDistortion = (int *)ArenaAlloc(H264V2_RD_QP_LEN * _mbLength * sizeof(int));
+		_pMbRate = (int *)ArenaAlloc(H264V2_RD_QP_LEN * _mbLength * sizeof(int));
+		_pMbSkip = (unsigned char *)ArenaAlloc(_mbLength * sizeof(unsigned char));
+		memset((void *)_pMbDistortion, 0, H264V2_RD_QP_LEN * _mbLength * sizeof(int));
+		memset((void *)_pMbRate, 0, H264V2_RD_QP_LEN * _mbLength * sizeof(int));
+		memset((void *)_pMbSkip, 0, _mbLength * sizeof(unsigned char));
+	}//end if !_openDecodeOnly...
 
 	/// --------------- Configure colour converters ---------------------------------
-	if (_inColour == H264V2_RGB24)
+	if ((_inColour == H264V2_RGB24) && !_openDecodeOnly)
 	{
 		/// Encoder input.
 #ifdef _CCIR601
@@ -1240,17 +1528,30 @@ int H264v2Codec::Open(void)
 	/// --------------- Instantiate IT filters ------------------------------------
 	/// Create Integer Transformers (IT) and their inverses for AC and DC coeffs. The
 	/// quantisers are included in the IT transform classes.
-	_pF4x4TLum = new FastForward4x4ITImpl2();
-	_pF4x4TChr = new FastForward4x4ITImpl2();
-	_pFDC4x4T = new FastForwardDC4x4ITImpl1();
-	_pFDC2x2T = new FastForwardDC2x2ITImpl1();
+	/// The forward transforms are only used by the encoder.
+	if (!_openDecodeOnly)
+	{
+		_pF4x4TLum = new FastForward4x4ITImpl2();
+		_pF4x4TChr = new FastForward4x4ITImpl2();
+		_pFDC4x4T = new FastForwardDC4x4ITImpl1();
+		_pFDC2x2T = new FastForwardDC2x2ITImpl1();
+		if ((_pF4x4TLum == NULL) || (_pF4x4TChr == NULL) || (_pFDC4x4T == NULL) || (_pFDC2x2T == NULL))
+		{
+			_errorStr = "[H264Codec::Open] Cannot instantiate Integer Transform filter objects";
+			Close();
+			return(0);
+		}//end if !_pF4x4TLum...
+		_pF4x4TLum->SetMode(IForwardTransform::TransformOnly);
+		_pF4x4TChr->SetMode(IForwardTransform::TransformOnly);
+		_pFDC4x4T->SetMode(IForwardTransform::TransformAndQuant);
+		_pFDC2x2T->SetMode(IForwardTransform::TransformAndQuant);
+	}//end if !_openDecodeOnly...
 	_pI4x4TLum = new FastInverse4x4ITImpl1();
 	_pI4x4TChr = new FastInverse4x4ITImpl1();
 	_pIDC4x4T = new FastInverseDC4x4ITImpl1();
 	_pIDC2x2T = new FastInverseDC2x2ITImpl1();
 
-	if ((_pF4x4TLum == NULL) || (_pF4x4TChr == NULL) || (_pFDC4x4T == NULL) || (_pFDC2x2T == NULL) ||
-		(_pI4x4TLum == NULL) || (_pI4x4TChr == NULL) || (_pIDC4x4T == NULL) || (_pIDC2x2T == NULL))
+	if ((_pI4x4TLum == NULL) || (_pI4x4TChr == NULL) || (_pIDC4x4T == NULL) || (_pIDC2x2T == NULL))
 	{
 		_errorStr = "[H264Codec::Open] Cannot instantiate Integer Transform filter objects";
 		Close();
@@ -1258,293 +1559,136 @@ int H264v2Codec::Open(void)
 	}//end if !_pF4x4TLum...
 
 	  /// Set default modes and added scaling for IT filters.
-	_pF4x4TLum->SetMode(IForwardTransform::TransformOnly);
-	_pF4x4TChr->SetMode(IForwardTransform::TransformOnly);
-	_pFDC4x4T->SetMode(IForwardTransform::TransformAndQuant);
-	_pFDC2x2T->SetMode(IForwardTransform::TransformAndQuant);
 	_pI4x4TLum->SetMode(IInverseTransform::TransformOnly);
 	_pI4x4TChr->SetMode(IInverseTransform::TransformOnly);
 	_pIDC4x4T->SetMode(IInverseTransform::TransformAndQuant);
 	_pIDC2x2T->SetMode(IInverseTransform::TransformAndQuant);
 
 	// --------------- Create the Vlc encoders and decoders --------------------------
-	/// Create the vlc encoders and decoders for use with CAVLC.
-	_pPrefixVlcEnc = new PrefixH264VlcEncoderImpl1();
+	/// Create the vlc decoders for use with CAVLC.
 	_pPrefixVlcDec = new PrefixH264VlcDecoderImpl1();
-	_pCoeffTokenVlcEnc = new CoeffTokenH264VlcEncoder();
 	_pCoeffTokenVlcDec = new CoeffTokenH264VlcDecoder();
-	_pTotalZeros4x4VlcEnc = new TotalZeros4x4H264VlcEncoder();
 	_pTotalZeros4x4VlcDec = new TotalZeros4x4H264VlcDecoder();
-	_pTotalZeros2x2VlcEnc = new TotalZeros2x2H264VlcEncoder();
 	_pTotalZeros2x2VlcDec = new TotalZeros2x2H264VlcDecoder();
-	_pRunBeforeVlcEnc = new RunBeforeH264VlcEncoder();
 	_pRunBeforeVlcDec = new RunBeforeH264VlcDecoder();
-
-	/// Vlc encoder and decoder for the coded block pattern.
-	_pBlkPattVlcEnc = new CodedBlkPatternH264VlcEncoder();
+	/// Vlc decoders for the coded block pattern, the delta QP and the macroblock type.
 	_pBlkPattVlcDec = new CodedBlkPatternH264VlcDecoder();
-
-	/// Vlc encoder and decoder for the delta QP.
-	_pDeltaQPVlcEnc = new ExpGolombSignedVlcEncoder();
 	_pDeltaQPVlcDec = new ExpGolombSignedVlcDecoder();
-
-	/// Vlc encoder and decoder for the macroblock type.
-	_pMbTypeVlcEnc = new ExpGolombUnsignedVlcEncoder();
 	_pMbTypeVlcDec = new ExpGolombUnsignedVlcDecoder();
 
-	/// Vlc encoder and decoder for intra chr pred mode. ExpGolomb codecs
-	/// are stateless therefore they can be reused.
-	_pMbIChrPredModeVlcEnc = _pMbTypeVlcEnc;
+	/// Vlc decoders for intra chr pred mode, motion vector differences and general headers. 
+	/// ExpGolomb codecs are stateless therefore they can be reused.
 	_pMbIChrPredModeVlcDec = _pMbTypeVlcDec;
-
-	/// Vlc encoder and decoder for motion vector differences. ExpGolomb codecs
-	/// are stateless therefore they can be reused.
-	_pMbMotionVecDiffVlcEnc = _pDeltaQPVlcEnc;
 	_pMbMotionVecDiffVlcDec = _pDeltaQPVlcDec;
-
-	/// Vlc encoder and decoder for general headers. ExpGolomb codecs
-	/// are stateless therefore they can be reused.
-	_pHeaderUnsignedVlcEnc = _pMbTypeVlcEnc;
 	_pHeaderUnsignedVlcDec = _pMbTypeVlcDec;
-	_pHeaderSignedVlcEnc = _pDeltaQPVlcEnc;
 	_pHeaderSignedVlcDec = _pDeltaQPVlcDec;
 
-	if ((_pPrefixVlcEnc == NULL) || (_pPrefixVlcDec == NULL) ||
-		(_pCoeffTokenVlcEnc == NULL) || (_pCoeffTokenVlcDec == NULL) ||
-		(_pTotalZeros4x4VlcEnc == NULL) || (_pTotalZeros4x4VlcDec == NULL) ||
-		(_pTotalZeros2x2VlcEnc == NULL) || (_pTotalZeros2x2VlcDec == NULL) ||
-		(_pRunBeforeVlcEnc == NULL) || (_pRunBeforeVlcDec == NULL) ||
-		(_pBlkPattVlcEnc == NULL) || (_pBlkPattVlcDec == NULL) ||
-		(_pDeltaQPVlcEnc == NULL) || (_pDeltaQPVlcDec == NULL) ||
-		(_pMbTypeVlcEnc == NULL) || (_pMbTypeVlcDec == NULL))
+	if ((_pPrefixVlcDec == NULL) || (_pCoeffTokenVlcDec == NULL) ||
+		(_pTotalZeros4x4VlcDec == NULL) || (_pTotalZeros2x2VlcDec == NULL) ||
+		(_pRunBeforeVlcDec == NULL) || (_pBlkPattVlcDec == NULL) ||
+		(_pDeltaQPVlcDec == NULL) || (_pMbTypeVlcDec == NULL))
 	{
 		_errorStr = "[H264Codec::Open] Cannot instantiate Vlc codec objects";
 		Close();
 		return(0);
-	}//end if !_pPrefixVlcEnc...
-
-	  /// Create a CAVLC encoder and decoder for each coeff block size.
-	_pCAVLC4x4 = new CAVLCH264Impl();
-	_pCAVLC2x2 = new CAVLCH264Impl();
-	if ((_pCAVLC4x4 == NULL) || (_pCAVLC2x2 == NULL))
-	{
-		_errorStr = "[H264Codec::Open] Cannot instantiate CAVLC codec objects";
-		Close();
-		return(0);
-	}//end if !_pCAVLC4x4...
-
-	  /// Attach the vlc encoders and decoders to the associated CAVLC.
-	_pCAVLC4x4->SetMode(CAVLCH264Impl::Mode4x4);
-	((CAVLCH264Impl *)_pCAVLC4x4)->SetTokenCoeffVlcEncoder(_pCoeffTokenVlcEnc);
-	((CAVLCH264Impl *)_pCAVLC4x4)->SetTokenCoeffVlcDecoder(_pCoeffTokenVlcDec);
-	((CAVLCH264Impl *)_pCAVLC4x4)->SetPrefixVlcEncoder(_pPrefixVlcEnc);
-	((CAVLCH264Impl *)_pCAVLC4x4)->SetPrefixVlcDecoder(_pPrefixVlcDec);
-	((CAVLCH264Impl *)_pCAVLC4x4)->SetRunBeforeVlcEncoder(_pRunBeforeVlcEnc);
-	((CAVLCH264Impl *)_pCAVLC4x4)->SetRunBeforeVlcDecoder(_pRunBeforeVlcDec);
-	((CAVLCH264Impl *)_pCAVLC4x4)->SetTotalZerosVlcEncoder(_pTotalZeros4x4VlcEnc);
-	((CAVLCH264Impl *)_pCAVLC4x4)->SetTotalZerosVlcDecoder(_pTotalZeros4x4VlcDec);
-
-	_pCAVLC2x2->SetMode(CAVLCH264Impl::Mode2x2);
-	((CAVLCH264Impl *)_pCAVLC2x2)->SetTokenCoeffVlcEncoder(_pCoeffTokenVlcEnc);
-	((CAVLCH264Impl *)_pCAVLC2x2)->SetTokenCoeffVlcDecoder(_pCoeffTokenVlcDec);
-	((CAVLCH264Impl *)_pCAVLC2x2)->SetPrefixVlcEncoder(_pPrefixVlcEnc);
-	((CAVLCH264Impl *)_pCAVLC2x2)->SetPrefixVlcDecoder(_pPrefixVlcDec);
-	((CAVLCH264Impl *)_pCAVLC2x2)->SetRunBeforeVlcEncoder(_pRunBeforeVlcEnc);
-	((CAVLCH264Impl *)_pCAVLC2x2)->SetRunBeforeVlcDecoder(_pRunBeforeVlcDec);
-	((CAVLCH264Impl *)_pCAVLC2x2)->SetTotalZerosVlcEncoder(_pTotalZeros2x2VlcEnc);
-	((CAVLCH264Impl *)_pCAVLC2x2)->SetTotalZerosVlcDecoder(_pTotalZeros2x2VlcDec);
-
-	// --------------- Configure bit stream access -----------------------------------
-	_pBitStreamWriter = new BitStreamWriterMSB();
-	_pBitStreamReader = new BitStreamReaderMSB();
-	if ((_pBitStreamWriter == NULL) || (_pBitStreamReader == NULL))
-	{
-		_errorStr = "[H264Codec::Open] Cannot instantiate bit stream access objects";
-		Close();
-		return(0);
-	}//end if !_pBitStreamWriter...
+	}//end if !_pPrefixVlcDec...
 
-	  /// --------------- Configure motion estimators -----------------------------------
-
-	/// Create a motion vector predictor for the motion estimator to use in biasing towards
-	/// the predicted vector when distortion choise is ambiguous.
-	_pMotionPredictor = new H264MotionVectorPredictorImpl1(_pMb);
-	if (!_pMotionPredictor)
+	_pCAVLCDec = new CAVLCH264TableDecoder();
+	if ((_pCAVLCDec == NULL) || !_pCAVLCDec->IsValid())
 	{
-		_errorStr = "[H264Codec::Open] Cannot create motion vector predictor object";
+		_errorStr = "[H264Codec::Open] Cannot instantiate CAVLC table decoder object";
 		Close();
 		return(0);
-	}//end if !_pMotionPredictor...
-
-	  /// Select an appropriate motion estimator.
-	int motionVectorRange;	///< In 1/4 pel units but also required for motion compensator in full pel units.
-	if ((_width <= 1408) && (_height <= 1152))
-		motionVectorRange = 512;	///< 512/4 = [-128.00 ... 127.75], 192/4 = [-48.00 ... 47.75]
-	else
-		motionVectorRange = 1024;	///< 1024/4 =[-256.00 ... 255.75], 256/4 =[-64.00 ... 63.75]
-
-  switch (_motionEstimationType)
-  {
-    case H264V2_MOTION_FULL:
-      {
-        /// Slowest full accurate estimator.
-        _pMotionEstimator = new MotionEstimatorH264ImplFull( (const void *)_pLum,
-        																										 (const void *)_pRLum,
-        																										 _lumWidth,
-        																										 _lumHeight,
-        																										 motionVectorRange, ///< In 1/4 pel units.
-                                                             _pMotionPredictor,
-        																										 _autoIFrameIncluded);
-        /// Implementation specific modes.
-        if(_pMotionEstimator != NULL)
-          _pMotionEstimator->SetMode(0);	///< Auto mode.
-      }//end block...
-      break;
-    case H264V2_MOTION_FULL_MULTIRES:
-      {
-        /// Slow more accurate multiresolution estimator.
-        _pMotionEstimator = new MotionEstimatorH264ImplMultires((const void *)_pLum,	///< Multi res estimation.
-        																												(const void *)_pRLum,
-        																												_lumWidth,
-        																												_lumHeight,
-        																												motionVectorRange, ///< In 1/4 pel units
-                                                                _pMotionPredictor,
-                                                                _autoIFrameIncluded);
-        /// Implementation specific modes.
-        if (_pMotionEstimator != NULL)
-          _pMotionEstimator->SetMode(0);	///< mode 0 = 1/4 pel, mode 1 = 1/2 pel, mode 2 = full pel.
-      }//end block...
-      break;
-    case H264V2_MOTION_UMHS_PARTIAL:
-      {
-        /// Cross search algorithm with partial sums as defined in the std reference implementations of H264
-        _pMotionEstimator = new MotionEstimatorH264ImplUMHS((const void *)_pLum,
-                                                            (const void *)_pRLum,
-                                                            _lumWidth,
-                                                            _lumHeight,
-                                                            motionVectorRange, ///< In 1/4 pel units.
-                                                            _pMotionPredictor,
-                                                            _autoIFrameIncluded,
-                                                            _pMb);
-        /// Implementation specific modes.
-        if (_pMotionEstimator != NULL)
-          _pMotionEstimator->SetMode(_motionResolution);	///< Estimation pel resolution: 0=1/4 pel, 1=1/2 pel, 2=full pel.
-      }///end block...
-      break;
-    case H264V2_MOTION_FHS_PARTIAL:
-    {
-      /// Fasthegagon sequencing search algorithm with partial sums
-      _pMotionEstimator = new MotionEstimatorH264ImplFHS((const void *)_pLum,
-                                                         (const void *)_pRLum,
-                                                          _lumWidth,
-                                                          _lumHeight,
-                                                          motionVectorRange, ///< In 1/4 pel units.
-                                                          _pMotionPredictor,
-                                                          _autoIFrameIncluded,
-                                                          _pMb);
-      /// Implementation specific modes.
-      if (_pMotionEstimator != NULL)
-        _pMotionEstimator->SetMode(_motionResolution);	///< Estimation pel resolution: 0=1/4 pel, 1=1/2 pel, 2=full pel.
-    }///end block...
-    break;
-    case H264V2_MOTION_CROSS_PARTIAL:
-    default:  /// H264V2_MOTION_CROSS_PARTIAL
-      {
-        /// Cross search algorithm with partial sums as defined in the std reference implementations of H264
-        _pMotionEstimator = new MotionEstimatorH264ImplCross( (const void *)_pLum,
-                                                              (const void *)_pRLum,
-                                                              _lumWidth,
-                                                              _lumHeight,
-                                                              motionVectorRange, ///< In 1/4 pel units.
-                                                              _pMotionPredictor,
-                                                              _autoIFrameIncluded);
-        /// Implementation specific modes.
-        if (_pMotionEstimator != NULL)
-          _pMotionEstimator->SetMode(_motionResolution);	///< Estimation pel resolution: 0=1/4 pel, 1=1/2 pel, 2=full pel.
-      }///end block...
-      break;
-  }///end switch _motionEstimationType...
-
-  /// Fast less accurate estimator.
-	//_pMotionEstimator = new MotionEstimatorH264ImplMultiresCrossVer2( (const void *)_pLum,	///< Multi res estimation.
-	//	                                                                (const void *)_pRLum,
-	//	                                                                _lumWidth,
-	//	                                                                _lumHeight,
-	//	                                                                motionVectorRange, ///< In 1/4 pel units.
-	//	                                                                _pMotionPredictor,
-	//	                                                                _autoIFrameIncluded);
-
-	//	_pMotionEstimator = new MotionEstimatorH264ImplMultiresCross(	(const void *)_pLum,	///< Multi res estimation.
-	//																																(const void *)_pRLum,
-	//																																_lumWidth,
-	//																																_lumHeight,
-	//																																motionVectorRange, ///< In 1/4 pel units.
-	//																																_autoIFrameIncluded);
-
-
-
-		/// Test motion estimator for collecting data. Full pel only full search based estimation.
-	//	_pMotionEstimator = new MotionEstimatorH264ImplTest(	(const void *)_pLum,	///< Multi res estimation.
-	//																												(const void *)_pRLum,
-	//																												_lumWidth,
-	//																												_lumHeight,
-	//																												motionVectorRange, ///< In 1/4 pel units.
-	//                                                        _pMotionPredictor,
-	//																												_autoIFrameIncluded);
-
-	if (_pMotionEstimator != NULL)
-	{
-		//_motionFactor = 2;	///< Abs diff algorithm.
-		_motionFactor = 4;	///< Sqr err algorithm.
+	}//end if !_pCAVLCDec...
+
+	/// The vlc encoders, the CAVLC encoders and the block scan are only used by the encoder.
+	if (!_openDecodeOnly)
+	{
+		_pPrefixVlcEnc = new PrefixH264VlcEncoderImpl1();
+		_pCoeffTokenVlcEnc = new CoeffTokenH264VlcEncoder();
+		_pTotalZeros4x4VlcEnc = new TotalZeros4x4H264VlcEncoder();
+		_pTotalZeros2x2VlcEnc = new TotalZeros2x2H264VlcEncoder();
+		_pRunBeforeVlcEnc = new RunBeforeH264VlcEncoder();
+		_pBlkPattVlcEnc = new CodedBlkPatternH264VlcEncoder();
+		_pDeltaQPVlcEnc = new ExpGolombSignedVlcEncoder();
+		_pMbTypeVlcEnc = new ExpGolombUnsignedVlcEncoder();
+		_pMbIChrPredModeVlcEnc = _pMbTypeVlcEnc;
+		_pMbMotionVecDiffVlcEnc = _pDeltaQPVlcEnc;
+		_pHeaderUnsignedVlcEnc = _pMbTypeVlcEnc;
+		_pHeaderSignedVlcEnc = _pDeltaQPVlcEnc;
+
+		if ((_pPrefixVlcEnc == NULL) || (_pCoeffTokenVlcEnc == NULL) ||
+			(_pTotalZeros4x4VlcEnc == NULL) || (_pTotalZeros2x2VlcEnc == NULL) ||
+			(_pRunBeforeVlcEnc == NULL) || (_pBlkPattVlcEnc == NULL) ||
+			(_pDeltaQPVlcEnc == NULL) || (_pMbTypeVlcEnc == NULL))
+		{
+			_errorStr = "[H264Codec::Open] Cannot instantiate Vlc codec objects";
+			Close();
+			return(0);
+		}//end if !_pPrefixVlcEnc...
 
-		if (!_pMotionEstimator->Create())
+		/// Create a CAVLC encoder for each coeff block size.
+		_pCAVLC4x4 = new CAVLCH264Impl();
+		_pCAVLC2x2 = new CAVLCH264Impl();
+		if ((_pCAVLC4x4 == NULL) || (_pCAVLC2x2 == NULL))
 		{
-			_errorStr = "[H264Codec::Open] Cannot create motion estimator";
+			_errorStr = "[H264Codec::Open] Cannot instantiate CAVLC codec objects";
 			Close();
 			return(0);
-		}//end if !Create...
-	}//end if _pMotionEstimator...
-	else
-	{
-		_errorStr = "[H264Codec::Open] Cannot instantiate motion estimator object";
-		Close();
-		return(0);
-	}//end if else...
-
-	  /// --------------- Configure motion compensator -----------------------------------
-	  /// The motion compensator requires the range param to be in full pel units.	
-	_pMotionCompensator = new MotionCompensatorH264ImplStd(motionVectorRange / 4);
+		}//end if !_pCAVLC4x4...
 
-	if (_pMotionCompensator != NULL)
-	{
-		if (!_pMotionCompensator->Create((void *)_pRLum, _lumWidth, _lumHeight, 16, 16))
+		_pBlkScan = new CAVLCH264BlkScan();
+		if (_pBlkScan == NULL)
 		{
-			_errorStr = "[H264Codec::Open] Cannot create motion compensator";
+			_errorStr = "[H264Codec::Open] Cannot instantiate CAVLC block scan object";
 			Close();
 			return(0);
-		}//end if !Create...
-	}//end if _pMotionCompensator...
-	else
-	{
-		_errorStr = "[H264Codec::Open] Cannot instantiate motion compensator object";
-		Close();
-		return(0);
-	}//end if else...
+		}//end if !_pBlkScan...
+
+		/// Attach the vlc encoders and decoders to the associated CAVLC.
+		_pCAVLC4x4->SetMode(CAVLCH264Impl::Mode4x4);
+		((CAVLCH264Impl *)_pCAVLC4x4)->SetTokenCoeffVlcEncoder(_pCoeffTokenVlcEnc);
+		((CAVLCH264Impl *)_pCAVLC4x4)->SetTokenCoeffVlcDecoder(_pCoeffTokenVlcDec);
+		((CAVLCH264Impl *)_pCAVLC4x4)->SetPrefixVlcEncoder(_pPrefixVlcEnc);
+		((CAVLCH264Impl *)_pCAVLC4x4)->SetPrefixVlcDecoder(_pPrefixVlcDec);
+		((CAVLCH264Impl *)_pCAVLC4x4)->SetRunBeforeVlcEncoder(_pRunBeforeVlcEnc);
+		((CAVLCH264Impl *)_pCAVLC4x4)->SetRunBeforeVlcDecoder(_pRunBeforeVlcDec);
+		((CAVLCH264Impl *)_pCAVLC4x4)->SetTotalZerosVlcEncoder(_pTotalZeros4x4VlcEnc);
+		((CAVLCH264Impl *)_pCAVLC4x4)->SetTotalZerosVlcDecoder(_pTotalZeros4x4VlcDec);
+
+		_pCAVLC2x2->SetMode(CAVLCH264Impl::Mode2x2);
+		((CAVLCH264Impl *)_pCAVLC2x2)->SetTokenCoeffVlcEncoder(_pCoeffTokenVlcEnc);
+		((CAVLCH264Impl *)_pCAVLC2x2)->SetTokenCoeffVlcDecoder(_pCoeffTokenVlcDec);
+		((CAVLCH264Impl *)_pCAVLC2x2)->SetPrefixVlcEncoder(_pPrefixVlcEnc);
+		((CAVLCH264Impl *)_pCAVLC2x2)->SetPrefixVlcDecoder(_pPrefixVlcDec);
+		((CAVLCH264Impl *)_pCAVLC2x2)->SetRunBeforeVlcEncoder(_pRunBeforeVlcEnc);
+		((CAVLCH264Impl *)_pCAVLC2x2)->SetRunBeforeVlcDecoder(_pRunBeforeVlcDec);
+		((CAVLCH264Impl *)_pCAVLC2x2)->SetTotalZerosVlcEncoder(_pTotalZeros2x2VlcEnc);
+		((CAVLCH264Impl *)_pCAVLC2x2)->SetTotalZerosVlcDecoder(_pTotalZeros2x2VlcDec);
+	}//end if !_openDecodeOnly...
 
-	  /// Create a motion vector list to hold the decoded vectors for the compensation process.
-	_pMotionVectors = new VectorStructList(VectorStructList::SIMPLE2D);
-	if (!_pMotionVectors)
+	// --------------- Configure bit stream access -----------------------------------
+	if (!_openDecodeOnly)
+		_pBitStreamWriter = new BitStreamWriterMSB();
+	_pBitStreamReader = new BitStreamReaderMSB();
+	if (((_pBitStreamWriter == NULL) && !_openDecodeOnly) || (_pBitStreamReader == NULL))
 	{
-		_errorStr = "[H264Codec::Open] Cannot create motion vector list object";
+		_errorStr = "[H264Codec::Open] Cannot instantiate bit stream access objects";
 		Close();
 		return(0);
-	}//end if !_pMotionVectors...
-	if (!_pMotionVectors->SetLength(mbWidth * mbHeight)) ///< One per Mb for 16x16 vectors only.
+	}//end if !_pBitStreamWriter...
+
+	  /// --------------- Configure motion estimation and compensation -----------------
+	/// Only the encoder uses these objects.
+	if (!_openDecodeOnly)
 	{
-		_errorStr = "[H264Codec::Open] Insufficient mem for motion vector list";
-		Close();
-		return(0);
-	}//end if !SetLength...
+		if (!CreateMotionObjects())
+		{
+			/// Error string is set in the method.
+			Close();
+			return(0);
+		}//end if !CreateMotionObjects...
+	}//end if !_openDecodeOnly...
 
 	/// --------------- Create image plane encoders and decoders ----------------------
 	/// DECODERS: Select an Intra Decoder.
@@ -1552,23 +1696,31 @@ int H264v2Codec::Open(void)
 	/// Set the Inter decoder.
 	_pInterImgPlaneDecoder = new InterImgPlaneDecoderImplStdVer1(this);
 
-	/// ENCODERS: Select an Intra and Inter Encoder depending on the mode.
-	if (_modeOfOperation == H264V2_FIXED_QP)
+	/// ENCODERS: Select an Intra and Inter Encoder depending on the mode. None for decoding only.
+	if (_openDecodeOnly)
+	{
+		/// Decoders only.
+	}//end if _openDecodeOnly...
+	else if (_modeOfOperation == H264V2_FIXED_QP)
 	{
 		_pIntraImgPlaneEncoder = new IntraImgPlaneEncoderImplStdVer1(this);
 		_pInterImgPlaneEncoder = new InterImgPlaneEncoderImplStdVer1(this);
+		_planeEncoderBytes = sizeof(IntraImgPlaneEncoderImplStdVer1) + sizeof(InterImgPlaneEncoderImplStdVer1);
 	}//end if _modeOfOperation...
 	else if (_modeOfOperation == H264V2_MINMAX_EXACT)
 	{
 		_pQuant = 26; ///< Start in the middle before adaptation of each mb QP value.
 		_pIntraImgPlaneEncoder = new IntraImgPlaneEncoderImplMinMax(this);
 		_pInterImgPlaneEncoder = new InterImgPlaneEncoderImplMinMax(this);
+		/// Including the (3 + 6) mb lists allocated in their Create().
+		_planeEncoderBytes = sizeof(IntraImgPlaneEncoderImplMinMax) + sizeof(InterImgPlaneEncoderImplMinMax) + (9 * _mbLength * sizeof(int));
 	}//end else...
 	else	///< if((_modeOfOperation == H264V2_DMAX)||(_modeOfOperation == H264V2_MINMAX_RATECNT)||(_modeOfOperation == H264V2_MINAVG_RATECNT))
 	{
 		_pQuant = 26; ///< Start in the middle before adaptation of each mb QP value.
 		_pIntraImgPlaneEncoder = new IntraImgPlaneEncoderImplDMax(this);
 		_pInterImgPlaneEncoder = new InterImgPlaneEncoderImplDMax(this);
+		_planeEncoderBytes = sizeof(IntraImgPlaneEncoderImplDMax) + sizeof(InterImgPlaneEncoderImplDMax);
 
 		if ((_modeOfOperation == H264V2_MINMAX_RATECNT)||(_modeOfOperation == H264V2_MINAVG_RATECNT))
 		{
@@ -1577,14 +1729,17 @@ int H264v2Codec::Open(void)
 			case H264V2_RATE_CONTROL_MODEL_QUAD:
         _pRateCntlIFrames = new RateControlImplQuad(64.0, 85000.0);
         _pRateCntlPFrames = new RateControlImplQuad(-48.0, 145000.0);
+        _planeEncoderBytes += 2 * sizeof(RateControlImplQuad);
 				break;
 			case H264V2_RATE_CONTROL_MODEL_POW:
 				_pRateCntlIFrames = new RateControlImplPow(-0.64, 15.0);
 				_pRateCntlPFrames = new RateControlImplPow(-2.4, 176000.0);
+				_planeEncoderBytes += 2 * sizeof(RateControlImplPow);
 				break;
 			case H264V2_RATE_CONTROL_MODEL_LOG:
 				_pRateCntlIFrames = new RateControlImplLog(0.2, 1.4);
 				_pRateCntlPFrames = new RateControlImplLog(0.3, 1.8);
+				_planeEncoderBytes += 2 * sizeof(RateControlImplLog);
 				break;
       /*
 			case H264V2_RATE_CONTROL_MODEL_MULTI:
@@ -1611,25 +1766,12 @@ int H264v2Codec::Open(void)
 
 			if ((_pRateCntlPFrames != NULL) && (_pRateCntlIFrames != NULL))
 			{
-				if ((!_pRateCntlPFrames->Create(_numRateCntlFrames)) || (!_pRateCntlIFrames->Create(_numRateCntlFrames)))
+				if (!CreateRateControllers())
 				{
 					_errorStr = "[H264Codec::Open] Cannot create rate controllers";
 					Close();
 					return(0);
-				}//end if !Create...
-				switch (_rateControlModelType)
-				{
-				case H264V2_RATE_CONTROL_MODEL_QUAD:
-					_pRateCntlIFrames->SetRDLimits(24.0, 0.0001, 4000000.0, 32.0);  ///< Quad Abs Diff limits.
-					_pRateCntlPFrames->SetRDLimits(24.0, 0.0001, 4000000.0, 32.0);
-					break;
-				case H264V2_RATE_CONTROL_MODEL_POW:
-				case H264V2_RATE_CONTROL_MODEL_LOG:
-				/*case H264V2_RATE_CONTROL_MODEL_MULTI:*/
-					_pRateCntlIFrames->SetRDLimits(24.0, 0.0001, 67108864.0, 256.0);  ///< Multi-model Sqr Diff limits
-					_pRateCntlPFrames->SetRDLimits(24.0, 0.0001, 67108864.0, 256.0);
-					break;
-				}//end switch _rateControlModelType...
+				}//end if !CreateRateControllers...
 			}//end if _pRateCntlPFrames...
 			else
 			{
@@ -1640,15 +1782,15 @@ int H264v2Codec::Open(void)
 		}//end if _modeOfOperation...
 	}//end else...
 
-	if ((_pIntraImgPlaneEncoder == NULL) || (_pIntraImgPlaneDecoder == NULL) ||
-		(_pInterImgPlaneEncoder == NULL) || (_pInterImgPlaneDecoder == NULL))
+	if ((_pIntraImgPlaneDecoder == NULL) || (_pInterImgPlaneDecoder == NULL) ||
+		(((_pIntraImgPlaneEncoder == NULL) || (_pInterImgPlaneEncoder == NULL)) && !_openDecodeOnly))
 	{
 		_errorStr = "[H264Codec::Open] Cannot instantiate image plane encoder and decoder objects";
 		Close();
 		return(0);
-	}//end if !_pIntraImgPlaneEncoder...
-	if ((!_pIntraImgPlaneEncoder->Create(_mbLength)) ||
-		(!_pInterImgPlaneEncoder->Create(_mbLength)))
+	}//end if !_pIntraImgPlaneDecoder...
+	if ((!_openDecodeOnly) && 
+		((!_pIntraImgPlaneEncoder->Create(_mbLength)) || (!_pInterImgPlaneEncoder->Create(_mbLength))))
 	{
 		_errorStr = "[H264Codec::Open] Cannot create image plane encoders";
 		Close();
@@ -1656,9 +1798,9 @@ int H264v2Codec::Open(void)
 	}//end if !_pIntraImgPlaneEncoder...
 
    /// --------------- Create Region of Interest members ----------------------
-  if (_enableROIEncoding)
+  if (_enableROIEncoding && !_openDecodeOnly)
   {
-    _roiMultiplier = new double[_mbLength];
+    _roiMultiplier = (double *)ArenaAlloc(_mbLength * sizeof(double));
     if (_roiMultiplier == NULL)
     {
       _errorStr = "[H264Codec::Open] Cannot create region of interest members";
@@ -1759,7 +1901,13 @@ The input source pels in the format specified by "incolour" parameter are compre
 to the output stream. The codeParameter specifies either the max size in bits of the
 pCmp buffer or the number of bits to target during the compression process. The interpretation
 is determined by the "mode of operation" parameter. For SPS and PPS encoding the input
-pSrc is ignored.
+pSrc is ignored. For the H264V2_YUV420Px_PLANES formats pSrc is a H264V2_PLANES descriptor
+and the planes are read in place. The NAL units written are listed in the "nalunits" member
+and with "nal length prefix" set each is preceded by its 4 byte length instead of a start code. 
+A "max slice bytes" value > 0 splits the picture into slice NAL units of at most that many bytes,
+where each slice holds at least one macroblock. The emulation prevention bytes are held within
+it by a margin at the escape rate of the last picture and are not guaranteed. A picture whose
+slice headers and re-encoded intra macroblocks exceed their reserve is coded as one slice instead.
 @param  pSrc          : Input raw pels of one complete frame.
 @param  pCmp          : Output compressed stream buffer.
 @param  codeParameter : Mode of operation based bit size limits.
@@ -1770,7 +1918,15 @@ int	H264v2Codec::Code(void* pSrc, void* pCmp, int codeParameter)
 	int allowedBits, bitsUsed;
 
 	if ((_pictureCodingType != H264V2_INTRA) && (_pictureCodingType != H264V2_INTER))
-		return(CodeNonPicNALTypes(pCmp, codeParameter));
+	{
+		if (!CodeNonPicNALTypes(pCmp, codeParameter))
+			return(0);
+		_numNalUnits = 0;
+		if (!AddNalUnit(0, (_pictureCodingType == H264V2_SEQ_PARAM) ? NalHeaderH264::SeqParamSet : NalHeaderH264::PicParamSet))
+			return(0);
+		EndNalUnits((unsigned char *)pCmp, GetCompressedByteLength());
+		return(1);
+	}//end if !H264V2_INTRA...
 
 	if (!_codecIsOpen)
 	{
@@ -1778,6 +1934,12 @@ int	H264v2Codec::Code(void* pSrc, void* pCmp, int codeParameter)
 		return(0);
 	}//end if !_codecIsOpen...
 
+	if (_openDecodeOnly)
+	{
+		_errorStr = "[H264V2Codec::Code] Codec is open for decoding only";
+		return(0);
+	}//end if _openDecodeOnly...
+
 	/// Only baseline profile is supported: _profile_idc = 66.
 	if (_seqParam[_currSeqParam]._profile_idc != 66)
 	{
@@ -1805,6 +1967,7 @@ int	H264v2Codec::Code(void* pSrc, void* pCmp, int codeParameter)
 
 	/// Reset the stream writer with the frame bit limit. 
 	_pBitStreamWriter->SetStream(pCmp, frameBitLimit);
+	_numNalUnits = 0;
 
 	/// Only IDR and P pictures are supported.
 	if ((_pictureCodingType != H264V2_INTRA) && (_pictureCodingType != H264V2_INTER))
@@ -1813,39 +1976,88 @@ int	H264v2Codec::Code(void* pSrc, void* pCmp, int codeParameter)
 		return(0);
 	}//end if !H264V2_INTRA...
 
+	/// A "max slice bytes" picture that failed part way may have left the macroblocks linked in its slices.
+	if (_pMb[_mbLength - 1]._slice != 0)
+		MacroBlockH264::Initialise(_lumHeight / 16, _lumWidth / 16, 0, _mbLength - 1, 0, _Mb);
+
    ///-------------- Colour Space Conversion -----------------------------------------------
+  /// The _width x _height input picture is loaded into the top left of the mod 16 coded 
+  /// picture and the remaining pels are filled by edge extension.
+  int padded = ((_lumWidth != _width) || (_lumHeight != _height));
+  int visChrWidth = _width / 2;
+  int visChrHeight = _height / 2;
   if (_inColour == H264V2_YUV420P16)	      ///< The natural colour space of the encoder with type = short.
-		memcpy((void *)_pLum, (const void *)pSrc, ((_lumWidth * _lumHeight) + 2 * (_chrWidth * _chrHeight)) * sizeof(short));
+  {
+    if (!padded)
+      memcpy((void *)_pLum, (const void *)pSrc, ((_lumWidth * _lumHeight) + 2 * (_chrWidth * _chrHeight)) * sizeof(short));
+    else
+    {
+      short* pl = (short *)pSrc;
+      short* pu = &(pl[_width * _height]);
+      short* pv = &(pu[visChrWidth * visChrHeight]);
+      CopyPlane(pl, _width, _pLum, _lumWidth, _width, _height);
+      CopyPlane(pu, visChrWidth, _pChrU, _chrWidth, visChrWidth, visChrHeight);
+      CopyPlane(pv, visChrWidth, _pChrV, _chrWidth, visChrWidth, visChrHeight);
+    }//end else...
+  }//end if H264V2_YUV420P16...
 	else if (_inColour == H264V2_YUV420P8)  ///< ...type = byte.
 	{
-    if (_flip)
+    if (_flip || padded)
     {
       unsigned char *pl = (unsigned char *)pSrc;
-      unsigned char *pu = &(pl[_lumWidth * _lumHeight]);
-      unsigned char *pv = &(pu[_chrWidth * _chrHeight]);
+      unsigned char *pu = &(pl[_width * _height]);
+      unsigned char *pv = &(pu[visChrWidth * visChrHeight]);
 
-      int row, rrow, col;
+      int row, srow;
 
-      for (row = 0, rrow = (_lumHeight - 1); row < _lumHeight; row++, rrow--)
-        for (col = 0; col < _lumWidth; col++)
-          _pLum[row*_lumWidth + col] = (short)(pl[rrow*_lumWidth + col]);
+      for (row = 0; row < _height; row++)
+      {
+        srow = _flip ? (_height - 1 - row) : row;
+        PelsFrom8Bit(&(pl[srow*_width]), &(_pLum[row*_lumWidth]), _width);
+      }//end for row...
 
-      for (row = 0, rrow = (_chrHeight - 1); row < _chrHeight; row++, rrow--)
-        for (col = 0; col < _chrWidth; col++)
-        {
-          _pChrU[row*_chrWidth + col] = (short)(pu[rrow*_chrWidth + col]);
-          _pChrV[row*_chrWidth + col] = (short)(pv[rrow*_chrWidth + col]);
-        }//end for col...
+      for (row = 0; row < visChrHeight; row++)
+      {
+        srow = _flip ? (visChrHeight - 1 - row) : row;
+        PelsFrom8Bit(&(pu[srow*visChrWidth]), &(_pChrU[row*_chrWidth]), visChrWidth);
+        PelsFrom8Bit(&(pv[srow*visChrWidth]), &(_pChrV[row*_chrWidth]), visChrWidth);
+      }//end for row...
     }//end if flip...
     else
-    {
-      int colLen = (_lumWidth * _lumHeight) + 2 * (_chrWidth * _chrHeight);
-      for (int i = 0; i < colLen; i++)
-        _pLum[i] = (short)((unsigned char *)pSrc)[i];
-    }//end else...
+      PelsFrom8Bit((const unsigned char *)pSrc, _pLum, (_lumWidth * _lumHeight) + 2 * (_chrWidth * _chrHeight));
 	}//end if H264V2_YUV420P8...
+  else if ((_inColour == H264V2_YUV420P16_PLANES) || (_inColour == H264V2_YUV420P8_PLANES))
+  {
+    /// Strided planes are read in place. 16 bit planes that are exactly the codec input
+    /// planes of the "inputplanes" member were written directly by the caller and need no copy.
+    H264V2_PLANES* pIn = (H264V2_PLANES *)pSrc;
+    int inPlace = (_inColour == H264V2_YUV420P16_PLANES) &&
+                  (pIn->pY == (void *)_pLum) && (pIn->pU == (void *)_pChrU) && (pIn->pV == (void *)_pChrV) &&
+                  (pIn->strideY == _lumWidth) && (pIn->strideU == _chrWidth) && (pIn->strideV == _chrWidth);
+    if (!inPlace)
+      LoadInputPlanes(pIn, (_inColour == H264V2_YUV420P8_PLANES));
+  }//end else if H264V2_YUV420P16_PLANES...
 	else
-		_pInColourConverter->Convert((void *)pSrc, (void *)_pLum, (void *)_pChrU, (void *)_pChrV);
+  {
+    if (!padded)
+		  _pInColourConverter->Convert((void *)pSrc, (void *)_pLum, (void *)_pChrU, (void *)_pChrV);
+    else
+    {
+      short* pu = &(_pCropMem[_width * _height]);
+      short* pv = &(pu[visChrWidth * visChrHeight]);
+		  _pInColourConverter->Convert((void *)pSrc, (void *)_pCropMem, (void *)pu, (void *)pv);
+      CopyPlane(_pCropMem, _width, _pLum, _lumWidth, _width, _height);
+      CopyPlane(pu, visChrWidth, _pChrU, _chrWidth, visChrWidth, visChrHeight);
+      CopyPlane(pv, visChrWidth, _pChrV, _chrWidth, visChrWidth, visChrHeight);
+    }//end else...
+  }//end else...
+
+  if (padded)
+  {
+    PadPlane(_pLum, _width, _height, _lumWidth, _lumHeight);
+    PadPlane(_pChrU, visChrWidth, visChrHeight, _chrWidth, _chrHeight);
+    PadPlane(_pChrV, visChrWidth, visChrHeight, _chrWidth, _chrHeight);
+  }//end if padded...
 
   ///-------------- Motion Estimation -----------------------------------------------
   /// Motion estimation is used to determine if an IDR frame should be inserted.
@@ -1945,91 +2157,35 @@ int	H264v2Codec::Code(void* pSrc, void* pCmp, int codeParameter)
 		bitLimit = frameBitLimit - 0; ///< Allow some slack for the expected trailing picture bits.
 	  /// Reset the frame number for I-pics.
 		_frameNum = 0;
+	}//end if H264V2_INTRA...
 
-		/// Prepend SPS and PPS to the I-picture.
-		if (_prependParamSetsToIPic)
-		{
-			allowedBits = bitLimit - _bitStreamSize;
-			int paramTotBitLen = 8 * (_encSeqParamByteLen + _encPicParamByteLen);
-			if (allowedBits < paramTotBitLen)
-			{
-				_errorStr = "[H264V2Codec::Code] Cannot prepend SPS and PPS to I-Picture stream";
-				return(0);
-			}//end if allowedBits...
-
-			/// Write the pre-encoded SPS to the stream.
-			int i;
-			for (i = 0; i < _encSeqParamByteLen; i++)  ///< One byte at a time.
-				_pBitStreamWriter->Write(8, _pEncSeqParam[i]);
-
-			/// Write the pre-encoded PPS to the stream.
-			for (i = 0; i < _encPicParamByteLen; i++)  ///< One byte at a time.
-				_pBitStreamWriter->Write(8, _pEncPicParam[i]);
-
-			_bitStreamSize += paramTotBitLen;
-
-		}//end if _prependParamSetsToIPic...
-	}//end if H264V2_INTRA...
-
-  /// Write the 32-bit start code 0x00000001 to the stream.
-	allowedBits = bitLimit - _bitStreamSize;
-	if (allowedBits < 32)
-	{
-		_errorStr = "[H264V2Codec::Code] Cannot write start code to stream";
-		return(0);
-	}//end if allowedBits...
-	_pBitStreamWriter->Write(32, 1);
-	_bitStreamSize += 32;
-
-	/// Define the NAL unit header based on the seleceted picture coding type. The final NAL type
-	/// is only known at this point in the process.
-	if (_pictureCodingType == H264V2_INTER)
-	{
-		_nal._ref_idc = 2;  ///< Non-zero for all referenced frames P and I.
-		_nal._unit_type = NalHeaderH264::NonIDR_NoPartition_Slice;
-	}//end if H264V2_INTER...
-	else	///< if(_pictureCodingType == H264V2_INTRA)
-	{
-		_nal._ref_idc = 3;  ///< Non-zero for all referenced frames P and I.
-		_nal._unit_type = NalHeaderH264::IDR_Slice;
-	}//end else...
-
-	/// Write the NAL header to the stream. 
-	allowedBits = bitLimit - _bitStreamSize;
-	runOutOfBits = WriteNALHeader(_pBitStreamWriter, allowedBits, &bitsUsed);
-	_bitStreamSize += bitsUsed;
-	if (runOutOfBits) ///< or if(== 2) An error has occured.
-		return(0);
-
-	/// Write (concatinate) the slice header layer with its header flags to
-	/// the stream. There is only one slice so the header, macroblocks (slice
-	/// data) and tail may be coded in a linear order.
-	_slice._frame_num = _frameNum;
-	_slice._idr_pic_id = _idrFrameNum;
-	/// Force the image plane encoders to use _pQuant as the slice qp and therefore the
-	/// slice header is determined before encoding and may be added to the bit stream here.
-	_slice._qp = _pQuant;
-	_slice._qp_delta = _slice._qp - (_picParam[_currPicParam]._pic_init_qp_minus26 + 26);
-	_slice._pic_parameter_set_id = _currPicParam;
-	/// Baseline profile only has two slice types and in this implementation they are
-	/// used for the entire frame/picture.
-	if (_pictureCodingType == H264V2_INTER)
-		_slice._type = SliceHeaderH264::P_Slice_All;
-	else
-		_slice._type = SliceHeaderH264::I_Slice_All;
-
-	allowedBits = bitLimit - _bitStreamSize;
-	runOutOfBits = WriteSliceLayerHeader(_pBitStreamWriter, allowedBits, &bitsUsed);
-	_bitStreamSize += bitsUsed;
-	if (runOutOfBits) ///< or if(== 2) An error has occured.
-		return(0);
+	/// Write the headers of the picture and its 1st slice.
+	int sliceStartByte;
+	if (!WritePictureHeaders(bitLimit, &sliceStartByte))
+		return(0);
 
 	/// Encode the entire picture. The plane encoders do not write to the stream
 	/// but do require to know the available bits. Allowance is made for the single
 	/// trailing bit.
 	allowedBits = bitLimit - _bitStreamSize - 1;
+	/// The emulation prevention bytes are only known once the stream is written and are
+	/// reserved for here.
+	if (_startCodeEmulationPrevention && (allowedBits > 0))
+		allowedBits -= EmulationReserveBits(allowedBits);
+	/// In "max slice bytes" mode every further slice adds a start code, NAL header, slice
+	/// header and trailing bits. The 1st slice overhead, with the largest first mb in slice
+	/// code, is the estimate and is reserved at the rate of one per max slice bytes.
+	if ((_maxSliceBytes > 0) && (allowedBits > 0))
+	{
+		int sliceOverheadBits = (_bitStreamSize - (8 * sliceStartByte)) + ExpGolombH264::UnsignedBits(_mbLength) + 8;
+		allowedBits -= (int)(((double)allowedBits * (double)sliceOverheadBits) / (double)(8 * _maxSliceBytes));
+		/// Intra macroblocks that lose their neighbours at a slice start are re-encoded at their
+		/// coding QP when the slices are written and are not under the control of the encoders.
+		allowedBits -= (allowedBits >> H264V2_RESLICE_RESERVE_SHIFT);
+	}//end if _maxSliceBytes...
 
 	///-------------- Encoding process ---------------------------------
+	int prevRef = _refIndex;	///< Restored as the ref if the picture is not completed.
 	if (_pictureCodingType == H264V2_INTRA)
 	{
 		_prevMotionDistortion = -1;
@@ -2042,19 +2198,80 @@ int	H264v2Codec::Code(void* pSrc, void* pCmp, int codeParameter)
 	}//end if H264V2_INTRA...
 	else if (_pictureCodingType == H264V2_INTER)
 	{
+		/// INTER picture reconstruct into the next ref picture of the ring. The previous
+		/// reconstruction is not modified and is restored as the ref on failure.
+		SelectReference((_refIndex + 1) % H264V2_REF_PICS);
+
     /// The encoder was chosen in Open() depending on the mode selected. It
 		/// operates on the list of macroblocks. Motion compensation is included.
 		if (!_pInterImgPlaneEncoder->Encode(allowedBits, &bitsUsed, 3))
+		{
+			SelectReference(prevRef);
 			return(0);	///< An error has occured.
+		}//end if !Encode...
 	}//end else H264V2_INTER...
 
   ///-------------- Write to stream ---------------------------------
 	/// Write (concatinate) the macroblock layer (slice data) with its header 
 	/// flags to the stream.
-	runOutOfBits = WriteSliceDataLayer(_pBitStreamWriter, allowedBits, &bitsUsed);
-	_bitStreamSize += bitsUsed;
+	if (_maxSliceBytes > 0)
+	{
+		/// The slice headers and the re-encoded macroblocks are written from the reserves
+		/// that the encoders were not given.
+		int slicedBits = bitLimit - _bitStreamSize - 1;
+		if (_startCodeEmulationPrevention && (slicedBits > 0))
+			slicedBits -= EmulationReserveBits(slicedBits);
+		runOutOfBits = WriteSlicedDataLayer(_pBitStreamWriter, slicedBits, _bitStreamSize - (8 * sliceStartByte) - 32, &bitsUsed);
+		_bitStreamSize += bitsUsed;
+		if (runOutOfBits)
+		{
+			/// The reserves were exceeded. Rewrite the picture as a single slice from the
+			/// start of the stream with all the bits available to the encoders.
+			_pBitStreamWriter->SetStream(pCmp, frameBitLimit);
+			_bitStreamSize = 0;
+			_numNalUnits = 0;
+			MacroBlockH264::Initialise(_lumHeight / 16, _lumWidth / 16, 0, _mbLength - 1, 0, _Mb);
+			if (!WritePictureHeaders(bitLimit, &sliceStartByte))
+			{
+				if (_pictureCodingType == H264V2_INTER)
+					SelectReference(prevRef);
+				return(0);
+			}//end if !WritePictureHeaders...
+
+			allowedBits = bitLimit - _bitStreamSize - 1;
+			if (_startCodeEmulationPrevention && (allowedBits > 0))
+				allowedBits -= EmulationReserveBits(allowedBits);
+			/// The encoders accumulate the frame distortion for the rate control.
+			_frameMSD = 0;
+			_frameMAD = 0;
+			_frameMAD_N = 0;
+			if (_pictureCodingType == H264V2_INTRA)
+			{
+				Restart();
+				if (!_pIntraImgPlaneEncoder->Encode(allowedBits, &bitsUsed, 1))
+					return(0);
+			}//end if H264V2_INTRA...
+			else if (!_pInterImgPlaneEncoder->Encode(allowedBits, &bitsUsed, 3))
+			{
+				SelectReference(prevRef);
+				return(0);
+			}//end else if !Encode...
+
+			runOutOfBits = WriteSliceDataLayer(_pBitStreamWriter, allowedBits, &bitsUsed);
+			_bitStreamSize += bitsUsed;
+		}//end if runOutOfBits...
+	}//end if _maxSliceBytes...
+	else
+	{
+		runOutOfBits = WriteSliceDataLayer(_pBitStreamWriter, allowedBits, &bitsUsed);
+		_bitStreamSize += bitsUsed;
+	}//end else...
 	if (runOutOfBits) ///< or if(== 2) An error has occured.
+	{
+		if (_pictureCodingType == H264V2_INTER)
+			SelectReference(prevRef);
 		return(0);
+	}//end if runOutOfBits...
 
 	/// Write (concatinate) the slice trailing bits to the stream. This is a min
   /// of 1 bit + zero bits to the end of the byte boundary.
@@ -2062,23 +2279,53 @@ int	H264v2Codec::Code(void* pSrc, void* pCmp, int codeParameter)
 	runOutOfBits = WriteTrailingBits(_pBitStreamWriter, allowedBits, &bitsUsed);
 	_bitStreamSize += bitsUsed;
 	if (runOutOfBits) ///< or if(== 2) An error has occured.
+	{
+		if (_pictureCodingType == H264V2_INTER)
+			SelectReference(prevRef);
 		return(0);
+	}//end if runOutOfBits...
 
 	/// Prevent start code emulation within the coded bit stream. The extra byte added
-	/// to prevent the emulation is not counted as part of the bit written.
+	/// to prevent the emulation is not counted as part of the bit written but must fit
+	/// in the stream reserve made before encoding. The escaped size is included in the
+	/// rate control measurements below.
 	if (_startCodeEmulationPrevention)
 	{
 		int offset = 0;
 		if ((_pictureCodingType == H264V2_INTRA) && (_prependParamSetsToIPic))
 			offset = _encSeqParamByteLen + _encPicParamByteLen;
 
-		_bitStreamSize += InsertEmulationPrevention(_pBitStreamWriter, offset);
+		int emulationBits = InsertEmulationPrevention(_pBitStreamWriter, offset, bitLimit - _bitStreamSize);
+		if (emulationBits < 0)
+		{
+			/// The escape rate is beyond the reserve. Raise the reserve of the following pictures to it.
+			_emulationBits = EmulationPreventionBits(_pBitStreamWriter, offset);
+			_emulationStreamBits = _bitStreamSize;
+			if (_pictureCodingType == H264V2_INTER)
+				SelectReference(prevRef);
+			_errorStr = "[H264v2Codec::Code] Insufficient stream space for start code emulation prevention";
+			return(0);
+		}//end if emulationBits...
+		_emulationBits = emulationBits;
+		_emulationStreamBits = _bitStreamSize;
+		_bitStreamSize += emulationBits;
 	}//end if _startCodeEmulationPrevention...
 
+	/// The NAL unit sizes are only final after emulation prevention. In length prefix mode
+	/// the start codes are replaced by the sizes.
+	EndNalUnits((unsigned char *)pCmp, GetCompressedByteLength());
+
+	/// The deblocking filter crosses slice edges and uses the single slice neighbourhood.
+	if (_pMb[_mbLength - 1]._slice != 0)
+		MacroBlockH264::Initialise(_lumHeight / 16, _lumWidth / 16, 0, _mbLength - 1, 0, _Mb);
+
 	/// In-loop filter for 4x4 block boundaries to remove blocking artefacts.
 	if (_slice._disable_deblocking_filter_idc != 1)
 		ApplyLoopFilter();
 
+	/// Replicate the filtered ref picture edges into the borders.
+	ExtendReferenceBorder();
+
 	///-------------- Post-encoding rate control ---------------------------------
 	if ((_modeOfOperation == H264V2_MINMAX_RATECNT)|| (_modeOfOperation == H264V2_MINAVG_RATECNT))
 	{
@@ -2156,8 +2403,13 @@ int	H264v2Codec::Code(void* pSrc, void* pCmp, int codeParameter)
 
 /** Decode the compresed frame into raw pel samples.
 The input types are a compressed picture IDR or P NAL unit, a SPS, a PPS or a concatenated
-SPS, PPS and compressed picture. The output is the raw picture pels in the format specified
-by the "outcolour" codec parameter.
+SPS, PPS and compressed picture, as a whole access unit from AnnexBSplitterH264. Start codes
+may be 3 or 4 bytes, or 4 byte NAL unit lengths when "nal length prefix" is set, and other NAL
+unit types are skipped. A picture may be split into more than one slice NAL unit, in order and
+without gaps. The compressed stream is only read. The output is the raw 
+picture pels in the format specified by the "outcolour" codec parameter. For H264V2_YUV420P16_VIEW pDst is a H264V2_PICTURE_VIEW
+that is pointed at the reconstructed picture without copying, valid until the next call. For the
+*_PLANES formats pDst is a H264V2_PLANES descriptor or NULL to use the registered "outputplanes".
 @param  pCmp      : Compressed stream.
 @param  bitLength : Length in bits of pCmp.
 @param  pDst      : Raw pel output.
@@ -2170,22 +2422,21 @@ int	H264v2Codec::Decode(void* pCmp, int bitLength, void* pDst)
 	int bitsUsed = 0;
 	int ret = 1;
 	int moreNonPicNALUnits = 1;
+	int nalBytes = 0;
+	int nalStartByte = 0;
 
 	/// Set the bit stream access. The bit stream reader and related objects are instantiated within 
-	/// Open() and is therefore not available for non-picture NAL types. They are temporarily created 
-	/// for these other NAL types.
+	/// Open() and is therefore not available for non-picture NAL types. The persistent parsing 
+	/// objects are used for these other NAL types.
 	_bitStreamSize = bitLength;
+	_viewToken++;	///< Any previous decoded picture view is no longer valid.
+	if (!CreateParseObjects())
+		return(0);
 	if (!_codecIsOpen)
 	{
-		_pBitStreamReader = new BitStreamReaderMSB();
-		_pHeaderUnsignedVlcDec = new ExpGolombUnsignedVlcDecoder();
-		_pHeaderSignedVlcDec = new ExpGolombSignedVlcDecoder();
-		if ((_pBitStreamReader == NULL) || (_pHeaderUnsignedVlcDec == NULL) || (_pHeaderSignedVlcDec == NULL))
-		{
-			_errorStr = "[H264Codec::Decode] Cannot instantiate stream reader and vlc objects";
-			ret = 0;
-			goto H264V2_D_CLEAN_MEM;
-		}//end if !_pBitStreamReader...
+		_pBitStreamReader = _pParseBitStreamReader;
+		_pHeaderUnsignedVlcDec = _pParseUnsignedVlcDec;
+		_pHeaderSignedVlcDec = _pParseSignedVlcDec;
 	}//end if !_codecIsOpen...
 	  /// Set the stream reader.
 	_pBitStreamReader->SetStream(pCmp, bitLength);
@@ -2195,15 +2446,44 @@ int	H264v2Codec::Decode(void* pCmp, int bitLength, void* pDst)
 	/// then we assume there is another NAL to be decoded.
 	while (moreNonPicNALUnits)
 	{
-		/// Extract the start code 0x00000001 from the stream.
-		int startCode = _pBitStreamReader->Read(32);
-		if (startCode != 1)
+		nalBytes = 0;
+		if (_nalLengthPrefix)
 		{
-			_errorStr = "[H264Codec::Decode] Cannot extract start code from stream";
-			ret = 0;
-			goto H264V2_D_CLEAN_MEM;
-		}//end if frameBitSize...
-		frameBitSize -= 32;
+			/// Extract the 4 byte big endian NAL unit length that replaces the start code.
+			if (frameBitSize >= 32)
+			{
+				nalBytes = _pBitStreamReader->Read(32);
+				frameBitSize -= 32;
+			}//end if frameBitSize...
+			if ((nalBytes < 1) || (nalBytes > (frameBitSize / 8)))
+			{
+				_errorStr = "[H264Codec::Decode] Invalid NAL unit length prefix";
+				ret = 0;
+				goto H264V2_D_CLEAN_MEM;
+			}//end if nalBytes...
+		}//end if _nalLengthPrefix...
+		else
+		{
+			/// Extract the start code from the stream. Annex B streams use either the 3 byte 0x000001
+			/// or the 4 byte 0x00000001 form and may pad between NAL units with extra zero bytes.
+			int zeroBytes = 0;
+			int startCode = 0;
+			while (frameBitSize >= 8)
+			{
+				startCode = _pBitStreamReader->Read(8);
+				frameBitSize -= 8;
+				if (startCode != 0)
+					break;
+				zeroBytes++;
+			}//end while frameBitSize...
+			if ((zeroBytes < 2) || (startCode != 1))
+			{
+				_errorStr = "[H264Codec::Decode] Cannot extract start code from stream";
+				ret = 0;
+				goto H264V2_D_CLEAN_MEM;
+			}//end if zeroBytes...
+		}//end else...
+		nalStartByte = _pBitStreamReader->GetStreamBitPos() / 8;
 
 		/// Get the NAL header encodings off the bit stream to determine the picture coding type..
 		runOutOfBits = ReadNALHeader(_pBitStreamReader, frameBitSize, &bitsUsed);
@@ -2260,32 +2540,34 @@ int	H264v2Codec::Decode(void* pCmp, int bitLength, void* pDst)
 				goto H264V2_D_CLEAN_MEM;
 			}//end if runOutOfBits...
 
-	/// If the codec is in the open state then any change in sequence or picture param set requires the
-	/// codec to be restarted with these new sets. But the bit stream must be preserved and restored 
-	/// after the call to Open().
+	/// If the codec is in the open state then any change in sequence or picture param set must be
+	/// applied. A change in picture geometry requires the codec to be restarted with these new sets
+	/// but the bit stream must be preserved and restored after the call to Open().
 			if (_codecIsOpen)
 			{
 				if (changed)
 				{
-					/// Preserve the bitstream
-					IBitStreamReader* pTmpBitStreamReader = new BitStreamReaderMSB();
-					pTmpBitStreamReader->Copy(_pBitStreamReader);
-
-					int tmpPicCodingType = _pictureCodingType; ///< Store the coding type.
-
+					/// Param sets that keep the picture geometry are applied without
+					/// tearing down the codec resources.
 					_genParamSetOnOpen = 0; ///< Must be off if the new param sets are to be used.
-					if (!Open())
+					if (!ReconfigureInPlace())
 					{
-						delete pTmpBitStreamReader;
-						ret = 0;
-						goto H264V2_D_CLEAN_MEM;
-					}//end if !Open...
-
-					/// Restore the picture coding type.
-					_pictureCodingType = tmpPicCodingType;
-					/// Restore the bitstream.
-					_pBitStreamReader->Copy(pTmpBitStreamReader);
-					delete pTmpBitStreamReader;
+						/// Preserve the bitstream
+						_pSaveBitStreamReader->Copy(_pBitStreamReader);
+
+						int tmpPicCodingType = _pictureCodingType; ///< Store the coding type.
+
+						if (!Open())
+						{
+							ret = 0;
+							goto H264V2_D_CLEAN_MEM;
+						}//end if !Open...
+
+						/// Restore the picture coding type.
+						_pictureCodingType = tmpPicCodingType;
+						/// Restore the bitstream.
+						_pBitStreamReader->Copy(_pSaveBitStreamReader);
+					}//end if !ReconfigureInPlace...
 				}//end if changed...
 
 			}//end if _codecIsOpen...
@@ -2320,10 +2602,37 @@ int	H264v2Codec::Decode(void* pCmp, int bitLength, void* pDst)
 		};//end SeqParamSet and PicParamSet block...
 		break;
 		default:
-			_errorStr = "[H264v2Codec::Decode] NAL unit type not supported";
-			ret = 0;
-			goto H264V2_D_CLEAN_MEM;
-			break;
+		{
+			/// NAL unit types that are not supported (SEI, AUD, end of seq, filler, etc.) are
+			/// skipped over to the next start code or by their length prefix. The NAL header has
+			/// left the reader byte aligned.
+			const unsigned char* stream = (const unsigned char*)pCmp;
+			int endByte = bitLength / 8;
+			int next = -1;
+			if (_nalLengthPrefix)
+			{
+				if ((nalStartByte + nalBytes + 5) <= endByte)
+					next = nalStartByte + nalBytes;
+			}//end if _nalLengthPrefix...
+			else
+				next = FindStartCodePrefix(stream, _pBitStreamReader->GetStreamBitPos() / 8, endByte);
+
+			if (next < 0) ///< No more units.
+			{
+				moreNonPicNALUnits = 0;
+				if (_codecIsOpen)
+					return(1);
+				else
+				{
+					ret = 1;
+					goto H264V2_D_CLEAN_MEM;
+				}//end else...
+			}//end if next...
+
+			_pBitStreamReader->Seek(next * 8);
+			frameBitSize = bitLength - (next * 8);
+		};//end unsupported NAL block...
+		break;
 		}//end switch _unit_type...
 	}//end while moreNonPicNALUnits...
 
@@ -2342,52 +2651,131 @@ int	H264v2Codec::Decode(void* pCmp, int bitLength, void* pDst)
 		return(0);
 	}//end if _profile_idc not baseline...
 
-  /// Remove prevention of start code emulation codes within the coded bit stream.
-	if (_startCodeEmulationPrevention)
-		frameBitSize -= RemoveEmulationPrevention(_pBitStreamReader);
-
-	/// Get the slice header encodings off the bit stream. As this implementation 
-	/// has only one slice, the slice header, slice data (macroblocks) and the 
-	/// slice trailing bits can be decoded in linear order.
-	runOutOfBits = ReadSliceLayerHeader(_pBitStreamReader, frameBitSize, &bitsUsed);
-	frameBitSize -= bitsUsed;
-	if (runOutOfBits > 0) ///< An error has occurred. 1 = run out of bits, 2 = vlc decode error.
-		return(0);
-	/// Load frame counter members from the decoded slice header.
-	_frameNum = _slice._frame_num;
-	_idrFrameNum = _slice._idr_pic_id;
-	/// Load the picture and sequence parameter set references.
-	_currPicParam = _slice._pic_parameter_set_id;
-	_currSeqParam = _picParam[_currPicParam]._seq_parameter_set_id;
-	/// There is only one slice so the quant parameter is picture quant + the delta slice quant.
-	_slice._qp = _picParam[_currPicParam]._pic_init_qp_minus26 + 26 + _slice._qp_delta;
-	_pQuant = _slice._qp;
+	/// A picture that failed part way may have left the macroblocks linked in its slices.
+	if (_pMb[_mbLength - 1]._slice != 0)
+		MacroBlockH264::Initialise(_lumHeight / 16, _lumWidth / 16, 0, _mbLength - 1, 0, _Mb);
 
-#ifdef H264V2_DUMP_HEADERS
-	if (_headerTablePos < _headerTableLen)
+	/// Decode the slice NAL units of the picture in order. The slice header, slice data
+	/// (macroblocks) and the slice trailing bits of each are decoded in linear order. A
+	/// following slice NAL unit of the same type that does not start at macroblock 0
+	/// continues the picture.
 	{
-		_headerTable.WriteItem(0, _headerTablePos, _nal._unit_type);     /// "NALType"
-		_headerTable.WriteItem(1, _headerTablePos, _nal._ref_idc);       /// "NALRefIdc"
-		_headerTable.WriteItem(2, _headerTablePos, _slice._idr_pic_id);  ///  "IdrPicId"
-		_headerTable.WriteItem(3, _headerTablePos, _slice._frame_num);   ///  "FrmNum"
-		_headerTable.WriteItem(4, _headerTablePos, _slice._type);        ///  "SliceType"
-		_headerTable.WriteItem(5, _headerTablePos, _slice._qp);          ///  "Qp"
+		const unsigned char* stream = (const unsigned char*)pCmp;
+		int endByte = bitLength / 8;
+		int sliceNum = 0;
+		while (1)
+		{
+			/// The slice NAL unit ends at its length prefix size or at the next start code.
+			int nalEndByte = endByte;
+			if (_nalLengthPrefix)
+				nalEndByte = nalStartByte + nalBytes;
+			else
+			{
+				int next = FindStartCodePrefix(stream, nalStartByte, endByte);
+				if (next >= 0)
+					nalEndByte = next;
+			}//end else...
 
-		_headerTablePos++;
-	}//end if _headerTablePos...
+			/// Remove prevention of start code emulation codes within the slice NAL unit. It
+			/// is unescaped into scratch memory and pCmp is not modified.
+			int sliceEndByte = nalEndByte;
+			if (_startCodeEmulationPrevention)
+			{
+				if (RemoveEmulationPrevention(_pBitStreamReader, nalEndByte * 8) < 0)
+				{
+					_errorStr = "[H264Codec::Decode] Cannot remove start code emulation prevention";
+					return(0);
+				}//end if RemoveEmulationPrevention...
+				sliceEndByte = (_pBitStreamReader->GetStreamBitSize() + 7) / 8;
+			}//end if _startCodeEmulationPrevention...
+			frameBitSize = (sliceEndByte * 8) - _pBitStreamReader->GetStreamBitPos();
+			/// The slice data ends at the rbsp stop bit.
+			int stopBit = RbspStopBitPos((const unsigned char*)(_pBitStreamReader->GetStream()), sliceEndByte);
+
+			/// Get the slice header encodings off the bit stream.
+			runOutOfBits = ReadSliceLayerHeader(_pBitStreamReader, frameBitSize, &bitsUsed);
+			frameBitSize -= bitsUsed;
+			if (runOutOfBits > 0) ///< An error has occurred. 1 = run out of bits, 2 = vlc decode error.
+				return(0);
+			if ((_slice._first_mb_in_slice >= _mbLength) || ((sliceNum == 0) && (_slice._first_mb_in_slice != 0)))
+			{
+				_errorStr = "[H264Codec::Decode] Invalid first macroblock in slice";
+				return(0);
+			}//end if _first_mb_in_slice...
+			if (sliceNum == 0)
+			{
+				/// Load frame counter members from the decoded slice header.
+				_frameNum = _slice._frame_num;
+				_idrFrameNum = _slice._idr_pic_id;
+				/// Load the picture and sequence parameter set references.
+				_currPicParam = _slice._pic_parameter_set_id;
+				_currSeqParam = _picParam[_currPicParam]._seq_parameter_set_id;
+			}//end if sliceNum...
+			/// The quant parameter is picture quant + the delta slice quant.
+			_slice._qp = _picParam[_currPicParam]._pic_init_qp_minus26 + 26 + _slice._qp_delta;
+			_pQuant = _slice._qp;
+
+#ifdef H264V2_DUMP_HEADERS
+			if (_headerTablePos < _headerTableLen)
+			{
+				_headerTable.WriteItem(0, _headerTablePos, _nal._unit_type);     /// "NALType"
+				_headerTable.WriteItem(1, _headerTablePos, _nal._ref_idc);       /// "NALRefIdc"
+				_headerTable.WriteItem(2, _headerTablePos, _slice._idr_pic_id);  ///  "IdrPicId"
+				_headerTable.WriteItem(3, _headerTablePos, _slice._frame_num);   ///  "FrmNum"
+				_headerTable.WriteItem(4, _headerTablePos, _slice._type);        ///  "SliceType"
+				_headerTable.WriteItem(5, _headerTablePos, _slice._qp);          ///  "Qp"
+
+				_headerTablePos++;
+			}//end if _headerTablePos...
 #endif // H264V2_DUMP_HEADERS
 
-	/// Get the macroblock (slice data) encodings off the bit stream.
-	runOutOfBits = ReadSliceDataLayer(_pBitStreamReader, frameBitSize, &bitsUsed);
-	frameBitSize -= bitsUsed;
-	if (runOutOfBits > 0) ///< An error has occurred. 1 = run out of bits, 2 = vlc decode error.
-		return(0);
+			/// The macroblocks of a following slice are linked into its neighbourhood.
+			if (sliceNum > 0)
+				MacroBlockH264::Initialise(_lumHeight / 16, _lumWidth / 16, _slice._first_mb_in_slice, _mbLength - 1, sliceNum, _Mb);
 
-	/// Get the slice trailing bits off the bit stream. 
-	runOutOfBits = ReadTrailingBits(_pBitStreamReader, frameBitSize, &bitsUsed);
-	frameBitSize -= bitsUsed;
-	if (runOutOfBits > 0) ///< An error has occurred. 1 = run out of bits, 2 = vlc decode error.
-		return(0);
+			/// Get the macroblock (slice data) encodings off the bit stream.
+			runOutOfBits = ReadSliceDataLayer(_pBitStreamReader, stopBit - _pBitStreamReader->GetStreamBitPos(), &bitsUsed);
+			frameBitSize -= bitsUsed;
+			if (runOutOfBits > 0) ///< An error has occurred. 1 = run out of bits, 2 = vlc decode error.
+				return(0);
+
+			/// Get the slice trailing bits off the bit stream. 
+			runOutOfBits = ReadTrailingBits(_pBitStreamReader, frameBitSize, &bitsUsed);
+			frameBitSize -= bitsUsed;
+			if (runOutOfBits > 0) ///< An error has occurred. 1 = run out of bits, 2 = vlc decode error.
+				return(0);
+
+			/// Find the header of the next NAL unit. Its 1st byte after the header starts with
+			/// a 1 bit when first_mb_in_slice = 0.
+			int nextHeader = -1;
+			if (_nalLengthPrefix)
+			{
+				if ((nalEndByte + 6) <= endByte)
+				{
+					nalBytes = (stream[nalEndByte] << 24) | (stream[nalEndByte + 1] << 16) | (stream[nalEndByte + 2] << 8) | stream[nalEndByte + 3];
+					nextHeader = nalEndByte + 4;
+					if ((nalBytes < 1) || (nalBytes > (endByte - nextHeader)))
+					{
+						_errorStr = "[H264Codec::Decode] Invalid NAL unit length prefix";
+						return(0);
+					}//end if nalBytes...
+				}//end if nalEndByte...
+			}//end if _nalLengthPrefix...
+			else if ((nalEndByte + 5) <= endByte)
+				nextHeader = nalEndByte + 3;
+			if ((nextHeader < 0) || ((stream[nextHeader] & 31) != _nal._unit_type) || (stream[nextHeader + 1] & 0x80))
+				break;
+
+			/// Continue the picture with the next slice NAL unit.
+			nalStartByte = nextHeader;
+			sliceNum++;
+			_pBitStreamReader->SetStream(pCmp, bitLength);
+			_pBitStreamReader->Seek(nalStartByte * 8);
+			runOutOfBits = ReadNALHeader(_pBitStreamReader, bitLength - (nalStartByte * 8), &bitsUsed);
+			if (runOutOfBits > 0) ///< An error has occurred. 1 = run out of bits, 2 = vlc decode error.
+				return(0);
+		}//end while 1...
+	}//end slice block...
 
 	/// INTRA frames require the reference images to be zeroed.
 	if (_pictureCodingType == H264V2_INTRA)
@@ -2401,53 +2789,143 @@ int	H264v2Codec::Decode(void* pCmp, int bitLength, void* pDst)
 	}//end if INTRA...
 	else
 	{
-		/// INTER picture decode.
+		/// INTER picture decode into the next ref picture of the ring. The previous
+		/// reconstruction is not modified and is restored as the ref on failure.
+		int prevRef = _refIndex;	///< Restored as the ref if the picture is not completed.
+		SelectReference((_refIndex + 1) % H264V2_REF_PICS);
+
 		/// The decoder was chosen in Open() depending on the mode selected. It
 		/// operates on the list of macroblocks. Motion compensation is included.
 		if (!_pInterImgPlaneDecoder->Decode())
+		{
+			SelectReference(prevRef);
 			return(0);	///< An error has occured.
+		}//end if !Decode...
 	}//end else INTER...
 
+	/// The deblocking filter crosses slice edges and uses the single slice neighbourhood.
+	if (_pMb[_mbLength - 1]._slice != 0)
+		MacroBlockH264::Initialise(_lumHeight / 16, _lumWidth / 16, 0, _mbLength - 1, 0, _Mb);
+
 	/// In-loop filter for 4x4 block boundaries to remove blocking artefacts.
 	if (_slice._disable_deblocking_filter_idc != 1)
 		ApplyLoopFilter();
 
+	/// Replicate the filtered ref picture edges into the borders.
+	ExtendReferenceBorder();
+
 	/// Convert to the output image depending on the output dimension settings. Set
-	  /// up in the Open() method for the correctly selected converter.
-	if (_outColour == H264V2_YUV420P16)      /// The natural colour space of the decoder with type = short.
-		memcpy((void *)pDst, (const void *)_pLum, ((_lumWidth * _lumHeight) + 2 * (_chrWidth * _chrHeight)) * sizeof(short));
-	else if (_outColour == H264V2_YUV420P8)  ///< ...type = byte.
-	{
-		int colLen = (_lumWidth * _lumHeight) + 2 * (_chrWidth * _chrHeight);
-		for (int i = 0; i < colLen; i++)
-			((unsigned char *)pDst)[i] = (unsigned char)_pLum[i];
-	}//end if H264V2_YUV420P8...
-	else
-		_pOutColourConverter->Convert(_pRLum, _pRChrU, _pRChrV, pDst);
+	  /// up in the Open() method for the correctly selected converter. Only the visible
+	  /// _width x _height picture at the crop origin of the ref is output.
+	{
+		int visChrWidth = _width / 2;
+		int visChrHeight = _height / 2;
+		short* pRLum = &(_pRLum[(_cropY * _lumWidth) + _cropX]);
+		short* pRChrU = &(_pRChrU[((_cropY / 2) * _chrWidth) + (_cropX / 2)]);
+		short* pRChrV = &(_pRChrV[((_cropY / 2) * _chrWidth) + (_cropX / 2)]);
+
+		if (_outColour == H264V2_YUV420P16)      /// The natural colour space of the decoder with type = short.
+		{
+			short* pl = (short *)pDst;
+			short* pu = &(pl[_width * _height]);
+			short* pv = &(pu[visChrWidth * visChrHeight]);
+			CopyPlane(pRLum, _lumWidth, pl, _width, _width, _height);
+			CopyPlane(pRChrU, _chrWidth, pu, visChrWidth, visChrWidth, visChrHeight);
+			CopyPlane(pRChrV, _chrWidth, pv, visChrWidth, visChrWidth, visChrHeight);
+		}//end if H264V2_YUV420P16...
+		else if (_outColour == H264V2_YUV420P8)  ///< ...type = byte.
+		{
+			unsigned char* pl = (unsigned char *)pDst;
+			unsigned char* pu = &(pl[_width * _height]);
+			unsigned char* pv = &(pu[visChrWidth * visChrHeight]);
+			int row;
+			for (row = 0; row < _height; row++)
+				PelsTo8Bit(&(pRLum[row * _lumWidth]), &(pl[row * _width]), _width);
+			for (row = 0; row < visChrHeight; row++)
+			{
+				PelsTo8Bit(&(pRChrU[row * _chrWidth]), &(pu[row * visChrWidth]), visChrWidth);
+				PelsTo8Bit(&(pRChrV[row * _chrWidth]), &(pv[row * visChrWidth]), visChrWidth);
+			}//end for row...
+		}//end if H264V2_YUV420P8...
+		else if ((_outColour == H264V2_YUV420P16_PLANES) || (_outColour == H264V2_YUV420P8_PLANES))
+		{
+			/// A NULL pDst decodes into the planes registered with SetMember("outputplanes").
+			H264V2_PLANES* pOut = (pDst != NULL) ? (H264V2_PLANES *)pDst : &_outPlanes;
+			if ((pOut->pY == NULL) || (pOut->pU == NULL) || (pOut->pV == NULL))
+			{
+				_errorStr = "[H264Codec::Decode] No output planes registered";
+				return(0);
+			}//end if pY...
+			StoreOutputPlanes(pOut, pRLum, pRChrU, pRChrV, (_outColour == H264V2_YUV420P8_PLANES));
+		}//end else if H264V2_YUV420P16_PLANES...
+		else if (_outColour == H264V2_YUV420P16_VIEW)
+		{
+			/// No copy. The ref planes are exposed until the next Decode() call.
+			H264V2_PICTURE_VIEW* pView = (H264V2_PICTURE_VIEW *)pDst;
+			pView->planes.pY = (void *)pRLum;
+			pView->planes.pU = (void *)pRChrU;
+			pView->planes.pV = (void *)pRChrV;
+			pView->planes.strideY = _lumWidth;
+			pView->planes.strideU = _chrWidth;
+			pView->planes.strideV = _chrWidth;
+			pView->width = _width;
+			pView->height = _height;
+			pView->token = _viewToken;
+		}//end else if H264V2_YUV420P16_VIEW...
+		else if (_pCropMem == NULL)
+			_pOutColourConverter->Convert(_pRLum, _pRChrU, _pRChrV, pDst);
+		else
+		{
+			short* pu = &(_pCropMem[_width * _height]);
+			short* pv = &(pu[visChrWidth * visChrHeight]);
+			CopyPlane(pRLum, _lumWidth, _pCropMem, _width, _width, _height);
+			CopyPlane(pRChrU, _chrWidth, pu, visChrWidth, visChrWidth, visChrHeight);
+			CopyPlane(pRChrV, _chrWidth, pv, visChrWidth, visChrWidth, visChrHeight);
+			_pOutColourConverter->Convert(_pCropMem, pu, pv, pDst);
+		}//end else...
+	}
 
 	return(1);
 
-	/// Clean up memory objects.
+	/// Release the persistent parsing objects. They are not freed here and are reused
+	/// by the next call. The objects of an open codec belong to Close().
 H264V2_D_CLEAN_MEM:
-	if (_pHeaderUnsignedVlcDec != NULL)
+	if (!_codecIsOpen)
 	{
-		delete _pHeaderUnsignedVlcDec;
 		_pHeaderUnsignedVlcDec = NULL;
-	}//end if _pHeaderUnsignedVlcDec...
-	if (_pHeaderSignedVlcDec != NULL)
-	{
-		delete _pHeaderSignedVlcDec;
 		_pHeaderSignedVlcDec = NULL;
-	}//end if _pHeaderSignedVlcDec...
-	if (_pBitStreamReader != NULL)
-	{
-		delete _pBitStreamReader;
 		_pBitStreamReader = NULL;
-	}//end if _pBitStreamReader...
+	}//end if !_codecIsOpen...
 
 	return(ret);
 }//end Decode.
 
+/** Create the persistent param set parsing objects.
+These are created on the first call only so that Decode() of param set only
+streams makes no heap allocations after the first call.
+@return	: 1 = success, 0 = failure.
+*/
+int H264v2Codec::CreateParseObjects(void)
+{
+	if (_pParseBitStreamReader == NULL)
+		_pParseBitStreamReader = new BitStreamReaderMSB();
+	if (_pSaveBitStreamReader == NULL)
+		_pSaveBitStreamReader = new BitStreamReaderMSB();
+	if (_pParseUnsignedVlcDec == NULL)
+		_pParseUnsignedVlcDec = new ExpGolombUnsignedVlcDecoder();
+	if (_pParseSignedVlcDec == NULL)
+		_pParseSignedVlcDec = new ExpGolombSignedVlcDecoder();
+
+	if ((_pParseBitStreamReader == NULL) || (_pSaveBitStreamReader == NULL) ||
+		(_pParseUnsignedVlcDec == NULL) || (_pParseSignedVlcDec == NULL))
+	{
+		_errorStr = "[H264Codec::Decode] Cannot instantiate stream reader and vlc objects";
+		return(0);
+	}//end if !_pParseBitStreamReader...
+
+	return(1);
+}//end CreateParseObjects.
+
 int H264v2Codec::Close(void)
 {
 #ifdef H264V2_DUMP_HEADERS
@@ -2512,19 +2990,27 @@ int H264v2Codec::Close(void)
 		delete _Cr;
 	_Cr = NULL;
 
-	if (_RefLum != NULL)
-		delete _RefLum;
+	/// The current ref overlays are aliases into the ring.
+	for (int r = 0; r < H264V2_REF_PICS; r++)
+		for (int c = 0; c < 3; c++)
+		{
+			if (_RefOverlay[r][c] != NULL)
+				delete _RefOverlay[r][c];
+			_RefOverlay[r][c] = NULL;
+			_pRefPlane[r][c] = NULL;
+		}//end for r & c...
 	_RefLum = NULL;
-	if (_RefCb != NULL)
-		delete _RefCb;
 	_RefCb = NULL;
-	if (_RefCr != NULL)
-		delete _RefCr;
 	_RefCr = NULL;
+	_refIndex = 0;
 
-	if (_pLum != NULL)
-		delete[] _pLum;
+	/// The plain buffers belong to the arena that is retained for the next Open().
+	_arenaPos = 0;
 	_pLum = NULL;
+	memset((void *)(&_inPlanes), 0, sizeof(H264V2_PLANES));
+	memset((void *)(&_outPlanes), 0, sizeof(H264V2_PLANES));
+	_viewToken++;
+	_pCropMem = NULL;
 	_pChrU = NULL;
 	_pChrV = NULL;
 	_pRLum = NULL;
@@ -2534,20 +3020,14 @@ int H264v2Codec::Close(void)
 	if (_16x16 != NULL)
 		delete _16x16;
 	_16x16 = NULL;
-	if (_p16x16 != NULL)
-		delete[] _p16x16;
 	_p16x16 = NULL;
 	if (_8x8_0 != NULL)
 		delete _8x8_0;
 	_8x8_0 = NULL;
-	if (_p8x8_0 != NULL)
-		delete[] _p8x8_0;
 	_p8x8_0 = NULL;
 	if (_8x8_1 != NULL)
 		delete _8x8_1;
 	_8x8_1 = NULL;
-	if (_p8x8_1 != NULL)
-		delete[] _p8x8_1;
 	_p8x8_1 = NULL;
 
 	if (_mbImg != NULL)
@@ -2663,18 +3143,26 @@ int H264v2Codec::Close(void)
 	if (_pCAVLC2x2 != NULL)
 		delete _pCAVLC2x2;
 	_pCAVLC2x2 = NULL;
+	if (_pBlkScan != NULL)
+		delete _pBlkScan;
+	_pBlkScan = NULL;
+	if (_pCAVLCDec != NULL)
+		delete _pCAVLCDec;
+	_pCAVLCDec = NULL;
 
 	/// Macroblock data objects.
 	if (_pMb != NULL)
-		delete[] _pMb;
+	{
+		for (int i = 0; i < _mbLength; i++)
+			_pMb[i].~MacroBlockH264();
+	}//end if _pMb...
 	_pMb = NULL;
-	if (_Mb != NULL)
-		delete[] _Mb;
 	_Mb = NULL;
-
-	if (_autoIFrameIncluded != NULL)
-		delete[] _autoIFrameIncluded;
 	_autoIFrameIncluded = NULL;
+	_mbRecoded = NULL;
+	_pMbDistortion = NULL;
+	_pMbRate = NULL;
+	_pMbSkip = NULL;
 
 	/// Stream access.
 	if (_pBitStreamWriter != NULL)
@@ -2685,19 +3173,21 @@ int H264v2Codec::Close(void)
 		delete _pBitStreamReader;
 	_pBitStreamReader = NULL;
 
-	/// Motion estimator and compensators.
-	if (_pMotionEstimator != NULL)
-		delete _pMotionEstimator;
+	/// Motion estimators.
+	for (int r = 0; r < H264V2_REF_PICS; r++)
+	{
+		if (_pRefMotionEstimator[r] != NULL)
+			delete _pRefMotionEstimator[r];
+		_pRefMotionEstimator[r] = NULL;
+	}//end for r...
 	_pMotionEstimator = NULL;
+	_motionEstimatorBytes = 0;
 
 	/// Motion compensation vectors.
 	if (_pMotionVectors != NULL)
 		delete _pMotionVectors;
 	_pMotionVectors = NULL;
 
-	if (_pMotionCompensator != NULL)
-		delete _pMotionCompensator;
-	_pMotionCompensator = NULL;
 
 	if (_pMotionPredictor != NULL)
 		delete _pMotionPredictor;
@@ -2711,6 +3201,7 @@ int H264v2Codec::Close(void)
 	if (_pInterImgPlaneEncoder != NULL)
 		delete _pInterImgPlaneEncoder;
 	_pInterImgPlaneEncoder = NULL;
+	_planeEncoderBytes = 0;
 
 	if (_pIntraImgPlaneDecoder != NULL)
 		delete _pIntraImgPlaneDecoder;
@@ -2735,8 +3226,6 @@ int H264v2Codec::Close(void)
 	}//end if _pRateCntlIFrames...
 
   /// Region of Interest encoding.
-  if (_roiMultiplier != NULL)
-    delete[] _roiMultiplier;
   _roiMultiplier = NULL;
 
 	_codecIsOpen = 0;
@@ -2745,17 +3234,41 @@ int H264v2Codec::Close(void)
 
 void H264v2Codec::Restart(void)
 {
+	_viewToken++;	///< Invalidate decoded picture views.
 	_pictureCodingType = H264V2_INTRA;
 	_frameNum = 0;				///< Reset the frame counter.
   /// _idrFrameNum does not require reseting.
 
-  /// Zero the reference image. Note that the colour components are 
-	/// held in contiguous mem.
-	int imgSize = (_lumWidth * _lumHeight) + 2 * (_chrWidth * _chrHeight);
-	memset(_pRLum, 0, imgSize * sizeof(short));
+	/// Return to ring picture 0. The other ring pictures are fully overwritten before
+	/// they are read.
+	SelectReference(0);
+
+  /// Zero the reference image. Note that the colour components and their 
+	/// edge extension borders are held in contiguous mem.
+	if (_pRLum != NULL)
+	{
+		int refSize = ((_lumHeight + 2 * H264V2_REF_BORDER) * _lumWidth) + 2 * ((_chrHeight + H264V2_REF_BORDER) * _chrWidth);
+		memset(&(_pRLum[-(H264V2_REF_BORDER * _lumWidth)]), 0, refSize * sizeof(short));
+	}//end if _pRLum...
 
 }//end Restart.
 
+/** Reset all stream state of an open codec for reuse with a new stream.
+In addition to Restart() the rate controller histories and the frame
+coding history are cleared such that the codec behaves as if it was
+freshly opened with the same parameters.
+@return	: none.
+*/
+void H264v2Codec::ResetStream(void)
+{
+	_lastPicCodingType = H264V2_INTRA;
+	_prevMotionDistortion = -1;
+	_idrFrameNum = 0;
+	if ((_pRateCntlPFrames != NULL) && (_pRateCntlIFrames != NULL))
+		CreateRateControllers();
+	Restart();
+}//end ResetStream.
+
 /*
 -----------------------------------------------------------------------
   Private Implementation.
@@ -2952,18 +3465,25 @@ int H264v2Codec::SetSeqParamSet(int index)
 	_seqParam[index]._frame_mbs_only_flag = 1;							///< = 1 (baseline profile). fields/frames = 0/1.
 	_seqParam[index]._mb_adaptive_frame_field_flag = 0;							///< Indicates switching between frame and field macroblocks. When not present = 0.
 	_seqParam[index]._direct_8x8_inference_flag = 0;							///< Methods for B-Slice motion vector decoding. There are no B-Slices in the baseline profile.
-	_seqParam[index]._frame_cropping_flag = 0;							///< Indicates that the cropping params below follow in the stream.
-	_seqParam[index]._frame_crop_left_offset = 0;							///< In frame coordinate units.
-	_seqParam[index]._frame_crop_right_offset = 0;							///< In frame coordinate units.
-	_seqParam[index]._frame_crop_top_offset = 0;							///< In frame coordinate units.
-	_seqParam[index]._frame_crop_bottom_offset = 0;							///< In frame coordinate units.
 	_seqParam[index]._vui_parameters_present_flag = 0;							///< vui parameters follow.
 
-	if ((_width < 16) || (_height < 16))
+	if ((_width < 16) || (_height < 16) || (_width % 2) || (_height % 2))
 		return(0);
 
-	_seqParam[index]._pic_width_in_mbs_minus1 = (_width / 16) - 1;	///< Width of decoded pic in units of macroblocks. Derive lum and chr pic width from this variable.
-	_seqParam[index]._pic_height_in_map_units_minus1 = (_height / 16) - 1;	///< Map units are 2 macroblocks for fields and 1 for frames. Derive lum and chr pic height from this variable.
+	int mbWidth = (_width + 15) / 16;
+	int mbHeight = (_height + 15) / 16;
+	_seqParam[index]._pic_width_in_mbs_minus1 = mbWidth - 1;	///< Width of decoded pic in units of macroblocks. Derive lum and chr pic width from this variable.
+	_seqParam[index]._pic_height_in_map_units_minus1 = mbHeight - 1;	///< Map units are 2 macroblocks for fields and 1 for frames. Derive lum and chr pic height from this variable.
+
+	/// Non mod 16 pictures are coded with the extra pels on the right and bottom. The crop units
+	/// are 2 pels for 4:2:0 frames.
+	_seqParam[index]._frame_crop_left_offset = 0;							///< In frame coordinate units.
+	_seqParam[index]._frame_crop_right_offset = ((mbWidth * 16) - _width) / 2;	///< In frame coordinate units.
+	_seqParam[index]._frame_crop_top_offset = 0;							///< In frame coordinate units.
+	_seqParam[index]._frame_crop_bottom_offset = ((mbHeight * 16) - _height) / 2;	///< In frame coordinate units.
+	_seqParam[index]._frame_cropping_flag = 0;							///< Indicates that the cropping params below follow in the stream.
+	if (_seqParam[index]._frame_crop_right_offset || _seqParam[index]._frame_crop_bottom_offset)
+		_seqParam[index]._frame_cropping_flag = 1;
 
 	return(1);
 }//end SetSeqParamSet.
@@ -3973,7 +4493,7 @@ int H264v2Codec::SetPicParamSet(int index, int seqRef)
 	_picParam[index]._pic_scaling_matrix_present_flag = 0;			///< = 0. Indicates params are present to modify the scaling lists specified in the seq param sets.
 	/// Not initialised:_pic_scaling_list_present_flag[8];			///< Scaling list syntax structure present for scaling list i = 0..7.
 
-	_picParam[index]._pic_size_in_map_units_minus1 = ((_width / 16)*(_height / 16)) - 1;	///< Num of map units (macroblocks for frames) in the pic. Macroblock width * height.
+	_picParam[index]._pic_size_in_map_units_minus1 = (((_width + 15) / 16)*((_height + 15) / 16)) - 1;	///< Num of map units (macroblocks for frames) in the pic. Macroblock width * height.
 
 	return(1);
 }//end SetPicParamSet.
@@ -4396,9 +4916,28 @@ int H264v2Codec::GetCodecParams(int picParamSet)
 	_currSeqParam = seqParamSet;
 
 	///----------- Extract params of interest for codec -----------------------
-	/// Get width and height in pels.
+	/// Get the visible width and height in pels within the coded picture. Crop units are 2 pels
+	/// for 4:2:0 frames and cropping is limited to within the last macroblock on each edge.
+	_cropX = 0;
+	_cropY = 0;
 	_width = (_seqParam[seqParamSet]._pic_width_in_mbs_minus1 + 1) * 16;
 	_height = (_seqParam[seqParamSet]._pic_height_in_map_units_minus1 + 1) * 16;
+	if (_seqParam[seqParamSet]._frame_cropping_flag)
+	{
+		int cropL = 2 * _seqParam[seqParamSet]._frame_crop_left_offset;
+		int cropR = 2 * _seqParam[seqParamSet]._frame_crop_right_offset;
+		int cropT = 2 * _seqParam[seqParamSet]._frame_crop_top_offset;
+		int cropB = 2 * _seqParam[seqParamSet]._frame_crop_bottom_offset;
+		if ((cropL >= 16) || (cropR >= 16) || (cropT >= 16) || (cropB >= 16) || ((cropL + cropR) >= _width) || ((cropT + cropB) >= _height))
+		{
+			_errorStr = "[H264Codec::GetCodecParams] Frame cropping not implemented";
+			return(0);
+		}//end if cropL...
+		_cropX = cropL;
+		_cropY = cropT;
+		_width -= (cropL + cropR);
+		_height -= (cropT + cropB);
+	}//end if _frame_cropping_flag...
 	_seqParamSetLog2MaxFrameNumMinus4 = _seqParam[seqParamSet]._log2_max_frame_num_minus4;
 
 	///----------- Check params for this implementation -----------------------
@@ -4421,7 +4960,6 @@ int H264v2Codec::GetCodecParams(int picParamSet)
 		(_seqParam[seqParamSet]._frame_mbs_only_flag != 1) ||
 		(_seqParam[seqParamSet]._mb_adaptive_frame_field_flag != 0) ||
 		(_seqParam[seqParamSet]._direct_8x8_inference_flag != 0) ||
-		(_seqParam[seqParamSet]._frame_cropping_flag != 0) ||
 		(_seqParam[seqParamSet]._vui_parameters_present_flag != 0))
 	{
 		_errorStr = "[H264Codec::GetCodecParams] Sequence parameters not implemented";
@@ -4448,37 +4986,383 @@ int H264v2Codec::GetCodecParams(int picParamSet)
 	return(1);
 }//end GetCodecParams.
 
-/** Write the NAL header to a bit stream.
-The NAL header data must be correctly defined before this method is called. The
-vlc encoding is performed first before writing. Each write checks if a bit overflow
-will occur before writing. The check is sufficiently frequent to warrant an early
-exit GOTO statement. If the input stream param is NULL then this method is used
-to count the bits only.
-@param bsw					: Stream to write into.
-@param allowedBits	: Upper limit to the writable bits.
-@param bitsUsed			: Return the actual bits used.
-@return							: Run out of bits = 1, more bits available = 0, Vlc error = 2.
+/** Create the motion estimation and compensation objects of the encoder.
+The estimator type is selected by the "motion estimation type" parameter and an
+estimator is bound to the input picture and to each reference ring picture. Called
+from Open() after the macroblocks are created.
+@return	: 1 = success, 0 = failed.
 */
-int H264v2Codec::WriteNALHeader(IBitStreamWriter* bsw, int allowedBits, int* bitsUsed)
+int H264v2Codec::CreateMotionObjects(void)
 {
-	/// The NAL header is a fixed 8 bit sequence.
-	if (allowedBits >= 8)
+	  /// --------------- Configure motion estimators -----------------------------------
+
+	/// Create a motion vector predictor for the motion estimator to use in biasing towards
+	/// the predicted vector when distortion choise is ambiguous.
+	_pMotionPredictor = new H264MotionVectorPredictorImpl1(_pMb);
+	if (!_pMotionPredictor)
 	{
-		if (bsw)
-		{
-			bsw->Write(1, 0);												///< Forbidden zero bit f(1).
-			bsw->Write(2, (_nal._ref_idc & 3));			///< u(2).		
-			bsw->Write(5, (_nal._unit_type & 31));	///< u(5).		
-		}//end if bsw != NULL...
-	}//end if allowedBits...
+		_errorStr = "[H264Codec::CreateMotionObjects] Cannot create motion vector predictor object";
+		return(0);
+	}//end if !_pMotionPredictor...
+
+	  /// Select an appropriate motion estimator.
+	int motionVectorRange;	///< In 1/4 pel units.
+	if ((_width <= 1408) && (_height <= 1152))
+		motionVectorRange = 512;	///< 512/4 = [-128.00 ... 127.75], 192/4 = [-48.00 ... 47.75]
 	else
-	{
-		_errorStr = "H264V2:[WriteNALHeader] Bits required exceeds max available for NAL header";
-		*bitsUsed = 0;
-		return(1);
-	}///end else...
+		motionVectorRange = 1024;	///< 1024/4 =[-256.00 ... 255.75], 256/4 =[-64.00 ... 63.75]
 
-	*bitsUsed = 8;
+	/// One estimator is bound to each ring picture and the estimator of the current 
+	/// reference is selected with it in SelectReference().
+	//_motionFactor = 2;	///< Abs diff algorithm.
+	_motionFactor = 4;	///< Sqr err algorithm.
+	for (int r = 0; r < H264V2_REF_PICS; r++)
+	{
+		_pRefMotionEstimator[r] = CreateMotionEstimator((const void *)_pRefPlane[r][0], motionVectorRange);
+		if (_pRefMotionEstimator[r] == NULL)
+		{
+			_errorStr = "[H264Codec::CreateMotionObjects] Cannot instantiate motion estimator object";
+			return(0);
+		}//end if !_pRefMotionEstimator...
+		if (!_pRefMotionEstimator[r]->Create())
+		{
+			_errorStr = "[H264Codec::CreateMotionObjects] Cannot create motion estimator";
+			return(0);
+		}//end if !Create...
+	}//end for r...
+	_pMotionEstimator = _pRefMotionEstimator[_refIndex];
+
+	  /// Create a motion vector list to hold the decoded vectors for the compensation process.
+	_pMotionVectors = new VectorStructList(VectorStructList::SIMPLE2D);
+	if (!_pMotionVectors)
+	{
+		_errorStr = "[H264Codec::CreateMotionObjects] Cannot create motion vector list object";
+		return(0);
+	}//end if !_pMotionVectors...
+	if (!_pMotionVectors->SetLength(_mbLength)) ///< One per Mb for 16x16 vectors only.
+	{
+		_errorStr = "[H264Codec::CreateMotionObjects] Insufficient mem for motion vector list";
+		return(0);
+	}//end if !SetLength...
+
+	return(1);
+}//end CreateMotionObjects.
+
+/** Instantiate the motion estimator selected by the "motion estimation type" parameter.
+The estimator is bound to the input picture and to the given reference picture.
+@param pRef								: Lum plane of the reference ring picture.
+@param motionVectorRange	: Vector range in 1/4 pel units.
+@return										: Estimator, NULL if it cannot be instantiated.
+*/
+IMotionEstimator* H264v2Codec::CreateMotionEstimator(const void* pRef, int motionVectorRange)
+{
+	IMotionEstimator* pME = NULL;
+
+  switch (_motionEstimationType)
+  {
+    case H264V2_MOTION_FULL:
+      {
+        /// Slowest full accurate estimator.
+        pME = new MotionEstimatorH264ImplFull( (const void *)_pLum,
+        																										 pRef,
+        																										 _lumWidth,
+        																										 _lumHeight,
+        																										 motionVectorRange, ///< In 1/4 pel units.
+                                                             _pMotionPredictor,
+        																										 _autoIFrameIncluded);
+        /// Implementation specific modes.
+        if(pME != NULL)
+          pME->SetMode(0);	///< Auto mode.
+        _motionEstimatorBytes = sizeof(MotionEstimatorH264ImplFull);
+      }//end block...
+      break;
+    case H264V2_MOTION_FULL_MULTIRES:
+      {
+        /// Slow more accurate multiresolution estimator.
+        pME = new MotionEstimatorH264ImplMultires((const void *)_pLum,	///< Multi res estimation.
+        																												pRef,
+        																												_lumWidth,
+        																												_lumHeight,
+        																												motionVectorRange, ///< In 1/4 pel units
+                                                                _pMotionPredictor,
+                                                                _autoIFrameIncluded);
+        /// Implementation specific modes.
+        if (pME != NULL)
+          pME->SetMode(0);	///< mode 0 = 1/4 pel, mode 1 = 1/2 pel, mode 2 = full pel.
+        _motionEstimatorBytes = sizeof(MotionEstimatorH264ImplMultires);
+      }//end block...
+      break;
+    case H264V2_MOTION_UMHS_PARTIAL:
+      {
+        /// Cross search algorithm with partial sums as defined in the std reference implementations of H264
+        pME = new MotionEstimatorH264ImplUMHS((const void *)_pLum,
+                                                            pRef,
+                                                            _lumWidth,
+                                                            _lumHeight,
+                                                            motionVectorRange, ///< In 1/4 pel units.
+                                                            _pMotionPredictor,
+                                                            _autoIFrameIncluded,
+                                                            _pMb);
+        /// Implementation specific modes.
+        if (pME != NULL)
+          pME->SetMode(_motionResolution);	///< Estimation pel resolution: 0=1/4 pel, 1=1/2 pel, 2=full pel.
+        _motionEstimatorBytes = sizeof(MotionEstimatorH264ImplUMHS);
+      }///end block...
+      break;
+    case H264V2_MOTION_FHS_PARTIAL:
+    {
+      /// Fasthegagon sequencing search algorithm with partial sums
+      pME = new MotionEstimatorH264ImplFHS((const void *)_pLum,
+                                                         pRef,
+                                                          _lumWidth,
+                                                          _lumHeight,
+                                                          motionVectorRange, ///< In 1/4 pel units.
+                                                          _pMotionPredictor,
+                                                          _autoIFrameIncluded,
+                                                          _pMb);
+      /// Implementation specific modes.
+      if (pME != NULL)
+        pME->SetMode(_motionResolution);	///< Estimation pel resolution: 0=1/4 pel, 1=1/2 pel, 2=full pel.
+      _motionEstimatorBytes = sizeof(MotionEstimatorH264ImplFHS);
+    }///end block...
+    break;
+    case H264V2_MOTION_CROSS_PARTIAL:
+    default:  /// H264V2_MOTION_CROSS_PARTIAL
+      {
+        /// Cross search algorithm with partial sums as defined in the std reference implementations of H264
+        pME = new MotionEstimatorH264ImplCross( (const void *)_pLum,
+                                                              pRef,
+                                                              _lumWidth,
+                                                              _lumHeight,
+                                                              motionVectorRange, ///< In 1/4 pel units.
+                                                              _pMotionPredictor,
+                                                              _autoIFrameIncluded);
+        /// Implementation specific modes.
+        if (pME != NULL)
+          pME->SetMode(_motionResolution);	///< Estimation pel resolution: 0=1/4 pel, 1=1/2 pel, 2=full pel.
+        _motionEstimatorBytes = sizeof(MotionEstimatorH264ImplCross);
+      }///end block...
+      break;
+  }///end switch _motionEstimationType...
+
+  /// Fast less accurate estimator.
+	//pME = new MotionEstimatorH264ImplMultiresCrossVer2( (const void *)_pLum,	///< Multi res estimation.
+	//	                                                                pRef,
+	//	                                                                _lumWidth,
+	//	                                                                _lumHeight,
+	//	                                                                motionVectorRange, ///< In 1/4 pel units.
+	//	                                                                _pMotionPredictor,
+	//	                                                                _autoIFrameIncluded);
+
+	//	pME = new MotionEstimatorH264ImplMultiresCross(	(const void *)_pLum,	///< Multi res estimation.
+	//																																pRef,
+	//																																_lumWidth,
+	//																																_lumHeight,
+	//																																motionVectorRange, ///< In 1/4 pel units.
+	//																																_autoIFrameIncluded);
+
+
+
+		/// Test motion estimator for collecting data. Full pel only full search based estimation.
+	//	pME = new MotionEstimatorH264ImplTest(	(const void *)_pLum,	///< Multi res estimation.
+	//																												pRef,
+	//																												_lumWidth,
+	//																												_lumHeight,
+	//																												motionVectorRange, ///< In 1/4 pel units.
+	//                                                        _pMotionPredictor,
+	//																												_autoIFrameIncluded);
+
+	return(pME);
+}//end CreateMotionEstimator.
+
+/** Fill the memory usage member with estimates from the current open state.
+Only the objects and buffers that Open() actually created are counted. Vpp library
+objects are counted at their class size only and their internal buffers are not
+visible here.
+@return	: none.
+*/
+void H264v2Codec::UpdateMemoryUsage(void)
+{
+	H264V2_MEMORY_USAGE* pU = &_memUsage;
+	memset((void *)pU, 0, sizeof(H264V2_MEMORY_USAGE));
+
+	pU->instance = sizeof(H264v2Codec);
+	pU->paramSets = sizeof(_seqParam) + sizeof(_picParam);
+	pU->arena = _arenaSize;
+
+	if (_codecIsOpen)
+	{
+		int lumSize = _lumWidth * _lumHeight;
+		int chrSize = _chrWidth * _chrHeight;
+		int refPicSize = (lumSize + (2 * H264V2_REF_BORDER * _lumWidth)) + 2 * (chrSize + (H264V2_REF_BORDER * _chrWidth));
+		pU->pictures = H264V2_REF_PICS * refPicSize * sizeof(short);
+		if (_pLum != NULL)	///< No input picture for decoding only.
+			pU->pictures += (lumSize + 2 * chrSize) * sizeof(short);
+		if (_pCropMem != NULL)
+			pU->pictures += ((_width * _height) + 2 * ((_width / 2) * (_height / 2))) * sizeof(short);
+		if (_pMbDistortion != NULL)
+			pU->rdTables = (2 * H264V2_RD_QP_LEN * _mbLength * sizeof(int)) + (_mbLength * sizeof(unsigned char));
+		if (_pMb != NULL)
+			pU->macroblocks = _mbLength * sizeof(MacroBlockH264);
+
+		/// Transforms, vlc codecs and bit stream access. The encoder objects are absent for decoding only.
+		if (_pF4x4TLum != NULL)
+			pU->coding += 2 * sizeof(FastForward4x4ITImpl2) + sizeof(FastForwardDC4x4ITImpl1) + sizeof(FastForwardDC2x2ITImpl1);
+		if (_pI4x4TLum != NULL)
+			pU->coding += 2 * sizeof(FastInverse4x4ITImpl1) + sizeof(FastInverseDC4x4ITImpl1) + sizeof(FastInverseDC2x2ITImpl1);
+		if (_pPrefixVlcEnc != NULL)
+			pU->coding += sizeof(PrefixH264VlcEncoderImpl1) + sizeof(CoeffTokenH264VlcEncoder) + sizeof(TotalZeros4x4H264VlcEncoder) +
+										sizeof(TotalZeros2x2H264VlcEncoder) + sizeof(RunBeforeH264VlcEncoder) + sizeof(CodedBlkPatternH264VlcEncoder) +
+										sizeof(ExpGolombSignedVlcEncoder) + sizeof(ExpGolombUnsignedVlcEncoder);
+		if (_pPrefixVlcDec != NULL)
+			pU->coding += sizeof(PrefixH264VlcDecoderImpl1) + sizeof(CoeffTokenH264VlcDecoder) + sizeof(TotalZeros4x4H264VlcDecoder) +
+										sizeof(TotalZeros2x2H264VlcDecoder) + sizeof(RunBeforeH264VlcDecoder) + sizeof(CodedBlkPatternH264VlcDecoder) +
+										sizeof(ExpGolombSignedVlcDecoder) + sizeof(ExpGolombUnsignedVlcDecoder);
+		if (_pCAVLC4x4 != NULL)
+			pU->coding += 2 * sizeof(CAVLCH264Impl);
+		if (_pBlkScan != NULL)
+			pU->coding += sizeof(CAVLCH264BlkScan);
+		if (_pCAVLCDec != NULL)
+			pU->coding += sizeof(CAVLCH264TableDecoder);
+		if (_mbImg != NULL)
+			pU->coding += sizeof(H264MbImgCache);
+		if (_pBitStreamWriter != NULL)
+			pU->coding += sizeof(BitStreamWriterMSB);
+		if (_pBitStreamReader != NULL)
+			pU->coding += sizeof(BitStreamReaderMSB);
+#ifdef _CCIR601
+		if (_pInColourConverter != NULL)
+			pU->coding += sizeof(RealRGB24toYUV420CCIR601ConverterVer16);
+		if (_pOutColourConverter != NULL)
+			pU->coding += sizeof(RealYUV420toRGB24CCIR601ConverterVer16);
+#else
+		if (_pInColourConverter != NULL)
+			pU->coding += sizeof(RealRGB24toYUV420ConverterImpl2Ver16);
+		if (_pOutColourConverter != NULL)
+			pU->coding += sizeof(RealYUV420toRGB24ConverterImpl2Ver16);
+#endif
+
+		/// The estimator size was recorded when the ring estimators were created.
+		for (int r = 0; r < H264V2_REF_PICS; r++)
+		{
+			if (_pRefMotionEstimator[r] != NULL)
+				pU->motion += _motionEstimatorBytes;
+		}//end for r...
+		if (_pMotionPredictor != NULL)
+			pU->motion += sizeof(H264MotionVectorPredictorImpl1);
+		if (_pMotionVectors != NULL)
+			pU->motion += sizeof(VectorStructList);
+
+		/// The plane encoder and rate controller sizes were recorded when Open() created them.
+		if (_pIntraImgPlaneDecoder != NULL)
+			pU->planeCoders += sizeof(IntraImgPlaneDecoderImplStdVer1);
+		if (_pInterImgPlaneDecoder != NULL)
+			pU->planeCoders += sizeof(InterImgPlaneDecoderImplStdVer1);
+		if (_pIntraImgPlaneEncoder != NULL)
+			pU->planeCoders += _planeEncoderBytes;
+	}//end if _codecIsOpen...
+
+	/// The pictures, rd tables and macroblocks are placed within the arena.
+	pU->total = pU->instance + pU->arena + pU->coding + pU->motion + pU->planeCoders;
+}//end UpdateMemoryUsage.
+
+/** Create the rate controller buffers and set their model limits.
+The rate controllers must be instantiated before calling this method. Calling
+it again discards the rate controller history.
+@return	: 1 = success, 0 = failure.
+*/
+int H264v2Codec::CreateRateControllers(void)
+{
+	if ((!_pRateCntlPFrames->Create(_numRateCntlFrames)) || (!_pRateCntlIFrames->Create(_numRateCntlFrames)))
+		return(0);
+
+	switch (_rateControlModelType)
+	{
+	case H264V2_RATE_CONTROL_MODEL_QUAD:
+		_pRateCntlIFrames->SetRDLimits(24.0, 0.0001, 4000000.0, 32.0);  ///< Quad Abs Diff limits.
+		_pRateCntlPFrames->SetRDLimits(24.0, 0.0001, 4000000.0, 32.0);
+		break;
+	case H264V2_RATE_CONTROL_MODEL_POW:
+	case H264V2_RATE_CONTROL_MODEL_LOG:
+	/*case H264V2_RATE_CONTROL_MODEL_MULTI:*/
+		_pRateCntlIFrames->SetRDLimits(24.0, 0.0001, 67108864.0, 256.0);  ///< Multi-model Sqr Diff limits
+		_pRateCntlPFrames->SetRDLimits(24.0, 0.0001, 67108864.0, 256.0);
+		break;
+	}//end switch _rateControlModelType...
+
+	return(1);
+}//end CreateRateControllers.
+
+/** Apply the current param sets to an open codec without reallocation.
+Only state that is derived from the param sets outside of the slice decoding
+is re-derived. The slice layer reads the QP init and deblocking control directly
+from the current pic param set. The cached encoded param sets that Code() prepends
+to I-pictures are generated by the encoder in Open() and are not touched. If the
+picture geometry differs or the param sets are not valid for this implementation
+then nothing is applied and Open() must be called.
+@return	: 1 = applied in place, 0 = Open() required.
+*/
+int H264v2Codec::ReconfigureInPlace(void)
+{
+	int width = _width;
+	int height = _height;
+	int cropX = _cropX;
+	int cropY = _cropY;
+	int log2MaxFrameNumMinus4 = _seqParamSetLog2MaxFrameNumMinus4;
+
+	if (!_codecIsOpen)
+		return(0);
+
+	if (!GetCodecParams(_currPicParam) ||
+		(width != _width) || (height != _height) || (cropX != _cropX) || (cropY != _cropY))
+	{
+		/// Restore the open geometry for the Open() that follows.
+		_width = width;
+		_height = height;
+		_cropX = cropX;
+		_cropY = cropY;
+		_seqParamSetLog2MaxFrameNumMinus4 = log2MaxFrameNumMinus4;
+		return(0);
+	}//end if !GetCodecParams...
+
+	/// Frame num modulus.
+	_maxFrameNum = 1 << (_seqParam[_currSeqParam]._log2_max_frame_num_minus4 + 4);
+	_frameNum = _frameNum % _maxFrameNum;
+
+	return(1);
+}//end ReconfigureInPlace.
+
+/** Write the NAL header to a bit stream.
+The NAL header data must be correctly defined before this method is called. The
+vlc encoding is performed first before writing. Each write checks if a bit overflow
+will occur before writing. The check is sufficiently frequent to warrant an early
+exit GOTO statement. If the input stream param is NULL then this method is used
+to count the bits only.
+@param bsw					: Stream to write into.
+@param allowedBits	: Upper limit to the writable bits.
+@param bitsUsed			: Return the actual bits used.
+@return							: Run out of bits = 1, more bits available = 0, Vlc error = 2.
+*/
+int H264v2Codec::WriteNALHeader(IBitStreamWriter* bsw, int allowedBits, int* bitsUsed)
+{
+	/// The NAL header is a fixed 8 bit sequence.
+	if (allowedBits >= 8)
+	{
+		if (bsw)
+		{
+			bsw->Write(1, 0);												///< Forbidden zero bit f(1).
+			bsw->Write(2, (_nal._ref_idc & 3));			///< u(2).		
+			bsw->Write(5, (_nal._unit_type & 31));	///< u(5).		
+		}//end if bsw != NULL...
+	}//end if allowedBits...
+	else
+	{
+		_errorStr = "H264V2:[WriteNALHeader] Bits required exceeds max available for NAL header";
+		*bitsUsed = 0;
+		return(1);
+	}///end else...
+
+	*bitsUsed = 8;
 	return(0);
 }//end WriteNALHeader.
 
@@ -5665,95 +6549,574 @@ int H264v2Codec::ReadTrailingBits(IBitStreamReader* bsr, int remainingBits, int*
 	return(0);
 }//end ReadTrailingBits.
 
-/** Insert start code emulation prevention codes.
-Scan the entire stream, excluding the 32 bit actual start code, and check
-for 24 bit 0x000000 - 0x000003 sequences. Replace them with 32 bit
-0x00000300 - 0x00000303 sequences. The extra byte (8 bits) for each
-emulation code is excluded from the number of allowed bits but is added
-to the total consumed bits. [NB: Care must be taken when checking for
-running out of bits to allow for these extra codes.] This method should
-only be called once the entire frame has been encoded.
-@param bsw	        : Stream to write into.
+/** Widen 8 bit pels to the internal 16 bit pel type.
+The internal image planes are 16 bit as required by the overlays and motion
+estimators. The widening is done 16 pels at a time with
+SIMD unpacking where available.
+@param pSrc	: 8 bit pels.
+@param pDst	: 16 bit pels.
+@param len	: Number of pels.
+@return			: none.
+*/
+void H264v2Codec::PelsFrom8Bit(const unsigned char* pSrc, short* pDst, int len)
+{
+	int i = 0;
+#ifdef H264V2_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	for (; (i + 16) <= len; i += 16)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i *)(pSrc + i));
+		_mm_storeu_si128((__m128i *)(pDst + i), _mm_unpacklo_epi8(p, zero));
+		_mm_storeu_si128((__m128i *)(pDst + i + 8), _mm_unpackhi_epi8(p, zero));
+	}//end for i...
+#endif
+	for (; i < len; i++)
+		pDst[i] = (short)pSrc[i];
+}//end PelsFrom8Bit.
+
+/** Narrow internal 16 bit pels to 8 bits.
+Values are saturated to the [0..255] range. The narrowing is done 16 pels
+at a time with SIMD packing where available.
+@param pSrc	: 16 bit pels.
+@param pDst	: 8 bit pels.
+@param len	: Number of pels.
+@return			: none.
+*/
+void H264v2Codec::PelsTo8Bit(const short* pSrc, unsigned char* pDst, int len)
+{
+	int i = 0;
+#ifdef H264V2_SSE2
+	for (; (i + 16) <= len; i += 16)
+	{
+		__m128i lo = _mm_loadu_si128((const __m128i *)(pSrc + i));
+		__m128i hi = _mm_loadu_si128((const __m128i *)(pSrc + i + 8));
+		_mm_storeu_si128((__m128i *)(pDst + i), _mm_packus_epi16(lo, hi));
+	}//end for i...
+#endif
+	for (; i < len; i++)
+	{
+		int x = (int)pSrc[i];
+		pDst[i] = (unsigned char)H264V2_CLIP255(x);
+	}//end for i...
+}//end PelsTo8Bit.
+
+/** Find the next zero byte pair in a stream.
+Locate the lowest pos in [from, last] where both stream[pos] and stream[pos+1]
+are zero. The bytes are tested 32 at a time with SIMD compares where available
+and only the tail is tested byte by byte. Note that stream[last+1] is read.
+@param stream	: Stream to scan.
+@param from		: First pos to test.
+@param last		: Last pos to test.
+@return				: Pos of the 1st zero byte of the pair, -1 if none found.
+*/
+int H264v2Codec::FindZeroBytePair(const unsigned char* stream, int from, int last)
+{
+	int pos = from;
+
+#ifdef H264V2_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	for (; (pos + 31) <= last; pos += 32)
+	{
+		/// A byte and its successor are both zero when their OR is zero.
+		__m128i lo = _mm_or_si128(_mm_loadu_si128((const __m128i *)(stream + pos)), _mm_loadu_si128((const __m128i *)(stream + pos + 1)));
+		__m128i hi = _mm_or_si128(_mm_loadu_si128((const __m128i *)(stream + pos + 16)), _mm_loadu_si128((const __m128i *)(stream + pos + 17)));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(lo, zero)) | ((unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(hi, zero)) << 16);
+		if (mask)
+		{
+#if defined(_MSC_VER)
+			unsigned long bit;
+			_BitScanForward(&bit, (unsigned long)mask);
+			return(pos + (int)bit);
+#else
+			return(pos + __builtin_ctz(mask));
+#endif
+		}//end if mask...
+	}//end for pos...
+#else
+	/// Test 4 byte words for any zero byte before looking closer.
+	while (((pos + 3) <= last) && stream[pos + 1] && stream[pos + 3])	///< Every pair in the word needs one of these bytes to be zero.
+		pos += 4;
+#endif
+
+	for (; pos <= last; pos++)
+	{
+		if ((stream[pos] == 0) && (stream[pos + 1] == 0))
+			return(pos);
+	}//end for pos...
+
+	return(-1);
+}//end FindZeroBytePair.
+
+/** Find the next 0x000001 start code prefix in a stream.
+The zero byte pairs are found with the block scan of FindZeroBytePair(). A 4
+byte start code is found at its 2nd zero byte.
+@param stream		: Stream to search.
+@param from			: First byte pos to test.
+@param endByte	: Byte length of the stream.
+@return					: Byte pos of the prefix, -1 if not found.
+*/
+int H264v2Codec::FindStartCodePrefix(const unsigned char* stream, int from, int endByte)
+{
+	int pos = from;
+	while (pos <= (endByte - 3))
+	{
+		int pair = FindZeroBytePair(stream, pos, endByte - 3);
+		if (pair < 0)
+			break;
+		if (stream[pair + 2] == 1)
+			return(pair);
+		pos = pair + 1;
+	}//end while pos...
+
+	return(-1);
+}//end FindStartCodePrefix.
+
+/** Find the rbsp stop bit of a NAL unit.
+The stop bit is the last 1 bit of the NAL unit and any trailing zero bytes
+are passed over. The slice data of a slice NAL unit ends at this bit.
+@param stream		: Unescaped NAL unit.
+@param endByte	: Byte length of the stream.
+@return					: Bit pos of the stop bit, -1 if there is none.
+*/
+int H264v2Codec::RbspStopBitPos(const unsigned char* stream, int endByte)
+{
+	for (int i = endByte - 1; i >= 0; i--)
+	{
+		if (stream[i])
+		{
+			int bit = 7;
+			for (unsigned char b = stream[i]; !(b & 1); b >>= 1)
+				bit--;
+			return((i * 8) + bit);
+		}//end if stream...
+	}//end for i...
+
+	return(-1);
+}//end RbspStopBitPos.
+
+/** Add a NAL unit to the table of the access unit being coded.
+The start code and the length prefix are both 4 bytes so the NAL header
+offset is the same for either output form.
+@param startByte	: Stream byte offset of the NAL unit start code.
+@param type				: NAL unit type.
+@return						: 1 = success, 0 = the table is full.
+*/
+int H264v2Codec::AddNalUnit(int startByte, int type)
+{
+	if (_numNalUnits >= H264V2_MAX_NAL_UNITS)
+	{
+		_errorStr = "[H264Codec::AddNalUnit] Too many NAL units in the access unit";
+		return(0);
+	}//end if _numNalUnits...
+	_nalUnit[_numNalUnits].offset = startByte + 4;
+	_nalUnit[_numNalUnits].size = 0;
+	_nalUnit[_numNalUnits].type = type;
+	_numNalUnits++;
+	return(1);
+}//end AddNalUnit.
+
+/** Complete the NAL unit table of a coded access unit.
+Each NAL unit extends to the start code of the next and the last to the
+end of the stream. In length prefix mode the 0x00000001 start codes are
+overwritten with the big endian NAL unit byte sizes.
+@param stream		: Coded access unit.
+@param endByte	: Byte length of the coded access unit.
+@return					: none.
+*/
+void H264v2Codec::EndNalUnits(unsigned char* stream, int endByte)
+{
+	for (int i = 0; i < _numNalUnits; i++)
+	{
+		int end = endByte;
+		if ((i + 1) < _numNalUnits)
+			end = _nalUnit[i + 1].offset - 4;
+		int size = end - _nalUnit[i].offset;
+		_nalUnit[i].size = size;
+
+		if (_nalLengthPrefix)
+		{
+			unsigned char* prefix = &(stream[_nalUnit[i].offset - 4]);
+			prefix[0] = (unsigned char)(size >> 24);
+			prefix[1] = (unsigned char)(size >> 16);
+			prefix[2] = (unsigned char)(size >> 8);
+			prefix[3] = (unsigned char)size;
+		}//end if _nalLengthPrefix...
+	}//end for i...
+}//end EndNalUnits.
+
+/** Count the start code emulation prevention bytes required by a stream.
+Every 0x000000 - 0x000003 sequence in the stream requires one inserted byte and
+the count is the escaped size increase in bytes. The same candidate positions as
+InsertEmulationPrevention() are tested so that the escaped size is known before
+the stream is modified.
+@param stream	: Stream to evaluate.
+@param first	: First pos that may be escaped (>= 2).
+@param endPos	: Last byte pos in the stream.
+@return				: Number of bytes to insert.
+*/
+int H264v2Codec::EmulationPreventionBytes(const unsigned char* stream, int first, int endPos)
+{
+	int count = 0;
+	int pos = first;
+	while (pos <= endPos)
+	{
+		int pair = FindZeroBytePair(stream, pos - 2, endPos - 2);
+		if (pair < 0)
+			break;
+		pos = pair + 2;
+
+		if ((stream[pos] & 0xFC) == 0) ///< Check for 0, 1, 2 or 3.
+		{
+			count++;
+			pos += 2;	///< The inserted 0x03 breaks the zero run at this pos.
+		}//end if stream...
+		else
+			pos++;
+	}//end while pos...
+
+	return(count);
+}//end EmulationPreventionBytes.
+
+/** Get the scratch stream memory.
+The scratch is held over calls and only grows.
+@param bytes	: Required byte length.
+@return				: Scratch memory, NULL if unavailable.
+*/
+unsigned char* H264v2Codec::StreamScratch(int bytes)
+{
+	if (bytes > _streamScratchLen)
+	{
+		if (_pStreamScratch != NULL)
+			delete[] _pStreamScratch;
+		_streamScratchLen = 0;
+		_pStreamScratch = new unsigned char[bytes];
+		if (_pStreamScratch == NULL)
+			return(NULL);
+		_streamScratchLen = bytes;
+	}//end if bytes...
+	return(_pStreamScratch);
+}//end StreamScratch.
+
+/** Get the packed reference copy memory.
+The copy is held over calls and only grows.
+@param len	: Required length in pels.
+@return			: Copy memory, NULL if unavailable.
+*/
+short* H264v2Codec::RefPackedCopy(int len)
+{
+	if (len > _refPackedLen)
+	{
+		if (_pRefPacked != NULL)
+			delete[] _pRefPacked;
+		_refPackedLen = 0;
+		_pRefPacked = new short[len];
+		if (_pRefPacked == NULL)
+			return(NULL);
+		_refPackedLen = len;
+	}//end if len...
+	return(_pRefPacked);
+}//end RefPackedCopy.
+
+/** Count the start code emulation prevention bits of the NAL unit table.
+The NAL units from the start offset are evaluated, excluding their 32 bit start
+codes and NAL headers, without modifying the stream. The stream must be fully
+encoded and byte aligned.
+@param bsw	        : Stream to evaluate.
 @param startOffset  : Start evaluating the stream from a byte offset.
-@return			        : Return the number of extra bits inserted.
+@return			        : The number of bits that InsertEmulationPrevention() will insert.
 */
-int H264v2Codec::InsertEmulationPrevention(IBitStreamWriter* bsw, int startOffset)
+int H264v2Codec::EmulationPreventionBits(IBitStreamWriter* bsw, int startOffset)
 {
 	if (bsw == NULL)
 		return(0);
 
+	const unsigned char* stream = (const unsigned char*)(bsw->GetStream());
+	int endByte = bsw->GetStreamBytePos();
+
+	/// Note that the 1st 4 bytes of each unit are the start code 0x00000001 and the NAL header follows.
 	int count = 0;
+	for (int i = 0; i < _numNalUnits; i++)
+	{
+		if (_nalUnit[i].offset < startOffset)
+			continue;
+		int end = ((i + 1) < _numNalUnits) ? (_nalUnit[i + 1].offset - 4) : endByte;
+		count += EmulationPreventionBytes(stream, _nalUnit[i].offset + 2, end - 1);
+	}//end for i...
 
-	unsigned char*  streamHead = (unsigned char*)(bsw->GetStream());
-	unsigned char*  stream = &(streamHead[startOffset]);
+	return(count * 8);
+}//end EmulationPreventionBits.
+
+/** Get the bits to reserve for the emulation prevention bytes of a stream length.
+The escapes are only known once the stream is written. The reserve is the escape
+rate of the last coded picture plus a margin of 1/256 of the bits.
+@param bits	: Stream bits to be escaped.
+@return			: Bits to reserve.
+*/
+int H264v2Codec::EmulationReserveBits(int bits)
+{
+	int reserve = bits >> 8;
+	if (_emulationStreamBits > 0)
+		reserve += (int)(((double)bits * (double)_emulationBits) / (double)_emulationStreamBits);
+	return(reserve);
+}//end EmulationReserveBits.
+
+/** Insert start code emulation prevention codes.
+Scan the NAL units of the table from the start offset, excluding their 32 bit
+start codes, and check for 24 bit 0x000000 - 0x000003 sequences. Replace them
+with 32 bit 0x00000300 - 0x00000303 sequences. Each NAL unit is escaped on
+its own so that the start codes between slices are kept and the table offsets
+are moved with their NAL units. The extra byte (8 bits) for each emulation
+code is excluded from the number of allowed bits but is added to the total
+consumed bits. The escaped size is determined first and the stream is only
+modified if it fits. The escaped stream is then written in a single pass from
+a scratch copy. This method should only be called once the entire frame has
+been encoded.
+@param bsw	        : Stream to write into.
+@param startOffset  : Start evaluating the stream from a byte offset.
+@param allowedBits	: Stream space remaining after the encoded bits.
+@return			        : Return the number of extra bits inserted, -1 if they do not fit.
+*/
+int H264v2Codec::InsertEmulationPrevention(IBitStreamWriter* bsw, int startOffset, int allowedBits)
+{
+	if (bsw == NULL)
+		return(0);
+
+	int i;
+	unsigned char*  stream = (unsigned char*)(bsw->GetStream());
 
 	/// It is assumed that the stream is fully encoded and the trailing bits have been added
 	/// to ensure byte alignement of the stream. Therefore the current stream byte pos is the 
 	/// number of encoded bytes in the stream.
-	int  endPos = bsw->GetStreamBytePos() - 1 - startOffset;
-	if (endPos < 2) return(0);
+	int endByte = bsw->GetStreamBytePos();
+
+	/// The NAL units from the start offset. Each NAL unit extends to the start code of the next.
+	int first = 0;
+	while ((first < _numNalUnits) && (_nalUnit[first].offset < startOffset))
+		first++;
+	if (first >= _numNalUnits)
+		return(0);
+
+	int count = EmulationPreventionBits(bsw, startOffset) / 8;
+	if (count == 0)
+		return(0);
+	if ((count * 8) > allowedBits)
+		return(-1);
 
-	/// Find the occurrance of the start code emulation then shift down by copying backwards from the end. Note
-	/// that 1st 4 bytes are the start code 0x00000001.
-	for (int pos = 6; pos <= endPos; pos++)
+	int base = _nalUnit[first].offset - 4;
+	unsigned char* src = StreamScratch(endByte - base);
+	if (src == NULL)
+		return(-1);
+	memcpy((void *)src, (const void *)(&(stream[base])), endByte - base);
+
+	/// Copy the runs between emulations from the scratch and insert the 0x03 code before
+	/// each emulating byte.
+	int dst = base;
+	for (i = first; i < _numNalUnits; i++)
 	{
-		if ((stream[pos] & 0xFC) == 0) ///< Check for 0, 1, 2 or 3.
+		int seg = _nalUnit[i].offset - 4 - base;
+		int endPos = (((i + 1) < _numNalUnits) ? (_nalUnit[i + 1].offset - 4) : endByte) - 1 - base;
+		_nalUnit[i].offset = dst + 4;
+
+		int pos = seg + 6;
+		while (pos <= endPos)
 		{
-			if ((stream[pos - 1] == 0) && (stream[pos - 2] == 0)) ///< Check 2 preceeding bytes are zero.
+			int pair = FindZeroBytePair(src, pos - 2, endPos - 2);
+			if (pair < 0)
+				break;
+			pos = pair + 2;
+
+			if ((src[pos] & 0xFC) == 0) ///< Check for 0, 1, 2 or 3.
 			{
-				for (int i = endPos; i >= pos; i--) ///< Shift down by 1 byte.
-					stream[i + 1] = stream[i];
-				stream[pos] = 0x03; ///< Insert emulation prevention code.
-				pos++;              ///< Continue from new shifted position.
-				endPos++;           ///< Last byte is now shifted by 1 position.
-				count++;
-			}//end if stream...
-		}//end if stream...
-	}//end for pos...
+				memcpy((void *)(&(stream[dst])), (const void *)(&(src[seg])), pos - seg);
+				dst += pos - seg;
+				stream[dst++] = 0x03; ///< Insert emulation prevention code.
+				seg = pos;
+				pos += 2;
+			}//end if src...
+			else
+				pos++;
+		}//end while pos...
+		memcpy((void *)(&(stream[dst])), (const void *)(&(src[seg])), endPos + 1 - seg);
+		dst += endPos + 1 - seg;
+	}//end for i...
 
 	return(count * 8);
 }// end InsertEmulationPrevention.
 
+/** Copy a stream with its start code emulation prevention codes removed.
+Every 0x03 byte of a 24 bit 0x000003 sequence is dropped. The runs between the
+codes are found with a block scan and copied whole in a single pass. The src
+byte following a removed code may not be trapped as a code itself.
+@param src	: Escaped stream.
+@param len	: Byte length of src.
+@param dst	: Unescaped stream of at least len bytes.
+@return			: Byte length of dst.
+*/
+int H264v2Codec::UnescapeStream(const unsigned char* src, int len, unsigned char* dst)
+{
+	int out = 0;
+	int seg = 0;
+	int pos = 2;
+	int endPos = len - 1;
+	while (pos <= endPos)
+	{
+		int pair = FindZeroBytePair(src, pos - 2, endPos - 2);
+		if (pair < 0)
+			break;
+		pos = pair + 2;
+
+		if (src[pos] == 0x03) ///< Emulation prevention code = 0x03 preceeded by 2 zero bytes.
+		{
+			memcpy((void *)(&(dst[out])), (const void *)(&(src[seg])), pos - seg);
+			out += pos - seg;
+			seg = pos + 1;	///< Drop the code.
+			pos += 3;				///< Skip one to prevent trapping a 0x00 followed by a 0x03 in the actual stream.
+		}//end if src...
+		else
+			pos++;
+	}//end while pos...
+	if (seg <= endPos)
+	{
+		memcpy((void *)(&(dst[out])), (const void *)(&(src[seg])), len - seg);
+		out += len - seg;
+	}//end if seg...
+
+	return(out);
+}//end UnescapeStream.
+
 /** Remove start code emulation prevention codes.
-Scan the entire stream and check for 24 bit 0x000003 sequence
-and remove the 0x03 byte from the stream. This method should
-only be called once before decoding the entire frame.
-@param bsr	: Stream to read from.
-@return			: Return the number of extra bits removed.
+Scan the stream from the current reader position and remove the 0x03 byte of every
+24 bit 0x000003 sequence. The unescaped remainder is written to the scratch stream
+memory and the reader is moved onto it at the same bit alignment. The original
+stream is not modified. This method should only be called once before decoding 
+each slice layer of a frame with the reader on the original stream.
+@param bsr				: Stream to read from.
+@param bitLength	: Bit length of the stream.
+@return						: Return the number of extra bits removed, -1 on failure.
 */
-int H264v2Codec::RemoveEmulationPrevention(IBitStreamReader* bsr)
+int H264v2Codec::RemoveEmulationPrevention(IBitStreamReader* bsr, int bitLength)
 {
 	if (bsr == NULL)
 		return(0);
 
-	int count = 0;
+	const unsigned char* stream = (const unsigned char*)(bsr->GetStream());
+	int bitPos = bsr->GetStreamBitPos();
+	int startByte = bitPos / 8;
+	int len = ((bitLength + 7) / 8) - startByte;
+	if (len <= 0)
+		return(0);
+
+	unsigned char* dst = StreamScratch(len);
+	if (dst == NULL)
+		return(-1);
+	int outLen = UnescapeStream(&(stream[startByte]), len, dst);
 
-	unsigned char*  stream = (unsigned char*)(bsr->GetStream());
-	int             bits = bsr->GetStreamBitSize();
-	int             endPos = (bits / 8) - 1;
-	if ((bits % 8) != 0)
-		endPos++;
+	/// Continue reading from the unescaped copy.
+	bsr->SetStream((void *)dst, (outLen * 8) - (((startByte + len) * 8) - bitLength));
+	if (bitPos % 8)
+		bsr->Read(bitPos % 8);
 
-	/// Find the 1st occurrence of the emulation prevention code.
-	int pos;
-	for (pos = 2; pos <= endPos; pos++)
+	return((len - outLen) * 8);
+}// end RemoveEmulationPrevention.
+
+/** Write the picture headers to the global bit stream.
+The SPS and PPS are prepended to I-pictures when required followed by the start
+code, NAL header and slice header of the 1st slice. The slice header fields are
+set for the picture coding type. Used by Code() and again to rewrite a picture
+that falls back to a single slice.
+@param bitLimit					: Upper limit to the stream bits.
+@param pSliceStartByte	: Return the stream byte offset of the 1st slice start code.
+@return									: 1 = success, 0 = failure.
+*/
+int H264v2Codec::WritePictureHeaders(int bitLimit, int* pSliceStartByte)
+{
+	int allowedBits, bitsUsed, runOutOfBits;
+
+	/// Prepend SPS and PPS to the I-picture.
+	if ((_pictureCodingType == H264V2_INTRA) && _prependParamSetsToIPic)
 	{
-		if (stream[pos] == 0x03) ///< Emulation prevention code = 0x03...
+		allowedBits = bitLimit - _bitStreamSize;
+		int paramTotBitLen = 8 * (_encSeqParamByteLen + _encPicParamByteLen);
+		if (allowedBits < paramTotBitLen)
 		{
-			if ((stream[pos - 1] == 0) && (stream[pos - 2] == 0))  ///< ...and is preceeded by 2 zero bytes.
-			{
-				/// Shift remaining bytes up by 1 byte.
-				for (int i = pos; i < endPos; i++)
-					stream[i] = stream[i + 1];
-				pos++;    ///< Skip one to prevent trapping a 0x00 followed by a 0x03 in the actual stream.
-				endPos--; ///< Last byte was shifted by 1.
-				count++;
-			}//end if stream...
-		}//end if stream...
-	}//end for pos...
+			_errorStr = "[H264V2Codec::WritePictureHeaders] Cannot prepend SPS and PPS to I-Picture stream";
+			return(0);
+		}//end if allowedBits...
 
-	return(count * 8);
-}// end RemoveEmulationPrevention.
+		/// Write the pre-encoded SPS and PPS to the stream.
+		if (!AddNalUnit(_bitStreamSize / 8, NalHeaderH264::SeqParamSet) ||
+			  !AddNalUnit((_bitStreamSize / 8) + _encSeqParamByteLen, NalHeaderH264::PicParamSet))
+			return(0);
+		_bitAcc.Attach(_pBitStreamWriter);
+		_bitAcc.WriteBytes(_pEncSeqParam, _encSeqParamByteLen);
+		_bitAcc.WriteBytes(_pEncPicParam, _encPicParamByteLen);
+		_bitAcc.Flush();
+
+		_bitStreamSize += paramTotBitLen;
+
+	}//end if _prependParamSetsToIPic...
+
+  /// Write the 32-bit start code 0x00000001 to the stream.
+	allowedBits = bitLimit - _bitStreamSize;
+	if (allowedBits < 32)
+	{
+		_errorStr = "[H264V2Codec::WritePictureHeaders] Cannot write start code to stream";
+		return(0);
+	}//end if allowedBits...
+	int sliceStartByte = _bitStreamSize / 8;
+	*pSliceStartByte = sliceStartByte;
+	_pBitStreamWriter->Write(32, 1);
+	_bitStreamSize += 32;
+
+	/// Define the NAL unit header based on the seleceted picture coding type. The final NAL type
+	/// is only known at this point in the process.
+	if (_pictureCodingType == H264V2_INTER)
+	{
+		_nal._ref_idc = 2;  ///< Non-zero for all referenced frames P and I.
+		_nal._unit_type = NalHeaderH264::NonIDR_NoPartition_Slice;
+	}//end if H264V2_INTER...
+	else	///< if(_pictureCodingType == H264V2_INTRA)
+	{
+		_nal._ref_idc = 3;  ///< Non-zero for all referenced frames P and I.
+		_nal._unit_type = NalHeaderH264::IDR_Slice;
+	}//end else...
+	if (!AddNalUnit(sliceStartByte, _nal._unit_type))
+		return(0);
+
+	/// Write the NAL header to the stream. 
+	allowedBits = bitLimit - _bitStreamSize;
+	runOutOfBits = WriteNALHeader(_pBitStreamWriter, allowedBits, &bitsUsed);
+	_bitStreamSize += bitsUsed;
+	if (runOutOfBits) ///< or if(== 2) An error has occured.
+		return(0);
+
+	/// Write (concatinate) the slice header layer with its header flags to
+	/// the stream. The picture is encoded as one slice so the header, macroblocks
+	/// (slice data) and tail may be coded in a linear order. In "max slice bytes"
+	/// mode the following slices are started while the slice data is written.
+	_slice._first_mb_in_slice = 0;
+	_slice._frame_num = _frameNum;
+	_slice._idr_pic_id = _idrFrameNum;
+	/// Force the image plane encoders to use _pQuant as the slice qp and therefore the
+	/// slice header is determined before encoding and may be added to the bit stream here.
+	_slice._qp = _pQuant;
+	_slice._qp_delta = _slice._qp - (_picParam[_currPicParam]._pic_init_qp_minus26 + 26);
+	_slice._pic_parameter_set_id = _currPicParam;
+	/// Baseline profile only has two slice types and in this implementation they are
+	/// used for the entire frame/picture.
+	if (_pictureCodingType == H264V2_INTER)
+		_slice._type = SliceHeaderH264::P_Slice_All;
+	else
+		_slice._type = SliceHeaderH264::I_Slice_All;
+
+	allowedBits = bitLimit - _bitStreamSize;
+	runOutOfBits = WriteSliceLayerHeader(_pBitStreamWriter, allowedBits, &bitsUsed);
+	_bitStreamSize += bitsUsed;
+	if (runOutOfBits) ///< or if(== 2) An error has occured.
+		return(0);
+
+	return(1);
+}//end WritePictureHeaders.
 
 /** Write the slice data layer to the global bit stream.
 The encodings of all the macroblocks must be correctly defined before
@@ -5762,7 +7125,8 @@ writing. This impementation writes every macroblock encoding in top-left
 to bottom-right order. Each write checks if a bit overflow will occur
 before writing. The check is sufficiently frequent to warrant an early
 exit GOTO statement. If the input stream param is NULL then this method is
-used to count the bits only.
+used to count the bits only. Codes are written through the _bitAcc
+accumulator that is flushed before returning.
 @param bsw					: Stream to write into.
 @param allowedBits	: Upper limit to the writable bits.
 @param bitsUsed			: Return the actual bits used.
@@ -5777,6 +7141,8 @@ int H264v2Codec::WriteSliceDataLayer(IBitStreamWriter* bsw, int allowedBits, int
 	/// All macroblocks are written in order.
 	int len = _mbLength;
 	_mb_skip_run = 0;
+	if (bsw)
+		_bitAcc.Attach(bsw);
 
 	/// ------------------------ Code the slice data -----------------------------------
 	for (mb = 0; mb < len; mb++)
@@ -5790,28 +7156,230 @@ int H264v2Codec::WriteSliceDataLayer(IBitStreamWriter* bsw, int allowedBits, int
 				(_slice._type != SliceHeaderH264::I_Slice_All) && (_slice._type != SliceHeaderH264::SI_Slice_All))
 			{
 				/// ------------------------ Code the skip run -----------------------------------
-				bitCount = _pHeaderUnsignedVlcEnc->Encode(_mb_skip_run);
-				if (bitCount <= 0)	///< Vlc codec errors are detected from a zero or negative return value.
-					goto H264V2_VLCERROR_WRITE;
+				bitCount = ExpGolombH264::UnsignedBits(_mb_skip_run);
 				if ((bitsUsedSoFar + bitCount) > allowedBits)
 					goto H264V2_RUNOUTOFBITS_WRITE;
 				if (bsw)
-					bsw->Write(bitCount, _pHeaderUnsignedVlcEnc->GetCode());
+					_bitAcc.WriteUe(_mb_skip_run);
+				bitsUsedSoFar += bitCount;
+
+				_mb_skip_run = 0;	///< ...and reset.
+			}//end if !I_Slice...
+
+			/// ------------------------ Code the macroblock data ------------------------------------
+			/// Only non-skipped macroblocks call this method.
+			int ret = WriteMacroBlockLayer(bsw, pMb, allowedBits - bitsUsedSoFar, &bitCount);
+			if (ret) ///< An error has occurred.
+			{
+				/// _errorStr was set in the WriteMacroBlockLayer() method.
+				if (bsw)
+					_bitAcc.Flush();
+				*bitsUsed = bitsUsedSoFar + bitCount;
+				return(ret);
+			}//end if ret...
+			bitsUsedSoFar += bitCount;
+		}//end if !_skip...
+		else
+		{
+			_mb_skip_run++;
+			/// Ensure coeffs settings are synchronised for future use by neighbours.
+			for (i = 0; i < MBH264_NUM_BLKS; i++)
+				pMb->_blkParam[i].pBlk->SetNumCoeffs(0);
+		}//end else...
+
+	}//end for mb...
+
+	/// If the final macroblocks of the slice were all skipped then a skip run must be coded onto the stream.
+	if (_mb_skip_run)
+	{
+		if ((_slice._type != SliceHeaderH264::I_Slice) && (_slice._type != SliceHeaderH264::SI_Slice) &&
+			(_slice._type != SliceHeaderH264::I_Slice_All) && (_slice._type != SliceHeaderH264::SI_Slice_All))
+		{
+			bitCount = ExpGolombH264::UnsignedBits(_mb_skip_run);
+			if ((bitsUsedSoFar + bitCount) > allowedBits)
+				goto H264V2_RUNOUTOFBITS_WRITE;
+			if (bsw)
+				_bitAcc.WriteUe(_mb_skip_run);
+			bitsUsedSoFar += bitCount;
+		}//end if !I_Slice...
+	}//end if _mb_skip_run...
+
+	if (bsw)
+		_bitAcc.Flush();
+	*bitsUsed = bitsUsedSoFar;
+	return(0);
+
+H264V2_RUNOUTOFBITS_WRITE:
+	_errorStr = "H264V2:[WriteSliceDataLayer] Bits required exceeds max available for picture";
+	if (bsw)
+		_bitAcc.Flush();
+	*bitsUsed = bitsUsedSoFar;
+	return(1);
+
+}//end WriteSliceDataLayer.
+
+/** Write the slice data layer as byte budgeted slices.
+The "max slice bytes" form of WriteSliceDataLayer(). The macroblocks are written
+in order and a new slice is started at any macroblock that would take the current
+slice NAL unit beyond _maxSliceBytes. The ending slice is completed with its
+trailing bits and the new one is written with its own start code, NAL header and
+slice header. A slice always holds at least one macroblock and the emulation
+prevention bytes are held within the budget by the EmulationReserveBits() margin.
+The macroblocks of the later
+slices are linked to their slice neighbourhood and repaired before they are
+counted. The last slice is left for the caller to write its trailing bits.
+@param bsw					: Stream to write into.
+@param allowedBits	: Upper limit to the writable bits.
+@param sliceBits		: Bits of the 1st slice NAL unit already written.
+@param bitsUsed			: Return the actual bits used.
+@return							: Run out of bits = 1, more bits available = 0, Vlc error = 2.
+*/
+int H264v2Codec::WriteSlicedDataLayer(IBitStreamWriter* bsw, int allowedBits, int sliceBits, int* bitsUsed)
+{
+	int mb, i, ret;
+	int	bitCount;
+	int bitsUsedSoFar = 0;
+	int startPos = bsw->GetStreamBitPos();
+	int maxSliceBits = 8 * _maxSliceBytes;
+	/// The emulation prevention bytes are inserted after all the slices are written and are
+	/// kept within the slice budget by a reserve.
+	if (_startCodeEmulationPrevention)
+		maxSliceBits -= EmulationReserveBits(maxSliceBits);
+	int mbWidth = _lumWidth / 16;
+	int mbHeight = _lumHeight / 16;
+	int firstMb = 0;
+	int sliceNum = 0;
+	int isPSlice = ((_slice._type != SliceHeaderH264::I_Slice) && (_slice._type != SliceHeaderH264::SI_Slice) &&
+		(_slice._type != SliceHeaderH264::I_Slice_All) && (_slice._type != SliceHeaderH264::SI_Slice_All));
+
+	/// Intra macroblocks are re-encoded with the intra transforms at slice starts.
+	_16x16->SetOverlayDim(16, 16);
+	_16x16->SetOrigin(0, 0);
+	_8x8_0->SetOverlayDim(8, 8);
+	_8x8_0->SetOrigin(0, 0);
+	_8x8_1->SetOverlayDim(8, 8);
+	_8x8_1->SetOrigin(0, 0);
+	_pF4x4TLum->SetMode(IForwardTransform::TransformOnly);
+	_pF4x4TLum->SetParameter(IForwardTransform::INTRA_FLAG_ID, 1);
+	_pF4x4TChr->SetMode(IForwardTransform::TransformOnly);
+	_pF4x4TChr->SetParameter(IForwardTransform::INTRA_FLAG_ID, 1);
+	_pFDC4x4T->SetMode(IForwardTransform::TransformOnly);
+	_pFDC4x4T->SetParameter(IForwardTransform::INTRA_FLAG_ID, 1);
+	_pFDC2x2T->SetMode(IForwardTransform::TransformOnly);
+	_pFDC2x2T->SetParameter(IForwardTransform::INTRA_FLAG_ID, 1);
+	memset((void *)_mbRecoded, 0, _mbLength * sizeof(bool));
+
+	/// All macroblocks are written in order.
+	int len = _mbLength;
+	_mb_skip_run = 0;
+	_bitAcc.Attach(bsw);
+
+	for (mb = 0; mb < len; mb++)
+	{
+		/// Short cut variables.
+		MacroBlockH264* pMb = &(_pMb[mb]);
+
+		if (sliceNum)
+			ResliceMacroBlock(pMb);
+
+		/// The macroblock bits and the bits to end the slice after it. The trailing bits are at most a byte.
+		int mbBits = 0;
+		int endBits = 8;
+		if (!pMb->_skip)
+		{
+			mbBits = MacroBlockLayerBitCounter(pMb);
+			if (isPSlice)
+				mbBits += ExpGolombH264::UnsignedBits(_mb_skip_run);
+		}//end if !_skip...
+		else if (isPSlice)
+			endBits += ExpGolombH264::UnsignedBits(_mb_skip_run + 1);
+
+		if ((mb > firstMb) && ((sliceBits + mbBits + endBits) > maxSliceBits))
+		{
+			/// ------------------------ End the slice before this macroblock ---------------------
+			if (_mb_skip_run)
+			{
+				bitCount = ExpGolombH264::UnsignedBits(_mb_skip_run);
+				if ((bitsUsedSoFar + bitCount) > allowedBits)
+					goto H264V2_RUNOUTOFBITS_SLICED_WRITE;
+				_bitAcc.WriteUe(_mb_skip_run);
+				bitsUsedSoFar += bitCount;
+				_mb_skip_run = 0;
+			}//end if _mb_skip_run...
+			_bitAcc.Flush();
+
+			ret = WriteTrailingBits(bsw, allowedBits - bitsUsedSoFar, &bitCount);
+			if (ret)
+			{
+				*bitsUsed = bitsUsedSoFar + bitCount;
+				return(ret);
+			}//end if ret...
+			bitsUsedSoFar = bsw->GetStreamBitPos() - startPos; ///< Include the zero bits to the byte boundary.
+
+			/// ------------------------ Start the next slice at this macroblock ------------------
+			if ((bitsUsedSoFar + 32) > allowedBits)
+				goto H264V2_RUNOUTOFBITS_SLICED_WRITE;
+			if (!AddNalUnit(bsw->GetStreamBitPos() / 8, _nal._unit_type))
+			{
+				*bitsUsed = bitsUsedSoFar;
+				return(2);
+			}//end if !AddNalUnit...
+			bsw->Write(32, 1);
+			bitsUsedSoFar += 32;
+
+			ret = WriteNALHeader(bsw, allowedBits - bitsUsedSoFar, &bitCount);
+			bitsUsedSoFar += bitCount;
+			sliceBits = bitCount;
+			if (ret)
+			{
+				*bitsUsed = bitsUsedSoFar;
+				return(ret);
+			}//end if ret...
+
+			_slice._first_mb_in_slice = mb;
+			ret = WriteSliceLayerHeader(bsw, allowedBits - bitsUsedSoFar, &bitCount);
+			bitsUsedSoFar += bitCount;
+			sliceBits += bitCount;
+			if (ret)
+			{
+				*bitsUsed = bitsUsedSoFar;
+				return(ret);
+			}//end if ret...
+			_bitAcc.Attach(bsw);
+
+			/// Link the remaining macroblocks into the new slice and repair this one for it.
+			firstMb = mb;
+			sliceNum++;
+			MacroBlockH264::Initialise(mbHeight, mbWidth, firstMb, len - 1, sliceNum, _Mb);
+			ResliceMacroBlock(pMb);
+		}//end if mb...
+
+		if (!pMb->_skip)
+		{
+			if (isPSlice)
+			{
+				/// ------------------------ Code the skip run -----------------------------------
+				bitCount = ExpGolombH264::UnsignedBits(_mb_skip_run);
+				if ((bitsUsedSoFar + bitCount) > allowedBits)
+					goto H264V2_RUNOUTOFBITS_SLICED_WRITE;
+				_bitAcc.WriteUe(_mb_skip_run);
 				bitsUsedSoFar += bitCount;
+				sliceBits += bitCount;
 
 				_mb_skip_run = 0;	///< ...and reset.
-			}//end if !I_Slice...
+			}//end if isPSlice...
 
 			/// ------------------------ Code the macroblock data ------------------------------------
-			/// Only non-skipped macroblocks call this method.
-			int ret = WriteMacroBlockLayer(bsw, pMb, allowedBits - bitsUsedSoFar, &bitCount);
+			ret = WriteMacroBlockLayer(bsw, pMb, allowedBits - bitsUsedSoFar, &bitCount);
 			if (ret) ///< An error has occurred.
 			{
 				/// _errorStr was set in the WriteMacroBlockLayer() method.
+				_bitAcc.Flush();
 				*bitsUsed = bitsUsedSoFar + bitCount;
 				return(ret);
 			}//end if ret...
 			bitsUsedSoFar += bitCount;
+			sliceBits += bitCount;
 		}//end if !_skip...
 		else
 		{
@@ -5824,45 +7392,99 @@ int H264v2Codec::WriteSliceDataLayer(IBitStreamWriter* bsw, int allowedBits, int
 	}//end for mb...
 
 	/// If the final macroblocks of the slice were all skipped then a skip run must be coded onto the stream.
-	if (_mb_skip_run)
+	if (_mb_skip_run && isPSlice)
 	{
-		if ((_slice._type != SliceHeaderH264::I_Slice) && (_slice._type != SliceHeaderH264::SI_Slice) &&
-			(_slice._type != SliceHeaderH264::I_Slice_All) && (_slice._type != SliceHeaderH264::SI_Slice_All))
-		{
-			bitCount = _pHeaderUnsignedVlcEnc->Encode(_mb_skip_run);
-			if (bitCount <= 0)	///< Vlc codec errors are detected from a zero or negative return value.
-				goto H264V2_VLCERROR_WRITE;
-			if ((bitsUsedSoFar + bitCount) > allowedBits)
-				goto H264V2_RUNOUTOFBITS_WRITE;
-			if (bsw)
-				bsw->Write(bitCount, _pHeaderUnsignedVlcEnc->GetCode());
-			bitsUsedSoFar += bitCount;
-		}//end if !I_Slice...
+		bitCount = ExpGolombH264::UnsignedBits(_mb_skip_run);
+		if ((bitsUsedSoFar + bitCount) > allowedBits)
+			goto H264V2_RUNOUTOFBITS_SLICED_WRITE;
+		_bitAcc.WriteUe(_mb_skip_run);
+		bitsUsedSoFar += bitCount;
 	}//end if _mb_skip_run...
 
+	_bitAcc.Flush();
 	*bitsUsed = bitsUsedSoFar;
 	return(0);
 
-H264V2_RUNOUTOFBITS_WRITE:
-	_errorStr = "H264V2:[WriteSliceDataLayer] Bits required exceeds max available for picture";
+H264V2_RUNOUTOFBITS_SLICED_WRITE:
+	_errorStr = "H264V2:[WriteSlicedDataLayer] Bits required exceeds max available for picture";
+	_bitAcc.Flush();
 	*bitsUsed = bitsUsedSoFar;
 	return(1);
 
-H264V2_VLCERROR_WRITE:
-	_errorStr = "H264V2:[WriteSliceDataLayer] Vlc encoder error";
-	*bitsUsed = bitsUsedSoFar;
-	return(2);
+}//end WriteSlicedDataLayer.
+
+/** Repair the neighbour dependent codes of a macroblock for its slice.
+The macroblocks are encoded as a single slice picture and those that are moved
+into a later slice by the "max slice bytes" mode must be linked to their slice
+neighbourhood before this call. Inter reconstructions do not depend on the slice
+so only the motion vector difference, delta QP and skip flag are derived again.
+Intra macroblocks that have lost a neighbour, or that predict from a re-encoded
+neighbour, are re-encoded at their coding QP and flagged in _mbRecoded.
+@param pMb	: Macroblock to repair.
+@return			: none.
+*/
+void H264v2Codec::ResliceMacroBlock(MacroBlockH264* pMb)
+{
+	if (pMb->_intraFlag)
+	{
+		int mbWidth = _lumWidth / 16;
+		int col = pMb->_mbIndex % mbWidth;
+		int row = pMb->_mbIndex / mbWidth;
 
-}//end WriteSliceDataLayer.
+		/// All the neighbours within the picture were available to the single slice encoding.
+		bool recode = ((col > 0) && (pMb->_leftMb == NULL)) || ((row > 0) && (pMb->_aboveMb == NULL)) ||
+			((col > 0) && (row > 0) && (pMb->_aboveLeftMb == NULL));
+		recode = recode || ((pMb->_leftMb != NULL) && _mbRecoded[pMb->_leftMb->_mbIndex]) ||
+			((pMb->_aboveMb != NULL) && _mbRecoded[pMb->_aboveMb->_mbIndex]) ||
+			((pMb->_aboveLeftMb != NULL) && _mbRecoded[pMb->_aboveLeftMb->_mbIndex]);
+
+		if (recode)
+		{
+			pMb->_mbQP = pMb->_mbEncQP;
+			ProcessIntraMbImplStd(pMb, 0);
+			_mbRecoded[pMb->_mbIndex] = 1;
+		}//end if recode...
+		else
+			pMb->_mb_qp_delta = GetDeltaQP(pMb);
+		return;
+	}//end if _intraFlag...
+
+	/// Only Inter_16x16 mode is currently implemented with a single motion vector.
+	int predX, predY;
+	MacroBlockH264::GetMbMotionMedianPred(pMb, &predX, &predY);
+	pMb->_mvdX[MacroBlockH264::_16x16] = pMb->_mvX[MacroBlockH264::_16x16] - predX;
+	pMb->_mvdY[MacroBlockH264::_16x16] = pMb->_mvY[MacroBlockH264::_16x16] - predY;
+
+	pMb->_mb_qp_delta = GetDeltaQP(pMb);
+
+	/// The skip conditions of ProcessInterMbImplStd() with the slice neighbourhood.
+	SetMbSkip(pMb, 0);
+	if (pMb->_coded_blk_pattern == 0)
+	{
+		if (MacroBlockH264::SkippedZeroMotionPredCondition(pMb))
+		{
+			if ((pMb->_mvX[MacroBlockH264::_16x16] == 0) && (pMb->_mvY[MacroBlockH264::_16x16] == 0))
+				SetMbSkip(pMb, 1);
+		}//end if SkippedZeroMotionPredCondition...
+		else
+		{
+			if ((pMb->_mvdX[MacroBlockH264::_16x16] == 0) && (pMb->_mvdY[MacroBlockH264::_16x16] == 0))
+				SetMbSkip(pMb, 1);
+		}//end else...
+	}//end if _coded_blk_pattern...
+}//end ResliceMacroBlock.
 
 /** Read the slice data layer from the global bit stream.
-This impementation reads every macroblock encoding in top-left to
-bottom-right order. Each read checks if a bit underflow will occur
-after reading. Check for loss of vlc sync wherever possible. The
-checks are sufficiently frequent to warrant an early exit GOTO
-statement.
+This impementation reads the macroblock encodings in top-left to
+bottom-right order from the first macroblock of the slice. The slice
+ends at the last macroblock or when its data is used up with no skip run
+left. The header and coeff codes are read through the _bitCache reader
+that returns zeros beyond the end of the stream and flags invalid codes.
+Therefore the bit underflow check is made once per macroblock instead of
+after every read. The checks are sufficiently frequent to warrant an early
+exit GOTO statement. The stream reader is left after the slice data on return.
 @param bsr						: Stream to read from.
-@param remainingBits	: Upper limit to the readable bits.
+@param remainingBits	: Slice data bits up to the rbsp stop bit.
 @param bitsUsed				: Return the actual bits extracted.
 @return								: Run out of bits = 1, more bits available = 0, error = 2.
 */
@@ -5870,28 +7492,21 @@ int H264v2Codec::ReadSliceDataLayer(IBitStreamReader* bsr, int remainingBits, in
 {
 	int mb, i;
 	int bitsUsedSoFar = 0;
-	int numBits;
 
 	/// Whip through each macroblock. Extract the encoded macroblock
 	/// from the bit stream and vlc decode the vectors and coeff's.
 	int len = _mbLength;
 	_mb_skip_run = 0;
 
+	int startPos = bsr->GetStreamBitPos();
+	_bitCache.Attach(bsr->GetStream(), bsr->GetStreamBitSize(), startPos);
+
 	/// Get the first skip run from the stream for P slices.
 	if ((_slice._type != SliceHeaderH264::I_Slice) && (_slice._type != SliceHeaderH264::SI_Slice) &&
 		(_slice._type != SliceHeaderH264::I_Slice_All) && (_slice._type != SliceHeaderH264::SI_Slice_All))
-	{
-		_mb_skip_run = _pHeaderUnsignedVlcDec->Decode(bsr);
-		numBits = _pHeaderUnsignedVlcDec->GetNumDecodedBits();
-		if (numBits == 0)	///< Return = 0 implies no valid vlc code.
-			goto H264V2_NOVLC_READ;
-		bitsUsedSoFar += numBits;
-		/// Vlc length unknown and so only checked after the fact but assumes non-destructive read.
-		if (bitsUsedSoFar > remainingBits)
-			goto H264V2_RUNOUTOFBITS_READ;
-	}//end if !I_Slice...
+		_mb_skip_run = _bitCache.ReadUe();
 
-	for (mb = 0; mb < len; mb++)
+	for (mb = _slice._first_mb_in_slice; mb < len; mb++)
 	{
 		/// Short cut variables.
 		MacroBlockH264* pMb = &(_pMb[mb]);
@@ -5931,14 +7546,7 @@ int H264v2Codec::ReadSliceDataLayer(IBitStreamReader* bsr, int remainingBits, in
 			pMb->_skip = 0;
 
 			/// Macroblock type.
-			_pMb[mb]._mb_type = _pMbTypeVlcDec->Decode(bsr);
-			numBits = _pMbTypeVlcDec->GetNumDecodedBits();
-			if (numBits == 0)	///< Return = 0 implies no valid vlc code.
-				goto H264V2_NOVLC_READ;
-			bitsUsedSoFar += numBits;
-			/// Vlc length unknown and so only checked after the fact but assumes non-destructive read.
-			if (bitsUsedSoFar > remainingBits)
-				goto H264V2_RUNOUTOFBITS_READ;
+			_pMb[mb]._mb_type = _bitCache.ReadUe();
 			/// Unpack _intraFlag and _mbPartPredMode from the decoded _mb_type.
 			_pMb[mb].UnpackMbType(&(_pMb[mb]), _slice._type);
 
@@ -5955,19 +7563,8 @@ int H264v2Codec::ReadSliceDataLayer(IBitStreamReader* bsr, int remainingBits, in
 				for (int vec = 0; vec < numOfVecs; vec++)
 				{
 					/// Get the motion vector differences for this macroblock.
-					_pMb[mb]._mvdX[vec] = _pMbMotionVecDiffVlcDec->Decode(bsr);
-					numBits = _pMbMotionVecDiffVlcDec->GetNumDecodedBits();
-					if (numBits == 0)
-						goto H264V2_NOVLC_READ;
-					bitsUsedSoFar += numBits;
-
-					_pMb[mb]._mvdY[vec] = _pMbMotionVecDiffVlcDec->Decode(bsr);
-					numBits = _pMbMotionVecDiffVlcDec->GetNumDecodedBits();
-					if (numBits == 0)
-						goto H264V2_NOVLC_READ;
-					bitsUsedSoFar += numBits;
-					if (bitsUsedSoFar > remainingBits)
-						goto H264V2_RUNOUTOFBITS_READ;
+					_pMb[mb]._mvdX[vec] = _bitCache.ReadSe();
+					_pMb[mb]._mvdY[vec] = _bitCache.ReadSe();
 
 					/// Get the prediction vector from the neighbourhood.
 					int predX, predY;
@@ -5981,27 +7578,17 @@ int H264v2Codec::ReadSliceDataLayer(IBitStreamReader* bsr, int remainingBits, in
 				// TODO: Implement Intra_8x8 and Intra_4x4 mode options.
 
 				/// Get chr prediction mode.
-				_pMb[mb]._intraChrPredMode = _pMbIChrPredModeVlcDec->Decode(bsr);
-				numBits = _pMbIChrPredModeVlcDec->GetNumDecodedBits();
-				if (numBits == 0)
-					goto H264V2_NOVLC_READ;
-				bitsUsedSoFar += numBits;
-				if (bitsUsedSoFar > remainingBits)
-					goto H264V2_RUNOUTOFBITS_READ;
+				_pMb[mb]._intraChrPredMode = _bitCache.ReadUe();
 			}//end else...
 
 			/// If not Intra_16x16 mode then _coded_blk_pattern must be extracted.
 			if ((_pMb[mb]._intraFlag && (_pMb[mb]._mbPartPredMode != MacroBlockH264::Intra_16x16)) || (!_pMb[mb]._intraFlag))
 			{
-				/// Block coded pattern.
-				int isInter = 1;
-				if (_pMb[mb]._intraFlag) isInter = 0;
-				numBits = _pBlkPattVlcDec->Decode2(bsr, &(_pMb[mb]._coded_blk_pattern), &isInter);
-				if (numBits == 0)
+				/// Block coded pattern mapped from its code number.
+				int codeNum = _bitCache.ReadUe();
+				if (codeNum >= 48)
 					goto H264V2_NOVLC_READ;
-				bitsUsedSoFar += numBits;
-				if (bitsUsedSoFar > remainingBits)
-					goto H264V2_RUNOUTOFBITS_READ;
+				_pMb[mb]._coded_blk_pattern = codedBlkPatternMap[codeNum][!_pMb[mb]._intraFlag];
 			}//end if !Intra_16x16...
 
 		}//end else not skipped...
@@ -6016,15 +7603,13 @@ int H264v2Codec::ReadSliceDataLayer(IBitStreamReader* bsr, int remainingBits, in
 		if ((_pMb[mb]._coded_blk_pattern > 0) || (_pMb[mb]._intraFlag && (_pMb[mb]._mbPartPredMode == MacroBlockH264::Intra_16x16)))
 		{
 			/// Delta QP.
-			_pMb[mb]._mb_qp_delta = _pDeltaQPVlcDec->Decode(bsr);
-			numBits = _pDeltaQPVlcDec->GetNumDecodedBits();
-			if (numBits == 0)
-				goto H264V2_NOVLC_READ;
-			bitsUsedSoFar += numBits;
-			if (bitsUsedSoFar > remainingBits)
-				goto H264V2_RUNOUTOFBITS_READ;
+			_pMb[mb]._mb_qp_delta = _bitCache.ReadSe();
 		}//end if _coded_blk_pattern...
 
+		/// The header is checked for invalid codes before its values are used.
+		if (_bitCache.GetError())
+			goto H264V2_NOVLC_READ;
+
 		int prevMbIdx = _pMb[mb]._mbIndex - 1;
 		if (prevMbIdx >= 0)	///< Previous macroblock is within the image boundaries.
 		{
@@ -6055,11 +7640,6 @@ int H264v2Codec::ReadSliceDataLayer(IBitStreamReader* bsr, int remainingBits, in
 
 			if (pBlk->IsCoded())
 			{
-				/// Choose the appropriate dimension CAVLC codec.
-				IContextAwareRunLevelCodec* pCAVLC = _pCAVLC2x2;
-				if ((pBlk->GetHeight() == 4) && (pBlk->GetWidth() == 4))
-					pCAVLC = _pCAVLC4x4;
-
 				/// Get num of neighbourhood coeffs as average of above and left block coeffs. Previous
 				/// MB decodings in decoding order have already set the num of neighbourhood coeffs.
 				int neighCoeffs = 0;
@@ -6070,19 +7650,10 @@ int H264v2Codec::ReadSliceDataLayer(IBitStreamReader* bsr, int remainingBits, in
 					else	///< Negative values for neighbourIndicator imply pass through.
 						neighCoeffs = _pMb[mb]._blkParam[i].neighbourIndicator;
 				}//end if neighbourIndicator...
-				pCAVLC->SetParameter(pCAVLC->NUM_TOT_NEIGHBOR_COEFF_ID, neighCoeffs);	///< Prepare the vlc coder.
-				pCAVLC->SetParameter(pCAVLC->DC_SKIP_FLAG_ID, _pMb[mb]._blkParam[i].dcSkipFlag);
 
-				numBits = pBlk->RleDecode(pCAVLC, bsr);					///< Vlc decode from the stream.
-				if (numBits <= 0)	///< Vlc codec errors are detected from a negative return value.
-				{
-					if (numBits == -2)
-						goto H264V2_RUNOUTOFBITS_READ;
+				/// Table driven vlc decode from the stream. The number of coeffs is set here for the blk.
+				if (_pCAVLCDec->Decode(&_bitCache, pBlk, neighCoeffs, _pMb[mb]._blkParam[i].dcSkipFlag) < 0)
 					goto H264V2_NOVLC_READ;
-				}//end if numBits...
-				bitsUsedSoFar += numBits;
-				if (bitsUsedSoFar > remainingBits)
-					goto H264V2_RUNOUTOFBITS_READ;
 			}//end if IsCoded()...
 			else
 			{
@@ -6091,22 +7662,32 @@ int H264v2Codec::ReadSliceDataLayer(IBitStreamReader* bsr, int remainingBits, in
 			}//end else...
 		}//end for i...
 
+		/// The slice ends when its data is used up and no skipped macroblocks remain.
+		if (!_mb_skip_run && ((_bitCache.GetBitPos() - startPos) >= remainingBits))
+			break;
+
 		/// If end of skipped macroblocks then get the next skip run from the stream.
 		if (!_mb_skip_run && !pMb->_skip && (_slice._type != SliceHeaderH264::I_Slice) && (_slice._type != SliceHeaderH264::SI_Slice) &&
 			(_slice._type != SliceHeaderH264::I_Slice_All) && (_slice._type != SliceHeaderH264::SI_Slice_All) && (mb != (len - 1)))
-		{
-			_mb_skip_run = _pHeaderUnsignedVlcDec->Decode(bsr);
-			numBits = _pHeaderUnsignedVlcDec->GetNumDecodedBits();
-			if (numBits == 0)	///< Return = 0 implies no valid vlc code.
-				goto H264V2_NOVLC_READ;
-			bitsUsedSoFar += numBits;
-			/// Vlc length unknown and so only checked after the fact but assumes non-destructive read.
-			if (bitsUsedSoFar > remainingBits)
-				goto H264V2_RUNOUTOFBITS_READ;
-		}//end if !_mb_skip_run...
+			_mb_skip_run = _bitCache.ReadUe();
+
+		/// The header, coeffs and following skip run of the macroblock are checked together.
+		bitsUsedSoFar = _bitCache.GetBitPos() - startPos;
+		if (bitsUsedSoFar > remainingBits)
+			goto H264V2_RUNOUTOFBITS_READ;
 
 	}//end for mb...
 
+	/// An invalid skip run is only detected here when no coded macroblock follows it.
+	bitsUsedSoFar = _bitCache.GetBitPos() - startPos;
+	if (_bitCache.GetError())
+		goto H264V2_NOVLC_READ;
+	if (bitsUsedSoFar > remainingBits)
+		goto H264V2_RUNOUTOFBITS_READ;
+
+	/// Leave the stream reader after the slice data.
+	bsr->Seek(_bitCache.GetBitPos());
+
 	*bitsUsed = bitsUsedSoFar;
 	return(0);
 
@@ -6133,6 +7714,10 @@ writing. This impementation writes one non-skipped macroblock encoding.
 Each write checks if a bit overflow will occur before writing. The check
 is sufficiently frequent to warrant an early exit GOTO statement. If the
 input stream param is NULL then this method is used to count the bits only.
+The header codes are written through the _bitAcc accumulator that must be
+attached to bsw by the caller. The CAVLC coders write the residual to bsw
+directly and the accumulator is flushed before each coded block, so only the
+header codes are gathered into words.
 @param bsw					: Stream to write into.
 @param pMb					: Macroblock to encode.
 @param allowedBits	: Upper limit to the writable bits.
@@ -6152,13 +7737,11 @@ int H264v2Codec::WriteMacroBlockLayer(IBitStreamWriter* bsw, MacroBlockH264* pMb
 	/// ------------------------ Code the macroblock header -----------------------------------
 
 	/// Macroblock type.
-	bitCount = _pMbTypeVlcEnc->Encode(pMb->_mb_type);
-	if (bitCount <= 0)	///< Vlc codec errors are detected from a zero or negative return value.
-		goto H264V2_VLCERROR_WRITE_MB;
+	bitCount = ExpGolombH264::UnsignedBits(pMb->_mb_type);
 	if ((bitsUsedSoFar + bitCount) > allowedBits)
 		goto H264V2_RUNOUTOFBITS_WRITE_MB;
 	if (bsw)
-		bsw->Write(bitCount, _pMbTypeVlcEnc->GetCode());
+		_bitAcc.WriteUe(pMb->_mb_type);
 	bitsUsedSoFar += bitCount;
 
 	/// Intra requires lum and chr prediction modes, Inter requires reference 
@@ -6170,22 +7753,18 @@ int H264v2Codec::WriteMacroBlockLayer(IBitStreamWriter* bsw, MacroBlockH264* pMb
 			numOfVecs = 1;
 		for (int vec = 0; vec < numOfVecs; vec++)
 		{
-			bitCount = _pMbMotionVecDiffVlcEnc->Encode(pMb->_mvdX[vec]);
-			if (bitCount <= 0)
-				goto H264V2_VLCERROR_WRITE_MB;
+			bitCount = ExpGolombH264::SignedBits(pMb->_mvdX[vec]);
 			if ((bitsUsedSoFar + bitCount) > allowedBits)
 				goto H264V2_RUNOUTOFBITS_WRITE_MB;
 			if (bsw)
-				bsw->Write(bitCount, _pMbMotionVecDiffVlcEnc->GetCode());
+				_bitAcc.WriteSe(pMb->_mvdX[vec]);
 			bitsUsedSoFar += bitCount;
 
-			bitCount = _pMbMotionVecDiffVlcEnc->Encode(pMb->_mvdY[vec]);
-			if (bitCount <= 0)
-				goto H264V2_VLCERROR_WRITE_MB;
+			bitCount = ExpGolombH264::SignedBits(pMb->_mvdY[vec]);
 			if ((bitsUsedSoFar + bitCount) > allowedBits)
 				goto H264V2_RUNOUTOFBITS_WRITE_MB;
 			if (bsw)
-				bsw->Write(bitCount, _pMbMotionVecDiffVlcEnc->GetCode());
+				_bitAcc.WriteSe(pMb->_mvdY[vec]);
 			bitsUsedSoFar += bitCount;
 
 		}//end for vec...
@@ -6195,13 +7774,11 @@ int H264v2Codec::WriteMacroBlockLayer(IBitStreamWriter* bsw, MacroBlockH264* pMb
 		// TODO: Implement Intra_8x8 and Intra_4x4 mode options.
 
 		/// Write chr prediction mode.
-		bitCount = _pMbIChrPredModeVlcEnc->Encode(pMb->_intraChrPredMode);
-		if (bitCount <= 0)
-			goto H264V2_VLCERROR_WRITE_MB;
+		bitCount = ExpGolombH264::UnsignedBits(pMb->_intraChrPredMode);
 		if ((bitsUsedSoFar + bitCount) > allowedBits)
 			goto H264V2_RUNOUTOFBITS_WRITE_MB;
 		if (bsw)
-			bsw->Write(bitCount, _pMbIChrPredModeVlcEnc->GetCode());
+			_bitAcc.WriteUe(pMb->_intraChrPredMode);
 		bitsUsedSoFar += bitCount;
 
 	}//end else...
@@ -6218,7 +7795,7 @@ int H264v2Codec::WriteMacroBlockLayer(IBitStreamWriter* bsw, MacroBlockH264* pMb
 		if ((bitsUsedSoFar + bitCount) > allowedBits)
 			goto H264V2_RUNOUTOFBITS_WRITE_MB;
 		if (bsw)
-			bsw->Write(bitCount, _pBlkPattVlcEnc->GetCode());
+			_bitAcc.Write(bitCount, _pBlkPattVlcEnc->GetCode());
 		bitsUsedSoFar += bitCount;
 
 	}//end if !Intra_16x16...
@@ -6228,13 +7805,11 @@ int H264v2Codec::WriteMacroBlockLayer(IBitStreamWriter* bsw, MacroBlockH264* pMb
 	if ((pMb->_coded_blk_pattern > 0) || (pMb->_intraFlag && (pMb->_mbPartPredMode == MacroBlockH264::Intra_16x16)))
 	{
 		/// Delta QP.
-		bitCount = _pDeltaQPVlcEnc->Encode(pMb->_mb_qp_delta);
-		if (bitCount <= 0)
-			goto H264V2_VLCERROR_WRITE_MB;
+		bitCount = ExpGolombH264::SignedBits(pMb->_mb_qp_delta);
 		if ((bitsUsedSoFar + bitCount) > allowedBits)
 			goto H264V2_RUNOUTOFBITS_WRITE_MB;
 		if (bsw)
-			bsw->Write(bitCount, _pDeltaQPVlcEnc->GetCode());
+			_bitAcc.WriteSe(pMb->_mb_qp_delta);
 		bitsUsedSoFar += bitCount;
 
 	}//end if _coded_blk_pattern...
@@ -6274,7 +7849,10 @@ int H264v2Codec::WriteMacroBlockLayer(IBitStreamWriter* bsw, MacroBlockH264* pMb
 			pCAVLC->SetParameter(pCAVLC->NUM_TOT_NEIGHBOR_COEFF_ID, neighCoeffs);	///< Prepare the vlc coder.
 			pCAVLC->SetParameter(pCAVLC->DC_SKIP_FLAG_ID, pMb->_blkParam[i].dcSkipFlag);
 
-			///< Vlc encode and add to stream. The number of coeffs is set here for the blk.
+			///< Vlc encode and add to stream. The number of coeffs is set here for the blk. The
+			/// CAVLC writes to the stream writer directly and the pending header bits go first.
+			if (bsw && _bitAcc.GetPendingBits())
+				_bitAcc.Flush();
 			bitCount = (pMb->_blkParam[i].pBlk)->RleEncode(pCAVLC, bsw);
 			if (bitCount <= 0)
 			{
@@ -6326,7 +7904,7 @@ int H264v2Codec::MacroBlockLayerBitCounter(MacroBlockH264* pMb)
 	/// ------------------------ Code the macroblock header -----------------------------------
 
 	/// Macroblock type.
-	bitsUsedSoFar = _pMbTypeVlcEnc->Encode(pMb->_mb_type);
+	bitsUsedSoFar = ExpGolombH264::UnsignedBits(pMb->_mb_type);
 
 	/// Intra requires lum and chr prediction modes, Inter requires reference 
 	/// index lists and motion vector diff values.
@@ -6337,8 +7915,8 @@ int H264v2Codec::MacroBlockLayerBitCounter(MacroBlockH264* pMb)
 			numOfVecs = 1;
 		for (int vec = 0; vec < numOfVecs; vec++)
 		{
-			bitsUsedSoFar += _pMbMotionVecDiffVlcEnc->Encode(pMb->_mvdX[vec]);
-			bitsUsedSoFar += _pMbMotionVecDiffVlcEnc->Encode(pMb->_mvdY[vec]);
+			bitsUsedSoFar += ExpGolombH264::SignedBits(pMb->_mvdX[vec]);
+			bitsUsedSoFar += ExpGolombH264::SignedBits(pMb->_mvdY[vec]);
 		}//end for vec...
 	}//end if !_intraFlag...
 	else									/// Intra
@@ -6346,7 +7924,7 @@ int H264v2Codec::MacroBlockLayerBitCounter(MacroBlockH264* pMb)
 		// TODO: Implement Intra_8x8 and Intra_4x4 mode options.
 
 		/// Write chr prediction mode.
-		bitsUsedSoFar += _pMbIChrPredModeVlcEnc->Encode(pMb->_intraChrPredMode);
+		bitsUsedSoFar += ExpGolombH264::UnsignedBits(pMb->_intraChrPredMode);
 	}//end else...
 
 	/// If not Intra_16x16 mode then _coded_blk_pattern must be written.
@@ -6363,7 +7941,7 @@ int H264v2Codec::MacroBlockLayerBitCounter(MacroBlockH264* pMb)
 	if ((pMb->_coded_blk_pattern > 0) || (pMb->_intraFlag && (pMb->_mbPartPredMode == MacroBlockH264::Intra_16x16)))
 	{
 		/// Delta QP.
-		bitsUsedSoFar += _pDeltaQPVlcEnc->Encode(pMb->_mb_qp_delta);
+		bitsUsedSoFar += ExpGolombH264::SignedBits(pMb->_mb_qp_delta);
 	}//end if _coded_blk_pattern...
 
 	/// ------------------ Code the macroblock data --------------------------------------------------------
@@ -6378,36 +7956,34 @@ int H264v2Codec::MacroBlockLayerBitCounter(MacroBlockH264* pMb)
 	for (i = MBH264_LUM_0_0; i <= MBH264_LUM_3_3; i++)
 		pMb->_blkParam[i].dcSkipFlag = dcSkip;
 
+	/// Zig-zag all the blocks and build their significance masks in one pass. The
+	/// bits are counted from the masks without running the CAVLC vlc encoders.
+	_pBlkScan->Scan(pMb);
+
 	for (i = startBlk; i < MBH264_NUM_BLKS; i++)
 	{
 		/// Simplify the block reference.
 		BlockH264* pBlk = pMb->_blkParam[i].pBlk;
 
-		if (pMb->_blkParam[i].pBlk->IsCoded())
+		if (pBlk->IsCoded())
 		{
-			/// Choose the appropriate dimension CAVLC codec. Only 4x4 or 2x2 are expected here.
-			IContextAwareRunLevelCodec* pCAVLC = _pCAVLC2x2;
-			if (((pMb->_blkParam[i].pBlk)->GetHeight() == 4) && ((pMb->_blkParam[i].pBlk)->GetWidth() == 4))
-				pCAVLC = _pCAVLC4x4;
-
 			/// Get num of neighbourhood coeffs as average of above and left block coeffs. Previous
 			/// MB encodings in raster order have already set the num of coeffs.
 			int neighCoeffs = 0;
 			if (pMb->_blkParam[i].neighbourIndicator)
 			{
 				if (pMb->_blkParam[i].neighbourIndicator > 0)
-					neighCoeffs = BlockH264::GetNumNeighbourCoeffs(pMb->_blkParam[i].pBlk);
+					neighCoeffs = BlockH264::GetNumNeighbourCoeffs(pBlk);
 				else	///< Negative values for neighbourIndicator imply pass through.
 					neighCoeffs = pMb->_blkParam[i].neighbourIndicator;
 			}//end if neighbourIndicator...
-			pCAVLC->SetParameter(pCAVLC->NUM_TOT_NEIGHBOR_COEFF_ID, neighCoeffs);	///< Prepare the vlc coder.
-			pCAVLC->SetParameter(pCAVLC->DC_SKIP_FLAG_ID, pMb->_blkParam[i].dcSkipFlag);
 
-			///< Vlc encode and add to stream. The number of coeffs is set here for the blk.
-			bitsUsedSoFar += (pMb->_blkParam[i].pBlk)->RleEncode(pCAVLC, NULL);
+			///< Accumulate the bit count. The number of coeffs is set here for the blk.
+			bitsUsedSoFar += _pBlkScan->BitCount(i, neighCoeffs, pMb->_blkParam[i].dcSkipFlag);
+			pBlk->SetNumCoeffs(_pBlkScan->GetTotalCoeff(i, pMb->_blkParam[i].dcSkipFlag));
 		}//end if IsCoded()...
 		else
-			pMb->_blkParam[i].pBlk->SetNumCoeffs(0);	///< For future use.
+			pBlk->SetNumCoeffs(0);	///< For future use.
 	}//end for i...
 
 	return(bitsUsedSoFar);
@@ -6441,36 +8017,34 @@ int H264v2Codec::MacroBlockLayerCoeffBitCounter(MacroBlockH264* pMb)
 	for (i = MBH264_LUM_0_0; i <= MBH264_LUM_3_3; i++)
 		pMb->_blkParam[i].dcSkipFlag = dcSkip;
 
+	/// Zig-zag all the blocks and build their significance masks in one pass. The
+	/// bits are counted from the masks without running the CAVLC vlc encoders.
+	_pBlkScan->Scan(pMb);
+
 	for (i = startBlk; i < MBH264_NUM_BLKS; i++)
 	{
 		/// Simplify the block reference.
 		BlockH264* pBlk = pMb->_blkParam[i].pBlk;
 
-		if (pMb->_blkParam[i].pBlk->IsCoded())
+		if (pBlk->IsCoded())
 		{
-			/// Choose the appropriate dimension CAVLC codec. Only 4x4 or 2x2 are expected here.
-			IContextAwareRunLevelCodec* pCAVLC = _pCAVLC2x2;
-			if (((pMb->_blkParam[i].pBlk)->GetHeight() == 4) && ((pMb->_blkParam[i].pBlk)->GetWidth() == 4))
-				pCAVLC = _pCAVLC4x4;
-
 			/// Get num of neighbourhood coeffs as average of above and left block coeffs. Previous
 			/// MB encodings in raster order have already set the num of coeffs.
 			int neighCoeffs = 0;
 			if (pMb->_blkParam[i].neighbourIndicator)
 			{
 				if (pMb->_blkParam[i].neighbourIndicator > 0)
-					neighCoeffs = BlockH264::GetNumNeighbourCoeffs(pMb->_blkParam[i].pBlk);
+					neighCoeffs = BlockH264::GetNumNeighbourCoeffs(pBlk);
 				else	///< Negative values for neighbourIndicator imply pass through.
 					neighCoeffs = pMb->_blkParam[i].neighbourIndicator;
 			}//end if neighbourIndicator...
-			pCAVLC->SetParameter(pCAVLC->NUM_TOT_NEIGHBOR_COEFF_ID, neighCoeffs);	///< Prepare the vlc coder.
-			pCAVLC->SetParameter(pCAVLC->DC_SKIP_FLAG_ID, pMb->_blkParam[i].dcSkipFlag);
 
-			///< Vlc encode and accumulate the bit count. The number of coeffs is set here for the blk.
-			bitsUsedSoFar += (pMb->_blkParam[i].pBlk)->RleEncode(pCAVLC, NULL);
+			///< Accumulate the bit count. The number of coeffs is set here for the blk.
+			bitsUsedSoFar += _pBlkScan->BitCount(i, neighCoeffs, pMb->_blkParam[i].dcSkipFlag);
+			pBlk->SetNumCoeffs(_pBlkScan->GetTotalCoeff(i, pMb->_blkParam[i].dcSkipFlag));
 		}//end if IsCoded()...
 		else
-			pMb->_blkParam[i].pBlk->SetNumCoeffs(0);	///< For future use.
+			pBlk->SetNumCoeffs(0);	///< For future use.
 	}//end for i...
 
 	return(bitsUsedSoFar);
@@ -6495,6 +8069,460 @@ int H264v2Codec::ReadMacroBlockLayer(IBitStreamReader* bsr, int remainingBits, i
 	return(0);
 }//end ReadMacroBlockLayer.
 
+/** Extend the reference picture edges into the borders.
+The top and bottom rows of each reference colour component are replicated
+into the H264V2_REF_BORDER lum (H264V2_REF_BORDER/2 chr) rows above and below
+it. Motion vectors that reach vertically into the border beyond the picture
+then read the edge extended pels that the standard defines without bounds
+checks. The row stride remains the picture width as the estimators require.
+Must be called after the in-loop filter has been applied.
+@return	:	none.
+*/
+void H264v2Codec::ExtendReferenceBorder(void)
+{
+	int row;
+	short* pPlane[3] = { _pRLum, _pRChrU, _pRChrV };
+	int width[3] = { _lumWidth, _chrWidth, _chrWidth };
+	int height[3] = { _lumHeight, _chrHeight, _chrHeight };
+	int border[3] = { H264V2_REF_BORDER, H264V2_REF_BORDER / 2, H264V2_REF_BORDER / 2 };
+
+	for (int c = 0; c < 3; c++)
+	{
+		short* pTop = pPlane[c];
+		short* pBot = &(pPlane[c][(height[c] - 1) * width[c]]);
+		size_t rowSize = width[c] * sizeof(short);
+		for (row = 1; row <= border[c]; row++)
+		{
+			memcpy((void *)(pTop - (row * width[c])), (const void *)pTop, rowSize);
+			memcpy((void *)(pBot + (row * width[c])), (const void *)pBot, rowSize);
+		}//end for row...
+	}//end for c...
+
+}//end ExtendReferenceBorder.
+
+/** Select the current reference picture of the ring.
+The reference plane pointers, overlays and the motion estimator used by all the
+coding methods are pointed at the selected ring picture.
+@param index	: Ring picture [0..H264V2_REF_PICS-1].
+@return				: none.
+*/
+void H264v2Codec::SelectReference(int index)
+{
+	_refIndex = index;
+	_pRLum = _pRefPlane[index][0];
+	_pRChrU = _pRefPlane[index][1];
+	_pRChrV = _pRefPlane[index][2];
+	_RefLum = _RefOverlay[index][0];
+	_RefCb = _RefOverlay[index][1];
+	_RefCr = _RefOverlay[index][2];
+	_pMotionEstimator = _pRefMotionEstimator[index];
+}//end SelectReference.
+
+/** Motion compensate a 16x16 macroblock from a ring picture into the current ref.
+The prediction is formed by CompensatePels() from the prev ring picture and is
+written to the macroblock position in the current ref picture that must not be
+the prev picture. This is the only compensator of the codec and is shared by the
+encoder and the decoder so that their reconstructions cannot drift apart.
+@param pMb				: Macroblock to compensate.
+@param prevIndex	: Ring picture to predict from.
+@param mvx				: Horizontal vector in 1/4 pel units.
+@param mvy				: Vertical vector in 1/4 pel units.
+@return						: none.
+*/
+void H264v2Codec::CompensateMb(MacroBlockH264* pMb, int prevIndex, int mvx, int mvy)
+{
+	short* pDst[3] = { _pRLum, _pRChrU, _pRChrV };
+	CompensatePels(_pRefPlane[prevIndex], pDst, _lumWidth, _lumHeight, pMb->_offLumX, pMb->_offLumY, mvx, mvy);
+}//end CompensateMb.
+
+/** Motion compensate the 16x16 lum and 8x8 chr pels of one macroblock.
+The prediction uses the standard 6-tap quarter pel lum and 1/8 pel bilinear
+chr interpolation. Reference pels outside the planes are edge clamped. Only the
+taps that the fractional vector position requires are computed and full pel
+vectors are a copy. The ref and dst planes must not overlap.
+@param pRef				: Lum, Cb and Cr planes to predict from.
+@param pDst				: Lum, Cb and Cr planes to write the prediction into.
+@param lumWidth		: Lum plane width. The chr planes are half in each dimension.
+@param lumHeight	: Lum plane height.
+@param offLumX		: Macroblock lum pel column.
+@param offLumY		: Macroblock lum pel row.
+@param mvx				: Horizontal vector in 1/4 pel units.
+@param mvy				: Vertical vector in 1/4 pel units.
+@return						: none.
+*/
+void H264v2Codec::CompensatePels(short* const pRef[3], short* const pDst[3], int lumWidth, int lumHeight, int offLumX, int offLumY, int mvx, int mvy)
+{
+	int i, j, c;
+
+	/// ------------------------- Lum -----------------------------------------------
+	int x0 = offLumX + (mvx >> 2);
+	int y0 = offLumY + (mvy >> 2);
+	int fx = mvx & 3;
+	int fy = mvy & 3;
+
+	if ((fx == 0) && (fy == 0) && (x0 >= 0) && (y0 >= 0) && ((x0 + 16) <= lumWidth) && ((y0 + 16) <= lumHeight))
+	{
+		/// Full pel vector within the plane.
+		for (i = 0; i < 16; i++)
+			memcpy((void *)(&(pDst[0][((offLumY + i) * lumWidth) + offLumX])), (const void *)(&(pRef[0][((y0 + i) * lumWidth) + x0])), 16 * sizeof(short));
+	}//end if fx...
+	else
+	{
+		int lum[21][21];	///< Edge clamped lum patch with a 2 pel apron before and 3 pels after.
+		for (i = 0; i < 21; i++)
+		{
+			int y = y0 - 2 + i;
+			if (y < 0) y = 0;
+			else if (y >= lumHeight) y = lumHeight - 1;
+			const short* pRow = &(pRef[0][y * lumWidth]);
+			int x = x0 - 2;
+			if ((x >= 0) && ((x + 21) <= lumWidth))
+			{
+				for (j = 0; j < 21; j++)
+					lum[i][j] = pRow[x + j];
+			}//end if x...
+			else
+			{
+				for (j = 0; j < 21; j++, x++)
+					lum[i][j] = pRow[(x < 0) ? 0 : ((x >= lumWidth) ? (lumWidth - 1) : x)];
+			}//end else...
+		}//end for i...
+
+		/// The patch position of the integer pel G at (i, j) is (i + 2, j + 2). The half pels
+		/// are b right of G, h below G, s right of the pel below G and m below the pel right of G.
+		if ((fx == 0) && (fy == 0))
+		{
+			for (i = 0; i < 16; i++)
+			{
+				short* pD = &(pDst[0][((offLumY + i) * lumWidth) + offLumX]);
+				for (j = 0; j < 16; j++)
+					pD[j] = (short)lum[i + 2][j + 2];
+			}//end for i...
+		}//end if fx...
+		else if (fy == 0)
+		{
+			/// Horizontal half pel b only averaged with G or the pel right of G.
+			int a = fx >> 1;
+			for (i = 0; i < 16; i++)
+			{
+				short* pD = &(pDst[0][((offLumY + i) * lumWidth) + offLumX]);
+				const int* pL = lum[i + 2];
+				for (j = 0; j < 16; j++)
+				{
+					int b = H264V2_CLIP255((H264V2_TAP6(pL[j], pL[j + 1], pL[j + 2], pL[j + 3], pL[j + 4], pL[j + 5]) + 16) >> 5);
+					pD[j] = (short)((fx == 2) ? b : ((b + pL[j + 2 + a] + 1) >> 1));
+				}//end for j...
+			}//end for i...
+		}//end else if fy...
+		else if (fx == 0)
+		{
+			/// Vertical half pel h only averaged with G or the pel below G.
+			int a = fy >> 1;
+			for (i = 0; i < 16; i++)
+			{
+				short* pD = &(pDst[0][((offLumY + i) * lumWidth) + offLumX]);
+				for (j = 0; j < 16; j++)
+				{
+					int k = j + 2;
+					int h = H264V2_CLIP255((H264V2_TAP6(lum[i][k], lum[i + 1][k], lum[i + 2][k], lum[i + 3][k], lum[i + 4][k], lum[i + 5][k]) + 16) >> 5);
+					pD[j] = (short)((fy == 2) ? h : ((h + lum[i + 2 + a][k] + 1) >> 1));
+				}//end for j...
+			}//end for i...
+		}//end else if fx...
+		else if ((fx & 1) && (fy & 1))
+		{
+			/// Diagonal average of the horizontal half pel b or s and the vertical half pel h or m.
+			int ay = fy >> 1;
+			int ax = fx >> 1;
+			for (i = 0; i < 16; i++)
+			{
+				short* pD = &(pDst[0][((offLumY + i) * lumWidth) + offLumX]);
+				const int* pL = lum[i + 2 + ay];
+				for (j = 0; j < 16; j++)
+				{
+					int k = j + 2 + ax;
+					int b = H264V2_CLIP255((H264V2_TAP6(pL[j], pL[j + 1], pL[j + 2], pL[j + 3], pL[j + 4], pL[j + 5]) + 16) >> 5);
+					int h = H264V2_CLIP255((H264V2_TAP6(lum[i][k], lum[i + 1][k], lum[i + 2][k], lum[i + 3][k], lum[i + 4][k], lum[i + 5][k]) + 16) >> 5);
+					pD[j] = (short)((b + h + 1) >> 1);
+				}//end for j...
+			}//end for i...
+		}//end else if fx...
+		else
+		{
+			/// Centre half pel j is required with the unscaled horizontal taps of every patch row.
+			int hh[21][16];
+			for (i = 0; i < 21; i++)
+			{
+				const int* pL = lum[i];
+				for (j = 0; j < 16; j++)
+					hh[i][j] = H264V2_TAP6(pL[j], pL[j + 1], pL[j + 2], pL[j + 3], pL[j + 4], pL[j + 5]);
+			}//end for i...
+
+			for (i = 0; i < 16; i++)
+			{
+				short* pD = &(pDst[0][((offLumY + i) * lumWidth) + offLumX]);
+				for (j = 0; j < 16; j++)
+				{
+					int jc = H264V2_CLIP255((H264V2_TAP6(hh[i][j], hh[i + 1][j], hh[i + 2][j], hh[i + 3][j], hh[i + 4][j], hh[i + 5][j]) + 512) >> 10);
+					int p;
+					if (fx == 2)
+					{
+						if (fy == 2)
+							p = jc;
+						else	///< Average with b or s.
+							p = (jc + H264V2_CLIP255((hh[i + 2 + (fy >> 1)][j] + 16) >> 5) + 1) >> 1;
+					}//end if fx...
+					else	///< fy == 2, average with h or m.
+					{
+						int k = j + 2 + (fx >> 1);
+						p = (jc + H264V2_CLIP255((H264V2_TAP6(lum[i][k], lum[i + 1][k], lum[i + 2][k], lum[i + 3][k], lum[i + 4][k], lum[i + 5][k]) + 16) >> 5) + 1) >> 1;
+					}//end else...
+					pD[j] = (short)p;
+				}//end for j...
+			}//end for i...
+		}//end else...
+	}//end else...
+
+	/// ------------------------- Chr -----------------------------------------------
+	int chrWidth = lumWidth / 2;
+	int chrHeight = lumHeight / 2;
+	int offChrX = offLumX / 2;
+	int offChrY = offLumY / 2;
+	int cx0 = offChrX + (mvx >> 3);
+	int cy0 = offChrY + (mvy >> 3);
+	int cfx = mvx & 7;
+	int cfy = mvy & 7;
+	int wA = (8 - cfx) * (8 - cfy);
+	int wB = cfx * (8 - cfy);
+	int wC = (8 - cfx) * cfy;
+	int wD = cfx * cfy;
+	int inside = (cx0 >= 0) && (cy0 >= 0) && ((cx0 + 8) <= chrWidth) && ((cy0 + 8) <= chrHeight);
+	for (c = 1; c < 3; c++)
+	{
+		if (inside && (cfx == 0) && (cfy == 0))
+		{
+			/// Full pel vector within the plane.
+			for (i = 0; i < 8; i++)
+				memcpy((void *)(&(pDst[c][((offChrY + i) * chrWidth) + offChrX])), (const void *)(&(pRef[c][((cy0 + i) * chrWidth) + cx0])), 8 * sizeof(short));
+			continue;
+		}//end if inside...
+
+		int chr[9][9];
+		for (i = 0; i < 9; i++)
+		{
+			int y = cy0 + i;
+			if (y < 0) y = 0;
+			else if (y >= chrHeight) y = chrHeight - 1;
+			const short* pRow = &(pRef[c][y * chrWidth]);
+			for (j = 0; j < 9; j++)
+			{
+				int x = cx0 + j;
+				if (x < 0) x = 0;
+				else if (x >= chrWidth) x = chrWidth - 1;
+				chr[i][j] = pRow[x];
+			}//end for j...
+		}//end for i...
+
+		for (i = 0; i < 8; i++)
+		{
+			short* pD = &(pDst[c][((offChrY + i) * chrWidth) + offChrX]);
+			for (j = 0; j < 8; j++)
+				pD[j] = (short)(((wA * chr[i][j]) + (wB * chr[i][j + 1]) + (wC * chr[i + 1][j]) + (wD * chr[i + 1][j + 1]) + 32) >> 6);
+		}//end for i...
+	}//end for c...
+
+}//end CompensatePels.
+
+/** Allocate the session arena according to the allocation policy.
+Any previous arena is released first. With H264V2_ALLOC_HUGE_PAGES the arena is
+aligned to and sized in huge pages and advised for transparent huge page backing
+on Linux. Elsewhere the flag is ignored. With H264V2_ALLOC_FIRST_TOUCH every page
+is written here so that the kernel places it on the NUMA node of the calling
+thread. Open() the codec on the thread that will Code() with it.
+@param bytes		: Byte size of the arena.
+@return					: 1 = success, 0 = failed.
+*/
+int H264v2Codec::CreateArena(size_t bytes)
+{
+	DestroyArena();
+
+#if defined(__linux__)
+	if (_allocationPolicy & H264V2_ALLOC_HUGE_PAGES)
+	{
+		size_t hugeBytes = (bytes + (H264V2_HUGE_PAGE_SIZE - 1)) & ~((size_t)(H264V2_HUGE_PAGE_SIZE - 1));
+		void* pMem = NULL;
+		if (posix_memalign(&pMem, H264V2_HUGE_PAGE_SIZE, hugeBytes) == 0)
+		{
+			madvise(pMem, hugeBytes, MADV_HUGEPAGE);	///< Advisory only and a failure leaves normal pages.
+			_pArena = (unsigned char *)pMem;
+			_arenaAligned = 1;
+			bytes = hugeBytes;
+		}//end if posix_memalign...
+	}//end if _allocationPolicy...
+#endif
+
+	if (_pArena == NULL)
+		_pArena = new unsigned char[bytes];
+	if (_pArena == NULL)
+		return(0);
+	_arenaSize = bytes;
+
+	if (_allocationPolicy & H264V2_ALLOC_FIRST_TOUCH)
+		memset(_pArena, 0, bytes);
+
+	return(1);
+}//end CreateArena.
+
+/** Release the session arena.
+@return	: none.
+*/
+void H264v2Codec::DestroyArena(void)
+{
+	if (_pArena != NULL)
+	{
+		if (_arenaAligned)
+			free(_pArena);
+		else
+			delete[] _pArena;
+	}//end if _pArena...
+	_pArena = NULL;
+	_arenaAligned = 0;
+	_arenaSize = 0;
+	_arenaPos = 0;
+}//end DestroyArena.
+
+/** Carve an aligned buffer from the session arena.
+The arena is sized in Open() for all the buffers that are carved from it and
+therefore this does not fail for those requests.
+@param bytes		: Byte size of the buffer.
+@return					: Buffer aligned to H264V2_ARENA_ALIGN, NULL if the arena is exhausted.
+*/
+void* H264v2Codec::ArenaAlloc(size_t bytes)
+{
+	size_t base = ((size_t)_pArena + (H264V2_ARENA_ALIGN - 1)) & ~((size_t)(H264V2_ARENA_ALIGN - 1));
+	size_t start = (base - (size_t)_pArena) + _arenaPos;
+	if ((_pArena == NULL) || ((start + ArenaBytes(bytes)) > _arenaSize))
+		return(NULL);
+	_arenaPos += ArenaBytes(bytes);
+	return((void *)(&(_pArena[start])));
+}//end ArenaAlloc.
+
+/** Load the visible input picture from caller strided planes.
+The planes are read in place row by row into the input picture planes and
+flipped vertically if required. Edge extension to the coded size is not
+done here.
+@param pIn			: Caller plane descriptor.
+@param is8Bit		: Planes hold 8 bit pels, otherwise 16 bit pels.
+@return					: none.
+*/
+void H264v2Codec::LoadInputPlanes(H264V2_PLANES* pIn, int is8Bit)
+{
+	int c, row;
+	void*	pSrc[3]	= { pIn->pY, pIn->pU, pIn->pV };
+	int		stride[3]	= { pIn->strideY, pIn->strideU, pIn->strideV };
+	short* pDst[3]	= { _pLum, _pChrU, _pChrV };
+	int		dstStride[3] = { _lumWidth, _chrWidth, _chrWidth };
+	int		width[3]	= { _width, _width / 2, _width / 2 };
+	int		height[3]	= { _height, _height / 2, _height / 2 };
+
+	for (c = 0; c < 3; c++)
+	{
+		for (row = 0; row < height[c]; row++)
+		{
+			int srow = _flip ? (height[c] - 1 - row) : row;
+			if (is8Bit)
+				PelsFrom8Bit(&(((unsigned char *)pSrc[c])[srow * stride[c]]), &(pDst[c][row * dstStride[c]]), width[c]);
+			else
+				memcpy((void *)(&(pDst[c][row * dstStride[c]])), (const void *)(&(((short *)pSrc[c])[srow * stride[c]])), width[c] * sizeof(short));
+		}//end for row...
+	}//end for c...
+
+}//end LoadInputPlanes.
+
+/** Store the visible decoded picture into caller strided planes.
+The planes are written row by row from the ref planes at the crop origin. There
+is no vertical flip, consistent with the packed YUV outputs.
+@param pOut			: Caller plane descriptor.
+@param pY				: Ref lum top left visible pel.
+@param pU				: Ref chr U top left visible pel.
+@param pV				: Ref chr V top left visible pel.
+@param is8Bit		: Planes hold 8 bit pels, otherwise 16 bit pels.
+@return					: none.
+*/
+void H264v2Codec::StoreOutputPlanes(H264V2_PLANES* pOut, short* pY, short* pU, short* pV, int is8Bit)
+{
+	int c, row;
+	short*	pSrc[3]	= { pY, pU, pV };
+	int		srcStride[3] = { _lumWidth, _chrWidth, _chrWidth };
+	void*	pDst[3]	= { pOut->pY, pOut->pU, pOut->pV };
+	int		stride[3]	= { pOut->strideY, pOut->strideU, pOut->strideV };
+	int		width[3]	= { _width, _width / 2, _width / 2 };
+	int		height[3]	= { _height, _height / 2, _height / 2 };
+
+	for (c = 0; c < 3; c++)
+	{
+		if (is8Bit)
+		{
+			for (row = 0; row < height[c]; row++)
+				PelsTo8Bit(&(pSrc[c][row * srcStride[c]]), &(((unsigned char *)pDst[c])[row * stride[c]]), width[c]);
+		}//end if is8Bit...
+		else
+			CopyPlane(pSrc[c], srcStride[c], (short *)pDst[c], stride[c], width[c], height[c]);
+	}//end for c...
+
+}//end StoreOutputPlanes.
+
+/** Copy a colour component between planes of differing strides.
+@param pSrc				: Source top left pel.
+@param srcStride	: Source row length in pels.
+@param pDst				: Destination top left pel.
+@param dstStride	: Destination row length in pels.
+@param width			: Pels per row to copy.
+@param height			: Rows to copy.
+@return						: none.
+*/
+void H264v2Codec::CopyPlane(const short* pSrc, int srcStride, short* pDst, int dstStride, int width, int height)
+{
+	if ((srcStride == width) && (dstStride == width))
+	{
+		memcpy((void *)pDst, (const void *)pSrc, width * height * sizeof(short));
+		return;
+	}//end if srcStride...
+
+	for (int row = 0; row < height; row++)
+		memcpy((void *)(&(pDst[row * dstStride])), (const void *)(&(pSrc[row * srcStride])), width * sizeof(short));
+}//end CopyPlane.
+
+/** Edge extend a visible colour component out to its coded size.
+The visible region at the top left of the plane is extended to the right by
+replicating the last pel of each row and downwards by replicating the last row.
+@param pPlane			: Plane of the coded dimensions.
+@param visWidth		: Visible width.
+@param visHeight	: Visible height.
+@param width			: Coded width (and row stride).
+@param height			: Coded height.
+@return						: none.
+*/
+void H264v2Codec::PadPlane(short* pPlane, int visWidth, int visHeight, int width, int height)
+{
+	int row, col;
+
+	if (visWidth < width)
+	{
+		for (row = 0; row < visHeight; row++)
+		{
+			short* p = &(pPlane[row * width]);
+			short edge = p[visWidth - 1];
+			for (col = visWidth; col < width; col++)
+				p[col] = edge;
+		}//end for row...
+	}//end if visWidth...
+
+	short* pLast = &(pPlane[(visHeight - 1) * width]);
+	for (row = visHeight; row < height; row++)
+		memcpy((void *)(&(pPlane[row * width])), (const void *)pLast, width * sizeof(short));
+}//end PadPlane.
+
 /** Apply the in-loop edge filter.
 Used in both the encoder and decoder to remove blocking artefacts on the 4x4 boundary
 edges. It is applied macroblock by macroblock in raster scan order to the reference
@@ -9222,8 +11250,8 @@ of the image as the norm constant.
 */
 double H264v2Codec::NormalisationConstant(H264V2_COORD fpt)
 {
-  int bWidth = _width / 16;
-  int bHeight = _height / 16;
+  int bWidth = _lumWidth / 16;
+  int bHeight = _lumHeight / 16;
 
   double norm = EuclidianDistance(fpt, H264V2_COORD{ 0, 0 });  ///< Default with upper left.
 
@@ -9529,9 +11557,9 @@ int H264v2Codec::IntraImgPlaneEncoderImplMinMax::Encode(int allowedBits, int* bi
 
 		/// Accumulate the rate and find the largest (max) distortion of all macroblocks.
 		Rl += _codec->ProcessIntraMbImplStd(pMb, 1);
-		if (pMb->_distortion[H264V2_MAX_QP] > Dl)
+		if (_codec->MbDistortion(mb, H264V2_MAX_QP) > Dl)
 		{
-			Dl = pMb->_distortion[H264V2_MAX_QP];
+			Dl = _codec->MbDistortion(mb, H264V2_MAX_QP);
 			mbDmax = mb;	///< Mark the macroblock with the peak distortion.
 		}//end if _distortion...
 
@@ -9617,7 +11645,7 @@ int H264v2Codec::IntraImgPlaneEncoderImplMinMax::Encode(int allowedBits, int* bi
 
 				/// If the previous neighbourhood has not changed and QP is the same as the last encoding of this blk
 				/// then it does not have to be re-encoded assuming distortion < Dmax.
-				if ((mb >= firstMbChange) || (_pQ[mb] != pMb->_mbEncQP) || (pMb->_distortion[_pQ[mb]] > Dmax))
+				if ((mb >= firstMbChange) || (_pQ[mb] != pMb->_mbEncQP) || (_codec->MbDistortion(mb, _pQ[mb]) > Dmax))
 				{
 					/// Record the found QP where the macroblock dist is just below Dmax and accumulate the rate for this macroblock.
 					pMb->_mbQP = _pQ[mb];
@@ -9631,7 +11659,7 @@ int H264v2Codec::IntraImgPlaneEncoderImplMinMax::Encode(int allowedBits, int* bi
 						firstMbChange = mb;
 				}//end if mb...
 				else
-					R += pMb->_rate[_pQ[mb]];
+					R += _codec->MbRate(mb, _pQ[mb]);
 
 				/// An accurate early exit strategy is not possible because the model prediction require two valid (Dmax,R) points 
 				/// for the whole frame. 
@@ -9863,7 +11891,7 @@ int H264v2Codec::IntraImgPlaneEncoderImplMinMax::DamageControl(int allowedBits,
 				}//end while _distortion[]...
 
 				/// Add back new bits.
-				pMb->_rate[pMb->_mbEncQP] = _codec->MacroBlockLayerBitCounter(pMb);
+				_codec->SetMbRate(pMb, pMb->_mbEncQP, _codec->MacroBlockLayerBitCounter(pMb));
 				predR += pMb->_rate[pMb->_mbEncQP];
 
 			}//end if d1...
@@ -10146,8 +12174,8 @@ int H264v2Codec::GetMbQPBelowDmax(MacroBlockH264 &mb, int atQP, int Dmax, int de
 int H264v2Codec::GetMbQPBelowDmaxVer2(MacroBlockH264 &mb, int atQ, int Dmax, int* changeMb, int lowestQ, bool intra)
 {
 	int i = atQ;
-	int	di = mb._distortion[i];
 	int mbIndex = mb._mbIndex;
+	int	di = MbDistortion(mbIndex, i);
 	int lclChangeMb = *changeMb;
 
 	/// The delta QP for a mb is constrained to {-26...25}. Therefore if
@@ -10214,10 +12242,10 @@ int H264v2Codec::GetMbQPBelowDmaxVer2(MacroBlockH264 &mb, int atQ, int Dmax, int
 		int rate = 0;
 		if (!mb._skip)
 			rate = MacroBlockLayerBitCounter(&mb);  ///< Process mb for new neighbour coeffs values.
-		mb._rate[mb._mbEncQP] = rate;             ///< Update this new rate.
+		SetMbRate(&mb, mb._mbEncQP, rate);            ///< Update this new rate.
 	}//end if !intra...
 	else
-		mb._rate[mb._mbEncQP] = MacroBlockLayerBitCounter(&mb);
+		SetMbRate(&mb, mb._mbEncQP, MacroBlockLayerBitCounter(&mb));
 
 	/// Return QP value where dist just less than Dmax for this macroblock.
 	*changeMb = lclChangeMb;
@@ -10237,8 +12265,8 @@ This method includes extended QP values = {52..71}.
 int H264v2Codec::GetMbQPBelowDmaxVer3(MacroBlockH264 &mb, int atQ, int Dmax, int* changeMb, int lowestQ, bool intra)
 {
 	int i = atQ;
-	int	di = mb._distortion[i];
 	int mbIndex = mb._mbIndex;
+	int	di = MbDistortion(mbIndex, i);
 	int lclChangeMb = *changeMb;
 
 	/// Macroblocks are dependent on (predicted from) previous macroblocks in the slice. If
@@ -10261,7 +12289,7 @@ int H264v2Codec::GetMbQPBelowDmaxVer3(MacroBlockH264 &mb, int atQ, int Dmax, int
 				mb._mb_qp_delta = GetDeltaQP(&mb);        ///< Process new delta QP.
 				if (!mb._skip)
 					rate = MacroBlockLayerBitCounter(&mb);  ///< Process mb for new neighbour coeffs values.
-				mb._rate[mb._mbEncQP] = rate;             ///< Update this new rate.
+				SetMbRate(&mb, mb._mbEncQP, rate);            ///< Update this new rate.
 
 				mb._mbQP = i;                             ///< Put it back.
 			}//end if _mbEncQP...
@@ -10482,7 +12510,7 @@ int H264v2Codec::ProcessIntraMbImplStd(MacroBlockH264* pMb, int withDR)
 	int cOffY = pMb->_offChrY;
 
 	/// Base settings for all intra macroblocks.
-	pMb->_skip = 0;
+	SetMbSkip(pMb, 0);
 	pMb->_intraFlag = 1;
 
 	///------------------- Image prediction and loading ----------------------------------------
@@ -10569,7 +12597,7 @@ int H264v2Codec::ProcessIntraMbImplStd(MacroBlockH264* pMb, int withDR)
 
 	/// --------------------- Set distortion -------------------------------------------------
 	if (withDR)
-		pMb->_distortion[pMb->_mbEncQP] = mbDistortion;
+		SetMbDistortion(pMb, pMb->_mbEncQP, mbDistortion);
 
 	/// --------------------- Image Storing into Ref -----------------------------------------
 	/// Fill the ref (difference) lum and chr from all the non-DC 4x4 
@@ -10605,7 +12633,7 @@ int H264v2Codec::ProcessIntraMbImplStd(MacroBlockH264* pMb, int withDR)
 	/// ------------------ Calc the Rate and store results -----------------------------------------
 	/// Store rate for this quant value.
 	if (withDR == 1) ///< For withDR = 2, no rate calculation is done.
-		pMb->_rate[pMb->_mbEncQP] = MacroBlockLayerBitCounter(pMb);
+		SetMbRate(pMb, pMb->_mbEncQP, MacroBlockLayerBitCounter(pMb));
 
 	return(pMb->_rate[pMb->_mbEncQP]);
 }//end ProcessIntraMbImplStd.
@@ -10633,7 +12661,7 @@ int H264v2Codec::ProcessIntraMbImplStd(MacroBlockH264* pMb, int withDR, int useP
 	int cOffY = pMb->_offChrY;
 
 	/// Base settings for all intra macroblocks.
-	pMb->_skip = 0;
+	SetMbSkip(pMb, 0);
 	pMb->_intraFlag = 1;
 
 	///------------------- Image prediction and loading ----------------------------------------
@@ -10765,7 +12793,7 @@ int H264v2Codec::ProcessIntraMbImplStd(MacroBlockH264* pMb, int withDR, int useP
 
 	/// --------------------- Set distortion -------------------------------------------------
   if (withDR)
-    pMb->_distortion[pMb->_mbEncQP] = mbDistortion;
+    SetMbDistortion(pMb, pMb->_mbEncQP, mbDistortion);
 
 	/// --------------------- Image Storing into Ref -----------------------------------------
 	/// Fill the ref (difference) lum and chr from all the non-DC 4x4 
@@ -10801,7 +12829,7 @@ int H264v2Codec::ProcessIntraMbImplStd(MacroBlockH264* pMb, int withDR, int useP
 	/// ------------------ Calc the Rate and store results -----------------------------------------
 	/// Store rate for this quant value.
 	if (withDR == 1) ///< For withDR = 2, no rate calculation is done.
-		pMb->_rate[pMb->_mbEncQP] = MacroBlockLayerBitCounter(pMb);
+		SetMbRate(pMb, pMb->_mbEncQP, MacroBlockLayerBitCounter(pMb));
 
 	return(pMb->_rate[pMb->_mbEncQP]);
 }//end ProcessIntraMbImplStd.
@@ -10841,7 +12869,7 @@ int H264v2Codec::ProcessIntraMbImplStd(MacroBlockH264* pMb, int withDR, int useP
 	int cOffY = pMb->_offChrY;
 
 	/// Base settings for all intra macroblocks.
-	pMb->_skip = 0;
+	SetMbSkip(pMb, 0);
 	pMb->_intraFlag = 1;
 
 	///------------------- Image prediction and loading ----------------------------------------
@@ -10956,7 +12984,7 @@ int H264v2Codec::ProcessIntraMbImplStd(MacroBlockH264* pMb, int withDR, int useP
   /// used in the feedback loop. The mb QP will change during the TransAndQuantIntra16x16MBlk() 
   /// method call.
 	if (pMb->_mbPartPredMode == MacroBlockH264::Intra_16x16)
-		pMb->_distortion[pMb->_mbEncQP] = TransAndQuantIntra16x16MBlk(pMb, Dmax, lowQP);
+		SetMbDistortion(pMb, pMb->_mbEncQP, TransAndQuantIntra16x16MBlk(pMb, Dmax, lowQP));
 
 	/// ------------------ Feedback loop -------------------------------------------------------
 
@@ -10998,9 +13026,9 @@ int H264v2Codec::ProcessIntraMbImplStd(MacroBlockH264* pMb, int withDR, int useP
 	if (withDR == 1) ///< For withDR = 2, no rate calculation is done.
 	{
 		if ((_modeOfOperation == H264V2_MINMAX_RATECNT)|| (_modeOfOperation == H264V2_MINAVG_RATECNT)) ///< Requires coeff bits without the mb header bits.
-			pMb->_rate[pMb->_mbEncQP] = MacroBlockLayerCoeffBitCounter(pMb);
+			SetMbRate(pMb, pMb->_mbEncQP, MacroBlockLayerCoeffBitCounter(pMb));
 		else
-			pMb->_rate[pMb->_mbEncQP] = MacroBlockLayerBitCounter(pMb);
+			SetMbRate(pMb, pMb->_mbEncQP, MacroBlockLayerBitCounter(pMb));
 	}//end if withDR...
 
 	return(pMb->_rate[pMb->_mbEncQP]);
@@ -11181,7 +13209,7 @@ int H264v2Codec::ProcessIntraMbImplStdMin(MacroBlockH264* pMb)
 
 	/// Base settings for all intra macroblocks.
 	pMb->_mbQP = H264V2_MAX_QP;
-	pMb->_skip = 0;
+	SetMbSkip(pMb, 0);
 	pMb->_intraFlag = 1;
 
 	///------------------- Image prediction and loading ----------------------------------------
@@ -11294,10 +13322,10 @@ int H264v2Codec::InterImgPlaneEncoderImplStdVer1::Encode(int allowedBits, int* b
 	/// By default the DC transforms were set in the TransformOnly mode in the Open() method.
 
 	/// Motion estimation has been previously performed outside of this method and therefore
-	/// only motion compensation is required here. Prepare for motion compensation on a per 
-	/// macoblock basis. The vectors themselves are held in _pMotionEstimationResult.
-	if (compRef)
-		_codec->_pMotionCompensator->PrepareForSingleVectorMode();
+	/// only motion compensation is required here. Predictions are read from the previous
+	/// ring picture and written into the current one per macroblock. The vectors 
+	/// themselves are held in _pMotionEstimationResult.
+	int prevRef = (_codec->_refIndex + H264V2_REF_PICS - 1) % H264V2_REF_PICS;
 
 	/// Get the motion vector list to work with. Assume SIMPLE2D type list as only a
 	/// single 16x16 motion vector is considered per macroblock in this implementation
@@ -11377,7 +13405,7 @@ int H264v2Codec::InterImgPlaneEncoderImplStdVer1::Encode(int allowedBits, int* b
 		int mvx = _codec->_pMotionEstimationResult->GetSimpleElement(mb, 0);
 		int mvy = _codec->_pMotionEstimationResult->GetSimpleElement(mb, 1);
 		if (compRef)
-			_codec->_pMotionCompensator->Compensate(pMb->_offLumX, pMb->_offLumY, mvx, mvy);
+			_codec->CompensateMb(pMb, prevRef, mvx, mvy);
 
 		/////////////////////////////////////////////////////////////////////////////////////////////
 		/// Research Data Collection: Mb data capture.
@@ -11499,7 +13527,7 @@ int H264v2Codec::ProcessInterMbImplStd(MacroBlockH264* pMb, int addRef, int with
 	int cOffY = pMb->_offChrY;
 
 	/// Base settings for all inter macroblocks.
-	pMb->_skip = 0;
+	SetMbSkip(pMb, 0);
 	pMb->_intraFlag = 0;
 
 	/// Subtract the ref (compensated) macroblock from the input macroblock and place it in the temp image blocks.
@@ -11625,13 +13653,13 @@ int H264v2Codec::ProcessInterMbImplStd(MacroBlockH264* pMb, int addRef, int with
 		if (MacroBlockH264::SkippedZeroMotionPredCondition(pMb))
 		{
 			if ((pMb->_mvX[MacroBlockH264::_16x16] == 0) && (pMb->_mvY[MacroBlockH264::_16x16] == 0))
-				pMb->_skip = 1;
+				SetMbSkip(pMb, 1);
 		}//end if SkippedZeroMotionPredCondition...
 		/// Second condition is dependent on the previously calculated median difference motion vector.
 		else
 		{
 			if ((pMb->_mvdX[MacroBlockH264::_16x16] == 0) && (pMb->_mvdY[MacroBlockH264::_16x16] == 0))
-				pMb->_skip = 1;
+				SetMbSkip(pMb, 1);
 		}//end else...
 	}//end _coded_blk_pattern...
 
@@ -11706,7 +13734,7 @@ int H264v2Codec::ProcessInterMbImplStd(MacroBlockH264* pMb, int addRef, int with
 #endif
     /// Modify the distortion with the region of interest map.
     distortion = ROIDistortion(pMb->_mbIndex, distortion);
-		pMb->_distortion[pMb->_mbEncQP] = distortion;
+		SetMbDistortion(pMb, pMb->_mbEncQP, distortion);
 
 		//    if(!pMb->_skip)
 		//		  rate = MacroBlockLayerBitCounter(pMb);
@@ -11725,7 +13753,7 @@ int H264v2Codec::ProcessInterMbImplStd(MacroBlockH264* pMb, int addRef, int with
 	if ((withDR == 1) && (!pMb->_skip)) ///< For withDR = 2, no rate calculation is done.
 	{
 		rate = MacroBlockLayerBitCounter(pMb);
-		pMb->_rate[pMb->_mbEncQP] = rate;
+		SetMbRate(pMb, pMb->_mbEncQP, rate);
 	}//end if withDR...
 
 	return(rate);
@@ -11772,7 +13800,7 @@ int H264v2Codec::ProcessInterMbImplStd(MacroBlockH264* pMb, int addRef, int with
 	int cOffY = pMb->_offChrY;
 
 	/// Base settings for all inter macroblocks.
-	pMb->_skip = 0;
+	SetMbSkip(pMb, 0);
 	pMb->_intraFlag = 0;
 
 	/// Subtract the ref (compensated) macroblock from the input macroblock and place it in the temp image blocks.
@@ -11840,7 +13868,7 @@ int H264v2Codec::ProcessInterMbImplStd(MacroBlockH264* pMb, int addRef, int with
   /// Includes the distortion calc and the inverse quant and transform to the temp blks. For 
   /// extended range QP > H264V2_MAX_QP the appropriate coeffs are zeroed. 
 	if (pMb->_mbPartPredMode == MacroBlockH264::Inter_16x16)
-		pMb->_distortion[pMb->_mbEncQP] = TransAndQuantInter16x16MBlk(pMb, Dmax, lowQP);
+		SetMbDistortion(pMb, pMb->_mbEncQP, TransAndQuantInter16x16MBlk(pMb, Dmax, lowQP));
 
 	/// ------------------ Set patterns and type -----------------------------------------------
 	/// Determine the coded Lum and Chr patterns. The _codedBlkPatternLum, _codedBlkPatternChr 
@@ -11866,13 +13894,13 @@ int H264v2Codec::ProcessInterMbImplStd(MacroBlockH264* pMb, int addRef, int with
 		if (MacroBlockH264::SkippedZeroMotionPredCondition(pMb))
 		{
 			if ((pMb->_mvX[MacroBlockH264::_16x16] == 0) && (pMb->_mvY[MacroBlockH264::_16x16] == 0))
-				pMb->_skip = 1;
+				SetMbSkip(pMb, 1);
 		}//end if SkippedZeroMotionPredCondition...
 		/// Second condition is dependent on the previously calculated median difference motion vector.
 		else
 		{
 			if ((pMb->_mvdX[MacroBlockH264::_16x16] == 0) && (pMb->_mvdY[MacroBlockH264::_16x16] == 0))
-				pMb->_skip = 1;
+				SetMbSkip(pMb, 1);
 		}//end else...
 	}//end _coded_blk_pattern...
 
@@ -11933,7 +13961,7 @@ int H264v2Codec::ProcessInterMbImplStd(MacroBlockH264* pMb, int addRef, int with
 		if ((withDR == 1) || (withDR == 3)) ///< For withDR = 2, no rate calculation is done.
 		{
 			rate = MacroBlockLayerCoeffBitCounter(pMb);
-			pMb->_rate[pMb->_mbEncQP] = rate;
+			SetMbRate(pMb, pMb->_mbEncQP, rate);
 		}//end if withDR...
 	}//end if !skip...
 
@@ -11951,7 +13979,7 @@ int H264v2Codec::ProcessInterMbImplStdMin(MacroBlockH264* pMb)
 
 	/// Base settings for all inter macroblocks.
 	pMb->_intraFlag = 0;
-	pMb->_skip = 0;
+	SetMbSkip(pMb, 0);
 
 	/// Clear the delta quantisation parameter and set the _mbQP to the same as the previous non-skipped mb. The
   /// _mbQP does not have any impact because all coeffs are set to zero.
@@ -12005,13 +14033,13 @@ int H264v2Codec::ProcessInterMbImplStdMin(MacroBlockH264* pMb)
 		if (MacroBlockH264::SkippedZeroMotionPredCondition(pMb))
 		{
 			if ((pMb->_mvX[MacroBlockH264::_16x16] == 0) && (pMb->_mvY[MacroBlockH264::_16x16] == 0))
-				pMb->_skip = 1;
+				SetMbSkip(pMb, 1);
 		}//end if SkippedZeroMotionPredCondition...
 		/// Second condition is dependent on the previously calculated median difference motion vector.
 		else
 		{
 			if ((pMb->_mvdX[MacroBlockH264::_16x16] == 0) && (pMb->_mvdY[MacroBlockH264::_16x16] == 0))
-				pMb->_skip = 1;
+				SetMbSkip(pMb, 1);
 		}//end else...
 	}//end _coded_blk_pattern...
 
@@ -12024,7 +14052,7 @@ int H264v2Codec::ProcessInterMbImplStdMin(MacroBlockH264* pMb)
 			pMb->_blkParam[i].pBlk->SetNumCoeffs(0);
 	}//end else...
 
-	pMb->_rate[0] = rate;
+	SetMbRate(pMb, 0, rate);
 
 	return(rate);
 }//end ProcessInterMbImplStdMin.
@@ -12071,6 +14099,46 @@ int H264v2Codec::GetDeltaQP(MacroBlockH264* pMb)
 	return(deltaQP);
 }//end GetDeltaQP.
 
+/** Store the macroblock distortion at a QP value.
+The frame wide [qp][mb] table is kept consistent with the macroblock member.
+@param pMb    : Macroblock to operate on.
+@param qp     : QP index.
+@param d      : Distortion.
+@return       : none.
+*/
+void H264v2Codec::SetMbDistortion(MacroBlockH264* pMb, int qp, int d)
+{
+	pMb->_distortion[qp] = d;
+	_pMbDistortion[(qp * _mbLength) + pMb->_mbIndex] = d;
+}//end SetMbDistortion.
+
+/** Store the macroblock rate at a QP value.
+The frame wide [qp][mb] table is kept consistent with the macroblock member.
+@param pMb    : Macroblock to operate on.
+@param qp     : QP index.
+@param r      : Rate in bits.
+@return       : none.
+*/
+void H264v2Codec::SetMbRate(MacroBlockH264* pMb, int qp, int r)
+{
+	pMb->_rate[qp] = r;
+	_pMbRate[(qp * _mbLength) + pMb->_mbIndex] = r;
+}//end SetMbRate.
+
+/** Store the macroblock skip flag.
+All encoder writes to _skip go through here so that the frame wide skip table read
+by MbSkip() is never stale. The table only exists in encoder sessions.
+@param pMb    : Macroblock to operate on.
+@param skip   : Skip flag.
+@return       : none.
+*/
+void H264v2Codec::SetMbSkip(MacroBlockH264* pMb, int skip)
+{
+	pMb->_skip = skip;
+	if (_pMbSkip != NULL)
+		_pMbSkip[pMb->_mbIndex] = (unsigned char)(skip != 0);
+}//end SetMbSkip.
+
 /** Get the previous macroblock QP value.
 Picture and slice boundaries are considered in returning the
 neighbouring mb QP value.
@@ -12183,9 +14251,8 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::Encode(int allowedBits, int* bi
 		return(0);	///< Error: Motion vector list must match.
 	}//end if listLen...
 
-	/// Prepare the compensation on a per macroblock basis.
-	if (compRef)
-		_codec->_pMotionCompensator->PrepareForSingleVectorMode();
+	/// Predictions are read from the previous ring picture per macroblock.
+	int prevRef = (_codec->_refIndex + H264V2_REF_PICS - 1) % H264V2_REF_PICS;
 
 	/// Count the bits used for the motion vectors by iterating through the
 	/// macroblocks and encoding the differential motion vector diff (_mvdX,_mvdY). 
@@ -12195,7 +14262,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::Encode(int allowedBits, int* bi
 	int bitCost = 0;
 	int mbSkipRun = 0;
 	/// Start with all mbs skipped to the end by counting bits for mbSkipRun = len;
-	int minPictureBitsToEnd = _codec->_pHeaderUnsignedVlcEnc->Encode(len);
+	int minPictureBitsToEnd = ExpGolombH264::UnsignedBits(len);
 	for (mb = 0; mb < len; mb++)
 	{
 		MacroBlockH264* pMb = &(_codec->_pMb[mb]);  ///< Simplify mb addressing.
@@ -12216,7 +14283,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::Encode(int allowedBits, int* bi
 
 		/// Motion compensate the macroblock.
 		if (compRef)
-			_codec->_pMotionCompensator->Compensate(pMb->_offLumX, pMb->_offLumY, mvx, mvy);
+			_codec->CompensateMb(pMb, prevRef, mvx, mvy);
 
 		int lclAllowedBits = (allowedBits - bitCost) - minPictureBitsToEnd;	///< So far before encoding this MVD pair.
 
@@ -12227,7 +14294,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::Encode(int allowedBits, int* bi
 		if (!pMb->_skip)
 		{
 			/// Sum the run and coding bit contributions.
-			lclBitCost += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+			lclBitCost += ExpGolombH264::UnsignedBits(mbSkipRun);
 
 			/// Are there enough bits left to encode this run + MVD pair?
 			if (lclBitCost < lclAllowedBits)
@@ -12250,7 +14317,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::Encode(int allowedBits, int* bi
 		/// Update remaining bits for next mb where all remaining mbs are skipped.
 		int mbSkippedToEnd = mbSkipRun + ((len - 1) - mb);
 		if (mbSkippedToEnd)
-			minPictureBitsToEnd = _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkippedToEnd);
+			minPictureBitsToEnd = ExpGolombH264::UnsignedBits(mbSkippedToEnd);
 		else
 			minPictureBitsToEnd = 0;
 	}//end for mb...
@@ -12301,15 +14368,15 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::Encode(int allowedBits, int* bi
 		if (!pMb->_skip)
 		{
 			/// Sum of skip run and coded mb bits accumulated.
-			Rl += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+			Rl += ExpGolombH264::UnsignedBits(mbSkipRun);
 			mbSkipRun = 0;
 		}//end if !_skip...
 		else
 			mbSkipRun++;
 
-		if (pMb->_distortion[H264V2_MAX_QP] > Dl)
+		if (_codec->MbDistortion(mb, H264V2_MAX_QP) > Dl)
 		{
-			Dl = pMb->_distortion[H264V2_MAX_QP];
+			Dl = _codec->MbDistortion(mb, H264V2_MAX_QP);
 			mbDmax = mb;	///< Mark the mb index with the peak distortion.
 		}//end if _distortion...
 
@@ -12318,7 +14385,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::Encode(int allowedBits, int* bi
 	}//end for mb...
   /// Add last skip run.
 	if (mbSkipRun)
-		Rl += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+		Rl += ExpGolombH264::UnsignedBits(mbSkipRun);
 
 	/// Set the limits on the number of optimisation iterations by a timer or iteration number. Take into
   /// account the time taken to get to this point from _startTimer but exclude the motion estimation time
@@ -12392,11 +14459,11 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::Encode(int allowedBits, int* bi
 
 				/// Record the found QP where the macroblock dist is just below Dmax and accumulate the rate for this macroblock.
 				_pQ[mb] = _codec->GetMbQPBelowDmaxVer2(*pMb, _pQ[mb], Dmax, &firstMbChange, qEnd, false);
-				R += pMb->_rate[_pQ[mb]]; ///< Rate = 0 for skipped mbs.
-				if (!pMb->_skip)
+				R += _codec->MbRate(mb, _pQ[mb]); ///< Rate = 0 for skipped mbs.
+				if (!_codec->MbSkip(mb))
 				{
 					/// Sum of skip run and coded mb bits accumulated.
-					R += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+					R += ExpGolombH264::UnsignedBits(mbSkipRun);
 					mbSkipRun = 0;
 				}//end if !_skip...
 				else
@@ -12408,7 +14475,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::Encode(int allowedBits, int* bi
 			}//end for mb...
 	    /// Add last skip run.
 			if (mbSkipRun)
-				R += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+				R += ExpGolombH264::UnsignedBits(mbSkipRun);
 
 			/// Test the stopping criteria.
 			int timeExceeded = 0;
@@ -12518,7 +14585,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::Encode(int allowedBits, int* bi
 			bitCount += _codec->ProcessInterMbImplStdMin(pMb);
 		if (!pMb->_skip)
 		{
-			bitCount += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+			bitCount += ExpGolombH264::UnsignedBits(mbSkipRun);
 			mbSkipRun = 0;
 		}//end if !_skip...
 		else
@@ -12527,7 +14594,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::Encode(int allowedBits, int* bi
 	}//end for mb...
   /// Add last skip run.
 	if (mbSkipRun)
-		bitCount += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+		bitCount += ExpGolombH264::UnsignedBits(mbSkipRun);
 
 	*bitsUsed = 0;
 	int ret = 1;
@@ -12558,6 +14625,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControlMvOnly(int allowed
 	int len = _codec->_mbLength;
 	int bitCost = 0;
 	int mbSkipRun = 0;
+	int prevRef = (_codec->_refIndex + H264V2_REF_PICS - 1) % H264V2_REF_PICS;	///< Predictions are from the previous ring picture.
 	for (mb = 0; mb < len; mb++)
 	{
 		MacroBlockH264* pMb = &(_codec->_pMb[mb]);  ///< Simplify mb addressing.
@@ -12568,27 +14636,23 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControlMvOnly(int allowed
 		/// Extract the 16x16 vector from the motion estimation result list.
 		int mvx = _codec->_pMotionEstimationResult->GetSimpleElement(mb, 0);
 		int mvy = _codec->_pMotionEstimationResult->GetSimpleElement(mb, 1);
-		int topLeftX = pMb->_offLumX;
-		int topLeftY = pMb->_offLumY;
 		/// Get the predicted motion vector for this mb as the median of the neighbourhood vectors.
 		int predX, predY;
 		MacroBlockH264::GetMbMotionMedianPred(pMb, &predX, &predY);
 
 		/// Compensate with the pred mv and measure the mb distortion.
-		_codec->_pMotionCompensator->Invalidate();
-		_codec->_pMotionCompensator->Compensate(topLeftX, topLeftY, predX, predY);
+		_codec->CompensateMb(pMb, prevRef, predX, predY);
 		int distortion = pMb->Distortion(_codec->_RefLum, _codec->_RefCb, _codec->_RefCr, _codec->_Lum, _codec->_Cb, _codec->_Cr);
 
 		if ((mvx != predX) || (mvy != predY))  ///< Only if the estimated mv and the pred mv are not already equal.
 		{
-			_codec->_pMotionCompensator->Invalidate();
-			_codec->_pMotionCompensator->Compensate(topLeftX, topLeftY, mvx, mvy);
-			pMb->_distortion[0] = pMb->Distortion(_codec->_RefLum, _codec->_RefCb, _codec->_RefCr, _codec->_Lum, _codec->_Cb, _codec->_Cr);
+			_codec->CompensateMb(pMb, prevRef, mvx, mvy);
+			_codec->SetMbDistortion(pMb, 0, pMb->Distortion(_codec->_RefLum, _codec->_RefCb, _codec->_RefCr, _codec->_Lum, _codec->_Cb, _codec->_Cr));
 		}//end if mvx...
 		else
 		{
 			/// Estimated mv is equal to pred mv.
-			pMb->_distortion[0] = distortion;
+			_codec->SetMbDistortion(pMb, 0, distortion);
 			pMb->_include = 0;
 		}//end else...
 
@@ -12607,7 +14671,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControlMvOnly(int allowed
 		if (!pMb->_skip)
 		{
 			/// Sum the run and coding bit contributions.
-			bitCost += (lclBitCost + _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun));
+			bitCost += (lclBitCost + ExpGolombH264::UnsignedBits(mbSkipRun));
 			mbSkipRun = 0; ///< Reset.
 		}//end if !_skip...
 		else  ///< Skipped.
@@ -12615,7 +14679,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControlMvOnly(int allowed
 	}//end for mb...
   /// Add last skip run.
 	if (mbSkipRun)
-		bitCost += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+		bitCost += ExpGolombH264::UnsignedBits(mbSkipRun);
 
 	/// Stage 2: Sub optimal solution proceeds by scanning the next mb with the initial least distortion 
 	/// impact after replacing the estimated mv with the pred mv. Continue to replace the mv with the 
@@ -12679,8 +14743,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControlMvOnly(int allowed
 				if ((pMb->_mvX[MacroBlockH264::_16x16] != predX) || (pMb->_mvY[MacroBlockH264::_16x16] != predY))
 				{
 					/// Re-compensate if it has changed.
-					_codec->_pMotionCompensator->Invalidate();
-					_codec->_pMotionCompensator->Compensate(pMb->_offLumX, pMb->_offLumY, predX, predY);
+					_codec->CompensateMb(pMb, prevRef, predX, predY);
 				}//end if _mvX...
 
 			}//end if !include...
@@ -12697,7 +14760,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControlMvOnly(int allowed
 			if (!pMb->_skip)
 			{
 				/// Sum the run and coding bit contributions.
-				bitCost += (r + _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun));
+				bitCost += (r + ExpGolombH264::UnsignedBits(mbSkipRun));
 				mbSkipRun = 0; ///< Restart
 			}//end if !_skip...
 			else  ///< Skipped.
@@ -12707,7 +14770,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControlMvOnly(int allowed
 
 		/// Add last skip run.
 		if (mbSkipRun)
-			bitCost += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+			bitCost += ExpGolombH264::UnsignedBits(mbSkipRun);
 
 	}//end while bitCost...
 
@@ -12833,7 +14896,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControl(int allowedBits,
 				/// Add back new bits.
 				if (!pMb->_skip)
 				{
-					pMb->_rate[pMb->_mbEncQP] = _codec->MacroBlockLayerBitCounter(pMb);
+					_codec->SetMbRate(pMb, pMb->_mbEncQP, _codec->MacroBlockLayerBitCounter(pMb));
 					predR += pMb->_rate[pMb->_mbEncQP];
 				}//end if !_skip ...
 
@@ -12852,7 +14915,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControl(int allowedBits,
 			bitCost += _codec->ProcessInterMbImplStd(pMb, 0, 1);
 			if (!pMb->_skip)
 			{
-				bitCost += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+				bitCost += ExpGolombH264::UnsignedBits(mbSkipRun);
 				mbSkipRun = 0;
 			}//end if !_skip...
 			else
@@ -12861,7 +14924,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControl(int allowedBits,
 		}//end for mb...
 	  /// Add last skip run.
 		if (mbSkipRun)
-			bitCost += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+			bitCost += ExpGolombH264::UnsignedBits(mbSkipRun);
 
 		iterations++;
 	}//end while bitCost...
@@ -12899,7 +14962,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControl(int allowedBits,
 		  if(!pMb->_skip)
 		  {
 			/// Sum of skip run and coded mb bits accumulated.
-			bitCost += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+			bitCost += ExpGolombH264::UnsignedBits(mbSkipRun);
 			mbSkipRun = 0;
 		  }//end if !_skip...
 		  else
@@ -12912,7 +14975,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControl(int allowedBits,
 		  }//end for mb...
 		/// Add last skip run.
 		if(mbSkipRun)
-		  bitCost += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+		  bitCost += ExpGolombH264::UnsignedBits(mbSkipRun);
 
 		R = 0;
 		iterations  = 0;
@@ -13033,7 +15096,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControl(int allowedBits,
 				bitCost += _codec->ProcessInterMbImplStd(pMb, 0, 1);
 				if(!pMb->_skip)
 				{
-				  bitCost += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+				  bitCost += ExpGolombH264::UnsignedBits(mbSkipRun);
 				  mbSkipRun = 0;
 				}//end if !_skip...
 				else
@@ -13042,7 +15105,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControl(int allowedBits,
 				}//end for mb...
 			  /// Add last skip run.
 			  if(mbSkipRun)
-				bitCost += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+				bitCost += ExpGolombH264::UnsignedBits(mbSkipRun);
 			}//end while bitCost...
 
 			iterations++;
@@ -13084,15 +15147,15 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControl(int allowedBits,
 		   if(!pMb->_skip)
 		   {
 			 /// Sum of skip run and coded mb bits accumulated.
-			 Rl += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+			 Rl += ExpGolombH264::UnsignedBits(mbSkipRun);
 			 mbSkipRun = 0;
 		   }//end if !_skip...
 		   else
 			 mbSkipRun++;
 
-			   if(pMb->_distortion[H264V2_MAX_EXT_QP] > Dl)
+			   if(_codec->MbDistortion(mb, H264V2_MAX_EXT_QP) > Dl)
 			   {
-				   Dl = pMb->_distortion[H264V2_MAX_EXT_QP];
+				   Dl = _codec->MbDistortion(mb, H264V2_MAX_EXT_QP);
 				   mbDmax = mb;	///< Mark the mb index with the peak distortion.
 			   }//end if _distortion...
 
@@ -13106,7 +15169,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControl(int allowedBits,
 		   }//end for mb...
 		 /// Add last skip run.
 		 if(mbSkipRun)
-		   Rl += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+		   Rl += ExpGolombH264::UnsignedBits(mbSkipRun);
 
 		 /// Step 2: Proceed with optimisation algorithm with QP = {51..71}
 		 if(Rl < allowedBits)
@@ -13158,11 +15221,11 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControl(int allowedBits,
 
 					   /// Record the found QP where the macroblock dist is just below Dmax and accumulate the rate for this macroblock.
 					   _pQ[mb] = _codec->GetMbQPBelowDmaxVer3(*pMb, _pQ[mb], Dmax, &firstMbChange, qEnd, FALSE);
-					   R += pMb->_rate[_pQ[mb]]; ///< Rate = 0 for skipped mbs.
-			   if(!pMb->_skip)
+					   R += _codec->MbRate(mb, _pQ[mb]); ///< Rate = 0 for skipped mbs.
+			   if(!_codec->MbSkip(mb))
 			   {
 				 /// Sum of skip run and coded mb bits accumulated.
-				 R += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+				 R += ExpGolombH264::UnsignedBits(mbSkipRun);
 				 mbSkipRun = 0;
 			   }//end if !_skip...
 			   else
@@ -13174,7 +15237,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControl(int allowedBits,
 				   }//end for mb...
 			 /// Add last skip run.
 			 if(mbSkipRun)
-			   R += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+			   R += ExpGolombH264::UnsignedBits(mbSkipRun);
 
 				   /// Test the stopping criteria.
 				   int rBndDiff = abs(Ru - Rl);			///< Optimal solution is rate bounded in a small enough range.
@@ -13256,7 +15319,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControl(int allowedBits,
 		   if(!pMb->_skip)
 		   {
 			 /// Sum of skip run and coded mb bits accumulated.
-			 R += _codec->_pHeaderUnsignedVlcEnc->Encode(mbSkipRun);
+			 R += ExpGolombH264::UnsignedBits(mbSkipRun);
 			 mbSkipRun = 0;
 
 			 /// Add up min encodings from the next mb to the end.
@@ -13269,7 +15332,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControl(int allowedBits,
 			   int r = pMbi->_rate[0];
 			   if(r) ///< Not skipped.
 			   {
-				 bitsToEnd += (r + _codec->_pHeaderUnsignedVlcEnc->Encode(run));
+				 bitsToEnd += (r + ExpGolombH264::UnsignedBits(run));
 				 run = 0;
 			   }//end if r...
 			   else
@@ -13277,7 +15340,7 @@ int H264v2Codec::InterImgPlaneEncoderImplMinMax::DamageControl(int allowedBits,
 			   mbi++;
 			 }//end while mbi...
 			 if(run)
-				bitsToEnd += _codec->_pHeaderUnsignedVlcEnc->Encode(run);
+				bitsToEnd += ExpGolombH264::UnsignedBits(run);
 
 			 /// With this mb max QP encoded and min encoding for all remaining mbs to the end,
 			 /// if it does not fit then mark it as the min encoding point and break.
@@ -13344,10 +15407,10 @@ int H264v2Codec::InterImgPlaneEncoderImplDMax::Encode(int allowedBits, int* bits
 	/// By default the DC transforms were set in the TransformOnly mode in the Open() method.
 
 	/// Motion estimation has been previously performed outside of this method and therefore
-	/// only motion compensation is required here. Prepare for motion compensation on a per 
-	/// macoblock basis. The vectors themselves are held in _pMotionEstimationResult.
-	if (compRef)
-		_codec->_pMotionCompensator->PrepareForSingleVectorMode();
+	/// only motion compensation is required here. Predictions are read from the previous
+	/// ring picture and written into the current one per macroblock. The vectors 
+	/// themselves are held in _pMotionEstimationResult.
+	int prevRef = (_codec->_refIndex + H264V2_REF_PICS - 1) % H264V2_REF_PICS;
 
 	/// Get the motion vector list to work with. Assume SIMPLE2D type list as only a
 	/// single 16x16 motion vector is considered per macroblock in this implementation
@@ -13378,7 +15441,7 @@ int H264v2Codec::InterImgPlaneEncoderImplDMax::Encode(int allowedBits, int* bits
 		int mvy = _codec->_pMotionEstimationResult->GetSimpleElement(mb, 1);
 		if (compRef)
 		{
-			_codec->_pMotionCompensator->Compensate(pMb->_offLumX, pMb->_offLumY, mvx, mvy);
+			_codec->CompensateMb(pMb, prevRef, mvx, mvy);
 		}//end if compRef...
 
 			/// Store the vector for this macroblock.
@@ -13459,8 +15522,9 @@ int H264v2Codec::InterImgPlaneDecoderImplStdVer1::Decode(void)
 	_codec->_8x8_0->SetOverlayDim(8, 8);
 	_codec->_8x8_1->SetOverlayDim(8, 8);
 
-	/// Prepare for motion compensation on a per macoblock basis.
-	_codec->_pMotionCompensator->PrepareForSingleVectorMode();
+	/// Predictions are read from the previous ring picture and written into the
+	/// current one and therefore no copy of the reference is required.
+	int prevRef = (_codec->_refIndex + H264V2_REF_PICS - 1) % H264V2_REF_PICS;
 
 	/// Whip through each macroblock. Decode the extracted encodings. All modes
 	/// and parameters have been extracted by the ReadMacroBlockLayer() method.
@@ -13480,10 +15544,10 @@ int H264v2Codec::InterImgPlaneDecoderImplStdVer1::Decode(void)
 			return(0);
 		}//end if !Inter_16x16...
 
-		/// Compensate the vector and hope the encoder estimator ensured that
-		/// all pels fall inside the image space. The motion vector was decoded
-		/// from the vector differences in the ReadMacroBlockLayer() method.
-		_codec->_pMotionCompensator->Compensate(lOffX, lOffY, pMb->_mvX[MacroBlockH264::_16x16], pMb->_mvY[MacroBlockH264::_16x16]);
+		/// Compensate the vector with reference pels outside the image space edge
+		/// clamped. The motion vector was decoded from the vector differences in
+		/// the ReadMacroBlockLayer() method.
+		_codec->CompensateMb(pMb, prevRef, pMb->_mvX[MacroBlockH264::_16x16], pMb->_mvY[MacroBlockH264::_16x16]);
 
 		if (pMb->_coded_blk_pattern)
 		{
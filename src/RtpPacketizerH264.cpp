@@ -0,0 +1,321 @@
+/** @file
+
+MODULE				: H264v2Codec
+
+TAG						: H264V2C
+
+FILE NAME			: RtpPacketizerH264.cpp
+
+DESCRIPTION		: Packetize coded H.264 access units into RFC 6184 RTP packets
+								described by scatter/gather vectors into the coded stream.
+
+COPYRIGHT			: (c)CSIR 2007-2019 all rights resevered
+
+LICENSE				: Software License Agreement (BSD License)
+
+RESTRICTIONS	: Redistribution and use in source and binary forms, with or without 
+								modification, are permitted provided that the following conditions 
+								are met:
+
+								* Redistributions of source code must retain the above copyright notice, 
+								this list of conditions and the following disclaimer.
+								* Redistributions in binary form must reproduce the above copyright notice, 
+								this list of conditions and the following disclaimer in the documentation 
+								and/or other materials provided with the distribution.
+								* Neither the name of the CSIR nor the names of its contributors may be used 
+								to endorse or promote products derived from this software without specific 
+								prior written permission.
+
+								THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+								"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+								LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+								A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+								CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+								EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+								PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+								PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+								LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+								NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+								SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+===========================================================================
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WINDOWS
+#include <sys/uio.h>
+#endif
+
+#include "RtpPacketizerH264.h"
+
+#ifndef _WINDOWS
+static_assert((sizeof(RTPPACKETIZERH264_IOVEC) == sizeof(struct iovec)) &&
+	(offsetof(RTPPACKETIZERH264_IOVEC, base) == offsetof(struct iovec, iov_base)) &&
+	(offsetof(RTPPACKETIZERH264_IOVEC, len) == offsetof(struct iovec, iov_len)), "RTPPACKETIZERH264_IOVEC must match struct iovec");
+#endif
+
+/// Header bytes reserved per packet for the RTP header and the largest payload header (FU-A).
+#define RTPPACKETIZERH264_SLOT_LEN 16
+
+/*
+---------------------------------------------------------------------------
+	Construction and destruction.
+---------------------------------------------------------------------------
+*/
+RtpPacketizerH264::RtpPacketizerH264(void)
+{
+	_maxPayload = 0;
+	_maxPackets = 0;
+	_maxIov = 0;
+	_payloadType = 96;	///< First dynamic payload type.
+	_ssrc = 0;
+	_seq = 0;
+	_timestamp = 0;
+
+	_pPacket = NULL;
+	_numPackets = 0;
+	_pIov = NULL;
+	_numIov = 0;
+	_pHeader = NULL;
+	_pSizes = NULL;
+	_sizesPos = 0;
+}//end constructor.
+
+RtpPacketizerH264::~RtpPacketizerH264(void)
+{
+	Destroy();
+}//end destructor.
+
+/*
+---------------------------------------------------------------------------
+	Public methods.
+---------------------------------------------------------------------------
+*/
+/** Allocate the packet descriptors.
+@param maxPayloadBytes	: RTP payload bytes per packet, typically the path MTU less 40 bytes.
+@param maxPackets				: Packets per access unit.
+@return									: 1 = success, 0 = failure.
+*/
+int RtpPacketizerH264::Create(int maxPayloadBytes, int maxPackets)
+{
+	Destroy();
+
+	if ((maxPayloadBytes < 8) || (maxPackets < 1))
+		return(0);
+
+	_maxPayload = maxPayloadBytes;
+	_maxPackets = maxPackets;
+	/// A STAP-A packet uses two elements per aggregated NAL unit.
+	_maxIov = (3 * maxPackets) + (2 * H264V2_MAX_NAL_UNITS);
+
+	_pPacket = new RTPPACKETIZERH264_PACKET[_maxPackets];
+	_pIov = new RTPPACKETIZERH264_IOVEC[_maxIov];
+	_pHeader = new unsigned char[_maxPackets * RTPPACKETIZERH264_SLOT_LEN];
+	_pSizes = new unsigned char[2 * H264V2_MAX_NAL_UNITS];
+	if ((_pPacket == NULL) || (_pIov == NULL) || (_pHeader == NULL) || (_pSizes == NULL))
+	{
+		Destroy();
+		return(0);
+	}//end if _pPacket...
+
+	return(1);
+}//end Create.
+
+void RtpPacketizerH264::Destroy(void)
+{
+	if (_pPacket != NULL)
+		delete[] _pPacket;
+	_pPacket = NULL;
+	if (_pIov != NULL)
+		delete[] _pIov;
+	_pIov = NULL;
+	if (_pHeader != NULL)
+		delete[] _pHeader;
+	_pHeader = NULL;
+	if (_pSizes != NULL)
+		delete[] _pSizes;
+	_pSizes = NULL;
+
+	_maxPayload = 0;
+	_maxPackets = 0;
+	_maxIov = 0;
+	_numPackets = 0;
+	_numIov = 0;
+	_sizesPos = 0;
+}//end Destroy.
+
+/** Packetize one access unit.
+The NAL unit table is the "nalunits" member of the codec after Code() and pStream
+is its coded output in either Annex B or length prefix form. The marker bit is set
+on the last packet of the access unit. On failure the sequence number is unchanged.
+@param pStream		: Coded access unit.
+@param pNal				: NAL units of the access unit.
+@param numNal			: Entries in pNal.
+@param timestamp	: RTP timestamp of the access unit (90kHz clock).
+@return						: 1 = success, 0 = too many packets or an invalid NAL unit.
+*/
+int RtpPacketizerH264::Packetize(const void* pStream, const H264V2_NAL_UNIT* pNal, int numNal, unsigned int timestamp)
+{
+	const unsigned char* stream = (const unsigned char*)pStream;
+	unsigned short firstSeq = _seq;
+
+	_numPackets = 0;
+	_numIov = 0;
+	_sizesPos = 0;
+	_timestamp = timestamp;
+	if ((_pPacket == NULL) || (stream == NULL))
+		return(0);
+
+	int i = 0;
+	while (i < numNal)
+	{
+		const unsigned char* nal = &(stream[pNal[i].offset]);
+		int size = pNal[i].size;
+		int type = pNal[i].type;
+		if (size < 1)
+			goto RTPPACKETIZERH264_P_FAIL;
+
+		/// Aggregate consecutive non-slice NAL units, e.g. the SPS and PPS, that fit together.
+		if ((type < 1) || (type > 5))
+		{
+			int j = i;
+			int bytes = 1;	///< STAP-A NAL header.
+			while ((j < numNal) && ((pNal[j].type < 1) || (pNal[j].type > 5)) && (pNal[j].size > 0) &&
+						 ((bytes + 2 + pNal[j].size) <= _maxPayload) && ((_sizesPos + (2 * (j - i + 1))) <= (2 * H264V2_MAX_NAL_UNITS)))
+			{
+				bytes += 2 + pNal[j].size;
+				j++;
+			}//end while j...
+
+			if ((j - i) > 1)
+			{
+				unsigned char* h = StartPacket(1, (j == numNal));
+				if (h == NULL)
+					goto RTPPACKETIZERH264_P_FAIL;
+
+				/// The forbidden bit is the OR and the NRI the max of the aggregated units.
+				unsigned char f = 0;
+				unsigned char nri = 0;
+				for (int k = i; k < j; k++)
+				{
+					const unsigned char* unit = &(stream[pNal[k].offset]);
+					f |= unit[0] & 0x80;
+					if ((unit[0] & 0x60) > nri)
+						nri = unit[0] & 0x60;
+
+					unsigned char* len = &(_pSizes[_sizesPos]);
+					len[0] = (unsigned char)(pNal[k].size >> 8);
+					len[1] = (unsigned char)pNal[k].size;
+					_sizesPos += 2;
+					if (!AddIov(len, 2) || !AddIov(unit, pNal[k].size))
+						goto RTPPACKETIZERH264_P_FAIL;
+				}//end for k...
+				h[0] = f | nri | RTPPACKETIZERH264_STAP_A;
+
+				i = j;
+				continue;
+			}//end if j...
+		}//end if type...
+
+		int last = ((i + 1) == numNal);
+		if (size <= _maxPayload)
+		{
+			/// Single NAL unit packet.
+			if ((StartPacket(0, last) == NULL) || !AddIov(nal, size))
+				goto RTPPACKETIZERH264_P_FAIL;
+		}//end if size...
+		else
+		{
+			/// FU-A fragments carry the NAL unit after its header byte, which is rebuilt
+			/// from the FU indicator and FU header at the receiver.
+			int fragLen = _maxPayload - 2;
+			int pos = 1;
+			while (pos < size)
+			{
+				int len = size - pos;
+				if (len > fragLen)
+					len = fragLen;
+				int end = ((pos + len) == size);
+
+				unsigned char* h = StartPacket(2, last && end);
+				if (h == NULL)
+					goto RTPPACKETIZERH264_P_FAIL;
+				h[0] = (nal[0] & 0xE0) | RTPPACKETIZERH264_FU_A;
+				h[1] = (unsigned char)(((pos == 1) ? 0x80 : 0) | (end ? 0x40 : 0) | (nal[0] & 0x1F));
+				if (!AddIov(&(nal[pos]), len))
+					goto RTPPACKETIZERH264_P_FAIL;
+
+				pos += len;
+			}//end while pos...
+		}//end else...
+		i++;
+	}//end while i...
+
+	return(1);
+
+RTPPACKETIZERH264_P_FAIL:
+	_numPackets = 0;
+	_numIov = 0;
+	_seq = firstSeq;
+	return(0);
+}//end Packetize.
+
+/*
+---------------------------------------------------------------------------
+	Protected methods.
+---------------------------------------------------------------------------
+*/
+/** Begin a new packet with its RTP header.
+@param headerLen	: Payload header bytes (STAP-A = 1, FU-A = 2) to follow the RTP header.
+@param marker			: Last packet of the access unit.
+@return						: Payload header bytes to fill in, NULL if there is no packet space.
+*/
+unsigned char* RtpPacketizerH264::StartPacket(int headerLen, int marker)
+{
+	if ((_numPackets >= _maxPackets) || (_numIov >= _maxIov))
+		return(NULL);
+
+	unsigned char* h = &(_pHeader[_numPackets * RTPPACKETIZERH264_SLOT_LEN]);
+	h[0] = 0x80;	///< V = 2, P = 0, X = 0, CC = 0.
+	h[1] = (unsigned char)((marker ? 0x80 : 0) | _payloadType);
+	h[2] = (unsigned char)(_seq >> 8);
+	h[3] = (unsigned char)_seq;
+	h[4] = (unsigned char)(_timestamp >> 24);
+	h[5] = (unsigned char)(_timestamp >> 16);
+	h[6] = (unsigned char)(_timestamp >> 8);
+	h[7] = (unsigned char)_timestamp;
+	h[8] = (unsigned char)(_ssrc >> 24);
+	h[9] = (unsigned char)(_ssrc >> 16);
+	h[10] = (unsigned char)(_ssrc >> 8);
+	h[11] = (unsigned char)_ssrc;
+	_seq++;
+
+	_pPacket[_numPackets].firstIov = _numIov;
+	_pPacket[_numPackets].numIov = 0;
+	_pPacket[_numPackets].bytes = 0;
+	_numPackets++;
+	AddIov(h, RTPPACKETIZERH264_HEADER_LEN + headerLen);
+
+	return(&(h[RTPPACKETIZERH264_HEADER_LEN]));
+}//end StartPacket.
+
+/** Append an element to the current packet.
+@param base	: First byte.
+@param len	: Byte length.
+@return			: 1 = success, 0 = no element space.
+*/
+int RtpPacketizerH264::AddIov(const void* base, int len)
+{
+	if (_numIov >= _maxIov)
+		return(0);
+
+	_pIov[_numIov].base = (void *)base;
+	_pIov[_numIov].len = (size_t)len;
+	_numIov++;
+	_pPacket[_numPackets - 1].numIov++;
+	_pPacket[_numPackets - 1].bytes += len;
+	return(1);
+}//end AddIov.
+